@@ -20,6 +20,7 @@ OPTIONS:
   -s, --start-date DATE    Start date in YYYYMMDD format (required)
   -e, --end-date DATE      End date in YYYYMMDD format (default: same as start date)
   -d, --data-dir PATH      Data directory (default: ${data_dir})
+  -r, --retry-failed       Only refetch records that failed in an earlier run
   -h, --help               Show this help message
 
 EXAMPLES:
@@ -31,6 +32,9 @@ EXAMPLES:
 
   # Use custom data directory
   $0 -s 20260101 -d /path/to/data
+
+  # Rerunning resumes an interrupted fetch; failed records are retried with
+  $0 -s 20260101 --retry-failed
 EOF
 }
 
@@ -44,6 +48,7 @@ log_error() {
 
 start_date=""
 end_date=""
+records_args=()
 
 while [[ $# -gt 0 ]]; do
   case "$1" in
@@ -59,6 +64,10 @@ while [[ $# -gt 0 ]]; do
       data_dir="$2"
       shift 2
       ;;
+    -r|--retry-failed)
+      records_args+=(--retry-failed)
+      shift
+      ;;
     -h|--help)
       show_usage
       exit 0
@@ -142,7 +151,7 @@ fi
 
 log_info ""
 log_info "Step 3/3: Fetching individual records..."
-if "${fetcher_cli}" records -i "${session_file}" -o "${records_dir}" --data-dir "${data_dir}"; then
+if "${fetcher_cli}" records -i "${session_file}" -o "${records_dir}" --data-dir "${data_dir}" ${records_args[@]+"${records_args[@]}"}; then
   log_info "✓ Records saved to: ${data_dir}/${records_dir}/"
 else
   log_error "✗ Failed to fetch records"
@@ -2,6 +2,9 @@
 
 #include "analyzer/game_state.h"
 #include "analyzer/record_parser.h"
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
 
 namespace tziakcha {
 namespace analyzer {
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "analyzer/script.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tziakcha {
+namespace analyzer {
+
+// Packed action stream: the action count as a varint, then per action one
+// byte of player << 4 | type, data as a varint and the zigzagged delta to
+// the previous action's time as a varint (LEB128). Real actions take 3-5
+// bytes; 16-bit data and steps shorter than 37 hours stay within 8.
+void PackActions(const std::vector<Action>& actions, std::string& out);
+
+// Decodes a whole stream at once into columns. Returns false, leaving out
+// empty, if the stream is truncated or has trailing bytes.
+bool UnpackActions(std::string_view packed, ActionColumns& out);
+
+// Same into Action structs, for callers that walk actions one by one.
+bool UnpackActions(std::string_view packed, std::vector<Action>& out);
+
+} // namespace analyzer
+} // namespace tziakcha
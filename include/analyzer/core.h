@@ -2,6 +2,7 @@
 
 #include "analyzer/simulator.h"
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace tziakcha {
@@ -11,7 +12,7 @@ class RecordAnalyzer {
 public:
   RecordAnalyzer();
 
-  SimulationResult Analyze(const std::string& record_json_str);
+  SimulationResult Analyze(std::string_view record_json_str);
 
   static RecordAnalyzer& GetInstance();
 
@@ -1,21 +1,13 @@
 #pragma once
 
-#include <nlohmann/json.hpp>
+#include "analyzer/script.h"
 #include <string>
+#include <string_view>
 #include <vector>
 
-using json = nlohmann::json;
-
 namespace tziakcha {
 namespace analyzer {
 
-struct Action {
-  int player_idx;
-  int action_type;
-  int data;
-  int time_ms;
-};
-
 struct WinInfo {
   int winner_idx;
   int win_tile;
@@ -27,26 +19,18 @@ public:
   RecordParser();
   ~RecordParser();
 
-  bool Parse(const std::string& record_json_str);
+  bool Parse(std::string_view record_json_str);
 
-  const json& GetScriptData() const;
-  const std::vector<Action>& GetActions() const;
-  const json& GetGameConfig() const;
-  const json& GetPlayerInfo() const;
-  const json& GetWinData(int player_idx) const;
+  const Script& GetScript() const;
+  const ActionColumns& GetActions() const;
+  const std::string& GetError() const;
 
   bool IsValid() const;
 
 private:
-  json script_data_;
-  std::vector<Action> actions_;
-  json game_config_;
-  json player_info_;
-  std::vector<json> win_data_;
+  Script script_;
+  std::string error_;
   bool is_valid_;
-
-  bool DecodeAndParseScript(const std::string& record_json_str);
-  void ParseActions();
 };
 
 } // namespace analyzer
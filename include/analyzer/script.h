@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace tziakcha {
+namespace analyzer {
+
+struct Action {
+  int player_idx;
+  int action_type;
+  int data;
+  int time_ms;
+};
+
+// A record's actions one column per field, for passes that read a field or
+// two of every action (durations, step counts, corpus-wide scans). Callers
+// that walk actions one by one read them through operator[].
+struct ActionColumns {
+  std::vector<uint8_t> player;
+  std::vector<uint8_t> type;
+  std::vector<int32_t> data;
+  std::vector<int32_t> time_ms;
+
+  size_t size() const { return type.size(); }
+  bool empty() const { return type.empty(); }
+
+  Action operator[](size_t i) const {
+    return {player[i], type[i], data[i], time_ms[i]};
+  }
+
+  void push_back(const Action& action) {
+    player.push_back(static_cast<uint8_t>(action.player_idx));
+    type.push_back(static_cast<uint8_t>(action.action_type));
+    data.push_back(action.data);
+    time_ms.push_back(action.time_ms);
+  }
+};
+
+// Entry of the script's "p" array.
+struct ScriptPlayer {
+  std::string id;
+  std::string name;
+  double elo = 1500.0;
+};
+
+// Entry of the script's "y" array; seats that did not win have no fans.
+struct ScriptWin {
+  int total_fan = 0;
+  // "t" ordered by the text of the fan ids, as json iterates objects:
+  // fan id -> points | (count - 1) << 8.
+  std::vector<std::pair<int, int>> fans;
+  // "h" as compact JSON text, empty when absent.
+  std::string hand;
+};
+
+// Top-level members of a stored record that order and group it.
+struct RecordHeader {
+  std::string id;      // "id"
+  std::string session; // "belongs"
+  // The step's "t" if the record has a step with one, else the record's.
+  int64_t timestamp = 0;
+};
+
+// The parts of a decoded script that the simulator and stats read. Members
+// of an unexpected type are left at their defaults.
+struct Script {
+  std::vector<uint8_t> wall;
+  int dice          = 0;
+  int round         = 0;
+  int win_flags     = 0;
+  int64_t timestamp = 0;
+  std::string title;
+  std::vector<ScriptPlayer> players;
+  std::vector<ScriptWin> wins;
+  ActionColumns actions;
+  // Only filled when parsing a stored record.
+  RecordHeader header;
+
+  bool has_wall = false;
+  bool has_dice = false;
+};
+
+// Fills script from decoded script JSON in a single SAX pass, without
+// building a json DOM. Returns false if the text is not valid JSON.
+bool ParseScript(std::string_view text, Script& script);
+
+// Same for a stored record in any storage encoding: reads the "step"
+// object if there is one and otherwise inflates the base64+zlib "script"
+// string and parses that.
+bool ParseRecordScript(std::string_view record,
+                       Script& script,
+                       std::string* error = nullptr);
+
+// Reads only a stored record's header, in a SAX pass that neither fills
+// the script nor inflates it. Returns false if the record is not valid.
+bool ParseRecordHeader(std::string_view record, RecordHeader& header);
+
+// Same as ParseRecordScript for a record that has already been parsed,
+// walking the json instead of parsing the record text again.
+bool ExtractRecordScript(const json& record,
+                         Script& script,
+                         std::string* error = nullptr);
+
+} // namespace analyzer
+} // namespace tziakcha
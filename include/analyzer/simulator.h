@@ -8,6 +8,7 @@
 #include <functional>
 #include <nlohmann/json.hpp>
 #include <string>
+#include <string_view>
 #include <vector>
 
 using json = nlohmann::json;
@@ -26,7 +27,12 @@ class RecordSimulator {
 public:
   RecordSimulator();
 
-  SimulationResult Simulate(const std::string& record_json_str);
+  SimulationResult Simulate(std::string_view record_json_str);
+
+  // Simulates a script that has been parsed already, e.g. by a decode
+  // stage or a batch loader, so the record is not parsed again. script is
+  // only read during the call.
+  SimulationResult Simulate(const Script& script);
 
   using ActionObserver =
       std::function<void(const Action&, int step_number, const GameState&)>;
@@ -42,6 +48,8 @@ public:
 
 private:
   RecordParser parser_;
+  const Script* script_ = nullptr;
+  int round_wind_idx_   = 0;
   GameState state_;
   ActionProcessor processor_;
   WinAnalyzer analyzer_;
@@ -1,11 +1,9 @@
 #pragma once
 
+#include "analyzer/script.h"
 #include <array>
 #include <string>
 #include <vector>
-#include <nlohmann/json.hpp>
-
-using json = nlohmann::json;
 
 namespace tziakcha {
 namespace analyzer {
@@ -45,7 +43,7 @@ public:
 
   void SetWinInfo(int winner_idx, int win_tile, bool is_self_drawn);
   void SetGameState(const class GameState& state);
-  void SetScriptData(const json& script_data);
+  void SetScript(const Script& script);
 
   WinAnalysis Analyze();
 
@@ -65,7 +63,7 @@ private:
   bool is_self_drawn_;
 
   const GameState* state_;
-  json script_data_;
+  const Script* script_;
   std::vector<GBFanDetail> gb_fan_details_;
 
   std::string BuildEnvFlag();
@@ -17,10 +17,19 @@ public:
 
   std::string get_base_url() const;
   bool use_ssl() const;
+  int get_port() const;
   std::string get_history_endpoint() const;
   std::string get_game_endpoint() const;
   std::string get_record_endpoint() const;
   int get_timeout_ms() const;
+  bool use_keep_alive() const;
+  int get_max_connections() const;
+  int get_retry_attempts() const;
+  int get_retry_base_delay_ms() const;
+  int get_retry_max_delay_ms() const;
+  int get_breaker_window() const;
+  double get_breaker_error_rate() const;
+  int get_breaker_cooldown_ms() const;
 
   const std::map<std::string, std::string>& get_headers() const;
 
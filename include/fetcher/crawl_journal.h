@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tziakcha {
+namespace fetcher {
+
+// Append-only log of the outcome of every id a batch fetch has touched, so
+// an interrupted crawl can resume where it stopped and failures can be
+// retried on their own. Each event is one line ("A id", "S id" or
+// "F id<TAB>reason") flushed as it happens; open() replays the file into a
+// hash map, truncates a last line torn by a crash and compacts the file
+// when it holds many more lines than ids.
+class CrawlJournal {
+public:
+  enum class State { kUnknown, kAttempted, kSucceeded, kFailed };
+
+  struct Counts {
+    size_t attempted = 0;
+    size_t succeeded = 0;
+    size_t failed    = 0;
+  };
+
+  explicit CrawlJournal(std::string path);
+  ~CrawlJournal();
+
+  CrawlJournal(const CrawlJournal&)            = delete;
+  CrawlJournal& operator=(const CrawlJournal&) = delete;
+
+  bool open();
+  void close();
+
+  State state(const std::string& id) const;
+  std::string failure_reason(const std::string& id) const;
+
+  bool mark_attempted(const std::string& id);
+  bool mark_succeeded(const std::string& id);
+  bool mark_failed(const std::string& id, const std::string& reason);
+
+  std::vector<std::string> failed_ids() const;
+  Counts counts() const;
+  const std::string& path() const { return path_; }
+
+private:
+  struct Entry {
+    State state = State::kUnknown;
+    std::string reason;
+  };
+
+  std::string path_;
+  std::FILE* file_ = nullptr;
+  std::unordered_map<std::string, Entry> entries_;
+  size_t journal_lines_ = 0;
+  mutable std::mutex mutex_;
+
+  bool append_line(State state,
+                   const std::string& id,
+                   const std::string& reason);
+  bool write_snapshot();
+};
+
+} // namespace fetcher
+} // namespace tziakcha
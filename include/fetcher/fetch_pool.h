@@ -0,0 +1,99 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace tziakcha {
+namespace fetcher {
+
+// Token bucket shared by all workers of a pool. Tokens refill at
+// rate_per_sec up to burst; acquire() blocks until one is available.
+// A rate of 0 disables the limit.
+class RateLimiter {
+public:
+  explicit RateLimiter(double rate_per_sec, double burst = 1.0);
+
+  void acquire();
+  // Takes a token only if one is available now.
+  bool try_acquire();
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  double rate_per_sec_;
+  double burst_;
+  double tokens_;
+  Clock::time_point last_refill_;
+  std::mutex mutex_;
+
+  void refill(Clock::time_point now);
+};
+
+struct FetchStats {
+  size_t succeeded       = 0;
+  size_t failed          = 0;
+  double elapsed_seconds = 0;
+  std::vector<double> latencies_ms;
+
+  size_t requests() const { return succeeded + failed; }
+  double mean_ms() const;
+  double percentile_ms(double p) const;
+  double requests_per_second() const;
+
+  // Accumulates the results of a later run over more ids.
+  void merge(const FetchStats& other);
+};
+
+// Fixed log-spaced buckets, cheap enough to update on every request and to
+// keep per endpoint. Percentiles report the upper bound of their bucket.
+class LatencyHistogram {
+public:
+  static constexpr std::array<double, 14> kBucketBoundsMs = {
+      1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 30000};
+
+  void add(double ms);
+  void merge(const LatencyHistogram& other);
+
+  uint64_t count() const { return count_; }
+  double mean_ms() const { return count_ > 0 ? sum_ms_ / count_ : 0; }
+  double max_ms() const { return max_ms_; }
+  double percentile_ms(double p) const;
+
+  // One count per bound plus a final overflow bucket.
+  const std::array<uint64_t, kBucketBoundsMs.size() + 1>& buckets() const {
+    return buckets_;
+  }
+
+private:
+  std::array<uint64_t, kBucketBoundsMs.size() + 1> buckets_{};
+  uint64_t count_ = 0;
+  double sum_ms_  = 0;
+  double max_ms_  = 0;
+};
+
+// Runs a task for every id on a fixed number of worker threads. Each task
+// waits for a token from the shared limiter first; its latency and result
+// are recorded in the returned stats.
+class FetchPool {
+public:
+  using Task      = std::function<bool(size_t index, const std::string& id)>;
+  using IndexTask = std::function<bool(size_t index)>;
+
+  FetchPool(size_t concurrency, double rate_per_sec, double burst = 1.0);
+
+  FetchStats run(const std::vector<std::string>& ids, const Task& task);
+  // Runs task for every index in [0, count), for work not keyed by string.
+  FetchStats run(size_t count, const IndexTask& task);
+
+private:
+  size_t concurrency_;
+  RateLimiter limiter_;
+};
+
+} // namespace fetcher
+} // namespace tziakcha
@@ -1,9 +1,11 @@
 #pragma once
 
 #include <cstdint>
+#include <map>
 #include <memory>
 #include <optional>
 #include <string>
+#include <unordered_set>
 #include <vector>
 #include <nlohmann/json.hpp>
 #include "storage/storage.h"
@@ -20,12 +22,36 @@ public:
     int64_t end_ms;
   };
 
+  // Newest game already stored under a history key. Pages are returned
+  // newest first, so an incremental fetch stops at the first page that
+  // reaches it.
+  struct Watermark {
+    int64_t start_ms = 0;
+    std::string id;
+  };
+
   explicit HistoryFetcher(std::shared_ptr<storage::Storage> storage = nullptr);
 
+  static constexpr size_t kDefaultConcurrency = 4;
+
+  // With a date range, the first and last page of the range are found by
+  // bisecting on game start times, and only those pages are downloaded,
+  // up to concurrency at a time.
   bool fetch(const std::string& cookie,
              const std::string& key        = "history/records",
              const std::string& start_date = "",
-             const std::string& end_date   = "");
+             const std::string& end_date   = "",
+             size_t concurrency            = kDefaultConcurrency);
+
+  // Fetches only games newer than the stored watermark and merges them in
+  // front of the history already stored under key. Falls back to a full
+  // fetch if nothing is stored yet.
+  bool fetch_incremental(const std::string& cookie,
+                         const std::string& key = "history/records");
+
+  static std::string watermark_key(const std::string& key) {
+    return key + "_watermark";
+  }
 
   const std::vector<json>& get_records() const { return records_; }
 
@@ -34,13 +60,33 @@ public:
 private:
   std::vector<json> records_;
   std::shared_ptr<storage::Storage> storage_;
+  std::optional<Watermark> watermark_;
+  std::unordered_set<std::string> known_ids_;
 
-  bool fetch_page(const std::string& url,
-                  const std::string& headers,
+  bool request_page(const std::string& cookie, int page, json& games) const;
+  bool fetch_page(const std::string& headers,
                   int page,
                   const std::optional<DateRangeMs>& date_range,
                   bool& reached_range_end);
+  void add_games(const json& games,
+                 int page,
+                 const std::optional<DateRangeMs>& date_range,
+                 bool& reached_range_end);
+  bool find_range_pages(const std::string& cookie,
+                        const DateRangeMs& range,
+                        int max_pages,
+                        std::map<int, json>& probed,
+                        int& first,
+                        int& end) const;
+  void fetch_pages(const std::string& cookie,
+                   int first,
+                   int end,
+                   const DateRangeMs& range,
+                   std::map<int, json>& probed,
+                   size_t concurrency);
   bool save_records(const std::string& key) const;
+  bool load_watermark(const std::string& key, const json& history);
+  bool save_watermark(const std::string& key) const;
 };
 
 } // namespace fetcher
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "fetcher/fetch_pool.h"
+#include "fetcher/retry_policy.h"
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace httplib {
+class ClientImpl;
+}
+
+namespace tziakcha {
+namespace fetcher {
+
+struct HttpResponse {
+  int status = 0;
+  std::string body;
+  std::string error;
+  int attempts = 0;
+
+  // False if no response was received; error describes why.
+  explicit operator bool() const { return status != 0; }
+};
+
+// Keep-alive HTTP(S) clients for the server in FetcherConfig, shared by
+// all fetchers and threads. A request borrows an idle client (and with it
+// its open connection) or creates a new one; at most max_connections idle
+// clients are kept for reuse.
+//
+// Failed requests are retried per the configured RetryPolicy, and all
+// requests share one CircuitBreaker, so a failing server slows every worker
+// down rather than each burning through its retries. Latencies are kept per
+// endpoint path.
+class HttpClientPool {
+public:
+  struct Stats {
+    uint64_t requests           = 0;
+    uint64_t connections_opened = 0;
+    uint64_t clients_created    = 0;
+    size_t idle_clients         = 0;
+    uint64_t retries            = 0;
+    uint64_t breaker_trips      = 0;
+
+    // A redirect or retry inside one request can connect more than once.
+    uint64_t connections_reused() const {
+      return requests > connections_opened ? requests - connections_opened
+                                           : 0;
+    }
+  };
+
+  // Receives a response body in chunks as it is read. offset is the chunk's
+  // position in the body; 0 starts a new body, as a retry streams again.
+  using BodyReceiver =
+      std::function<bool(const char* data, size_t size, uint64_t offset)>;
+
+  static HttpClientPool& instance();
+
+  // Sends the configured headers plus extra_headers. Transient failures are
+  // retried; the returned response is the last attempt's.
+  HttpResponse post(const std::string& path,
+                    const std::string& body,
+                    const std::string& content_type,
+                    const std::map<std::string, std::string>& extra_headers =
+                        {});
+
+  // Same as post, but a 200 response's body goes to receiver instead of
+  // HttpResponse::body, so the caller can process it without another copy.
+  HttpResponse
+  post_streaming(const std::string& path,
+                 const std::string& body,
+                 const std::string& content_type,
+                 const BodyReceiver& receiver,
+                 const std::map<std::string, std::string>& extra_headers = {});
+
+  Stats stats() const;
+  std::map<std::string, LatencyHistogram> latencies() const;
+  void clear();
+
+private:
+  HttpClientPool();
+  ~HttpClientPool();
+
+  std::unique_ptr<httplib::ClientImpl> acquire();
+  void release(std::unique_ptr<httplib::ClientImpl> client);
+  void wait_for_breaker();
+  HttpResponse send(const std::string& path,
+                    const std::string& body,
+                    const std::string& content_type,
+                    const std::map<std::string, std::string>& extra_headers,
+                    const BodyReceiver* receiver);
+
+  std::string origin_;
+  std::vector<std::unique_ptr<httplib::ClientImpl>> idle_;
+  CircuitBreaker breaker_;
+  std::map<std::string, LatencyHistogram> latencies_;
+  Stats stats_;
+  mutable std::mutex mutex_;
+};
+
+} // namespace fetcher
+} // namespace tziakcha
@@ -2,6 +2,7 @@
 #define TZIAKCHA_RECORD_FETCHER_H
 
 #include "storage/storage.h"
+#include "utils/script_decoder.h"
 #include <memory>
 #include <string>
 
@@ -10,13 +11,23 @@ namespace fetcher {
 
 class RecordFetcher {
 public:
-  explicit RecordFetcher(std::shared_ptr<storage::Storage> storage);
+  explicit RecordFetcher(std::shared_ptr<storage::Storage> storage,
+                         utils::ScriptMode script_mode =
+                             utils::ScriptMode::kDecoded);
 
+  // Fetches a record's raw JSON without parsing or storing it.
+  bool download_record(const std::string& record_id,
+                       std::string& body,
+                       std::string* error = nullptr);
+
+  // On failure a one-line description is stored in error if given.
   bool fetch_record(const std::string& record_id,
-                    const std::string& output_key = "");
+                    const std::string& output_key = "",
+                    std::string* error            = nullptr);
 
 private:
   std::shared_ptr<storage::Storage> storage_;
+  utils::ScriptMode script_mode_;
 };
 
 } // namespace fetcher
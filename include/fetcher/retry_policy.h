@@ -0,0 +1,65 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+
+namespace tziakcha {
+namespace fetcher {
+
+// Exponential backoff with jitter for transient request failures: no
+// response at all, 429 or a 5xx status.
+struct RetryPolicy {
+  int max_attempts     = 4;
+  double base_delay_ms = 500;
+  double max_delay_ms  = 30000;
+
+  static bool IsRetryable(int status);
+
+  // Delay before the given retry (1 = first retry). jitter in [0, 1) picks a
+  // point in the upper half of the capped exponential delay, so concurrent
+  // workers that failed together do not retry together.
+  double backoff_ms(int retry, double jitter) const;
+};
+
+// Tracks the outcome of the last window requests and opens once their error
+// rate reaches a threshold. While open every request waits for the cooldown
+// instead of hammering a struggling server. Tripping again within window
+// requests of the last trip doubles the cooldown, up to kMaxCooldownScale
+// times the base. Not thread-safe; the owner serializes access.
+class CircuitBreaker {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Options {
+    size_t window      = 50;
+    size_t min_samples = 10;
+    double error_rate  = 0.5;
+    double cooldown_ms = 5000;
+  };
+
+  static constexpr int kMaxCooldownScale = 8;
+
+  CircuitBreaker() = default;
+  explicit CircuitBreaker(const Options& options);
+
+  // Time before which no request should be sent; in the past when closed.
+  Clock::time_point blocked_until() const { return blocked_until_; }
+
+  // Returns true if this outcome tripped the breaker.
+  bool record(bool ok, Clock::time_point now = Clock::now());
+
+  uint64_t trips() const { return trips_; }
+
+private:
+  Options options_;
+  std::deque<bool> outcomes_;
+  size_t failures_    = 0;
+  size_t since_trip_  = 0;
+  int cooldown_scale_ = 1;
+  uint64_t trips_     = 0;
+  Clock::time_point blocked_until_;
+};
+
+} // namespace fetcher
+} // namespace tziakcha
@@ -24,11 +24,20 @@ struct SessionRecords {
   std::vector<std::string> records;
 };
 
+// Record ids in a saved session document (one session or an array of them),
+// in document order.
+std::vector<std::string> CollectRecordIds(const json& session_json);
+
 class SessionFetcher {
 public:
+  static constexpr size_t kDefaultConcurrency = 4;
+
   explicit SessionFetcher(std::shared_ptr<storage::Storage> storage = nullptr);
 
-  bool fetch_sessions(const std::string& history_key = "history/history");
+  // Fetches up to concurrency sessions at a time. Results are assembled in
+  // history order regardless of which requests finish first.
+  bool fetch_sessions(const std::string& history_key = "history/history",
+                      size_t concurrency             = kDefaultConcurrency);
 
   const std::vector<SessionRecords>& get_grouped_sessions() const {
     return grouped_sessions_;
@@ -50,8 +59,10 @@ private:
   std::map<std::string, RecordParentInfo> record_parent_map_;
 
   bool fetch_session_records(const std::string& session_id,
-                             const std::string& title,
                              std::vector<std::string>& records);
+  void add_parent_info(const std::string& session_id,
+                       const std::string& title,
+                       const std::vector<std::string>& records);
 };
 
 } // namespace fetcher
@@ -1,8 +1,11 @@
 #pragma once
 
 #include "analyzer/game_state.h"
+#include "analyzer/simulator.h"
 #include "calc/fan_calculator.h"
+#include <ostream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace tziakcha {
@@ -73,5 +76,67 @@ private:
   std::vector<int> GetWinPriorityOrder(int discarder_idx) const;
 };
 
+struct RecordInterceptResult {
+  enum class Round { kDraw, kTsumo, kRon };
+
+  bool success = false;
+  std::string error_message;
+  Round round = Round::kDraw;
+  // The round ended in a ron whose potential winners could be checked.
+  bool ron_checked = false;
+  InterceptStatsResult stats{};
+};
+
+// Simulates one record at a time and checks the winning discard of a ron
+// for intercepts. Owns a simulator, so each thread needs its own collector.
+class InterceptCollector {
+public:
+  InterceptCollector();
+
+  InterceptCollector(const InterceptCollector&)            = delete;
+  InterceptCollector& operator=(const InterceptCollector&) = delete;
+
+  RecordInterceptResult Collect(const std::string& round_id,
+                                std::string_view record_json);
+  RecordInterceptResult Collect(const std::string& round_id,
+                                const analyzer::Script& script);
+
+private:
+  analyzer::RecordSimulator simulator_;
+  InterceptStats stats_;
+
+  int last_discard_player_ = -1;
+  int last_discard_step_   = -1;
+  int last_draw_player_    = -1;
+  int last_draw_step_      = -1;
+  bool has_ron_event_      = false;
+  InterceptEvent last_ron_event_{};
+  RecordInterceptResult::Round last_result_;
+
+  void Begin(const std::string& round_id);
+  RecordInterceptResult Finish(const analyzer::SimulationResult& sim);
+
+  void OnAction(const analyzer::Action& action,
+                int step,
+                const analyzer::GameState& state);
+};
+
+// Totals over many records; order of Add calls does not matter.
+struct InterceptSummary {
+  int files_seen     = 0;
+  int files_success  = 0;
+  int total_ron_wins = 0;
+  int intercept_cnt  = 0;
+  int total_events   = 0;
+  int draw_rounds    = 0;
+  int tsumo_rounds   = 0;
+  int ron_rounds     = 0;
+  int ron_calc_ok    = 0;
+  int ron_calc_fail  = 0;
+
+  void Add(const RecordInterceptResult& result);
+  void Print(std::ostream& out) const;
+};
+
 } // namespace stats
 } // namespace tziakcha
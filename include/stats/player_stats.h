@@ -9,6 +9,7 @@ struct PlayerStatsOptions {
   std::string record_dir       = "data/record";
   std::string output_dir       = "data/player";
   std::string session_map_path = "data/sessions/all_record.json";
+  std::string encoding         = "json";
   int limit                    = 0;
   bool verbose                 = false;
 };
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "stats/intercept_stats.h"
+#include "storage/storage.h"
+#include "utils/script_decoder.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace tziakcha {
+namespace stats {
+
+struct RecordPipelineOptions {
+  size_t fetch_workers    = 4;
+  size_t decode_workers   = 2;
+  // Each simulate worker has its own InterceptCollector, but all of them
+  // call into the fan calculator, whose thread safety is not established;
+  // keep this at 1 unless that has been checked.
+  size_t simulate_workers = 1;
+  size_t queue_capacity   = 64;
+
+  // Optional side branch: every fetched record is also saved here under
+  // its id, with the script in script_mode form. The caller flushes it.
+  std::shared_ptr<storage::Storage> persist;
+  utils::ScriptMode script_mode = utils::ScriptMode::kDecoded;
+};
+
+struct RecordPipelineStats {
+  size_t fetched         = 0;
+  size_t fetch_failed    = 0;
+  size_t decode_failed   = 0;
+  size_t persist_failed  = 0;
+  size_t simulated       = 0;
+  double elapsed_seconds = 0;
+};
+
+// Produces the raw record JSON for an id, e.g. from the record endpoint.
+// Called concurrently from the fetch workers.
+using RecordSource =
+    std::function<bool(const std::string& id, std::string& body)>;
+
+// Receives every fetched record's result on the calling thread, in
+// completion order. Records that failed to decode arrive unsuccessful.
+using RecordSink = std::function<void(const std::string& id,
+                                      const RecordInterceptResult& result)>;
+
+// Runs fetch -> decode (ParseRecordScript) -> simulate -> sink with each
+// stage on its own workers, connected by bounded queues, so records are
+// analysed while later ones are still downloading and nothing has to be
+// written to disk and parsed back first.
+RecordPipelineStats RunRecordPipeline(const std::vector<std::string>& ids,
+                                      const RecordSource& source,
+                                      const RecordSink& sink,
+                                      const RecordPipelineOptions& options);
+
+} // namespace stats
+} // namespace tziakcha
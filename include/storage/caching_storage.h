@@ -0,0 +1,67 @@
+#pragma once
+
+#include "storage/storage.h"
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace tziakcha {
+namespace storage {
+
+// Keeps recently used documents parsed in memory in front of another
+// Storage. Writes go through to the wrapped storage before the cache is
+// updated; the cache is bounded by an estimate of the documents' size.
+class CachingStorage : public Storage {
+public:
+  static constexpr size_t kDefaultCapacityBytes = 64u << 20;
+
+  struct CacheStats {
+    uint64_t hits      = 0;
+    uint64_t misses    = 0;
+    uint64_t evictions = 0;
+    size_t entries     = 0;
+    size_t bytes       = 0;
+  };
+
+  explicit CachingStorage(std::shared_ptr<Storage> inner,
+                          size_t capacity_bytes = kDefaultCapacityBytes);
+
+  bool save_json(const std::string& key, const json& data) override;
+  bool save_string(const std::string& key,
+                   const std::string& content) override;
+  bool load_json(const std::string& key, json& data) override;
+  bool load_string(const std::string& key, std::string& out) override;
+  bool load_view(const std::string& key, RecordView& out) override;
+  bool save_many(
+      const std::vector<std::pair<std::string, json>>& items) override;
+  bool exists(const std::string& key) override;
+  bool remove(const std::string& key) override;
+  std::vector<std::string> list_keys(const std::string& prefix) override;
+  void print_json(const std::string& key, int indent = 2) override;
+  bool flush() override;
+
+  CacheStats stats() const;
+  void clear();
+
+private:
+  struct Entry {
+    std::string key;
+    json data;
+    size_t bytes;
+  };
+
+  std::shared_ptr<Storage> inner_;
+  size_t capacity_bytes_;
+
+  std::list<Entry> lru_;
+  std::unordered_map<std::string, std::list<Entry>::iterator> entries_;
+  CacheStats stats_;
+  mutable std::mutex mutex_;
+
+  bool lookup(const std::string& key, json& data);
+  void insert(const std::string& key, const json& data);
+  void erase(const std::string& key);
+};
+
+} // namespace storage
+} // namespace tziakcha
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace tziakcha {
+namespace storage {
+
+// On-disk document encodings. Binary documents keep the usual key/path and
+// are told apart from JSON text by their first bytes: CBOR is written with
+// the self-describe tag (D9 D9 F7) and MessagePack documents always start
+// with a byte >= 0x80, which JSON text only does for a UTF-8 BOM.
+enum class Encoding {
+  kJson,
+  kCbor,
+  kMsgpack,
+};
+
+bool ParseEncoding(const std::string& name, Encoding& encoding);
+const char* EncodingName(Encoding encoding);
+
+// Length of the CBOR self-describe tag that prefixes CBOR documents.
+constexpr size_t kCborPrefixSize = 3;
+
+Encoding DetectEncoding(std::string_view data);
+
+std::string EncodeDocument(const json& data, Encoding encoding);
+bool DecodeDocument(std::string_view data, json& out);
+
+// Runs a nlohmann SAX handler over a document in any encoding, so binary
+// documents are read directly instead of being converted to JSON text.
+template <typename Sax>
+bool SaxParseDocument(std::string_view data, Sax* sax) {
+  const auto* begin = reinterpret_cast<const uint8_t*>(data.data());
+  const auto* end   = begin + data.size();
+  switch (DetectEncoding(data)) {
+  case Encoding::kCbor:
+    return json::sax_parse(
+        begin + kCborPrefixSize, end, sax, json::input_format_t::cbor);
+  case Encoding::kMsgpack:
+    return json::sax_parse(begin, end, sax, json::input_format_t::msgpack);
+  case Encoding::kJson:
+  default:
+    return json::sax_parse(begin, end, sax);
+  }
+}
+
+} // namespace storage
+} // namespace tziakcha
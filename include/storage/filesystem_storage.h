@@ -1,7 +1,10 @@
 #pragma once
 
+#include "storage/encoding.h"
+#include "storage/key_manifest.h"
 #include "storage/storage.h"
 #include <filesystem>
+#include <memory>
 
 namespace fs = std::filesystem;
 
@@ -10,22 +13,81 @@ namespace storage {
 
 class FileSystemStorage : public Storage {
 public:
-  explicit FileSystemStorage(const std::string& base_dir = "data");
+  static constexpr int kMaxShardLevels = 4;
+
+  explicit FileSystemStorage(const std::string& base_dir = "data",
+                             Encoding encoding           = Encoding::kJson);
 
   bool save_json(const std::string& key, const json& data) override;
+  bool save_string(const std::string& key,
+                   const std::string& content) override;
   bool load_json(const std::string& key, json& data) override;
+  bool load_string(const std::string& key, std::string& out) override;
+  bool load_view(const std::string& key, RecordView& out) override;
+  bool load_many(const std::vector<std::string>& keys,
+                 std::vector<json>& out) override;
+  bool save_many(
+      const std::vector<std::pair<std::string, json>>& items) override;
   bool exists(const std::string& key) override;
   bool remove(const std::string& key) override;
   std::vector<std::string> list_keys(const std::string& prefix) override;
   void print_json(const std::string& key, int indent = 2) override;
+  void for_each_key(const std::string& prefix,
+                    const KeyVisitor& visit) override;
+  void for_each_record(const std::string& prefix,
+                       const RecordVisitor& visit,
+                       size_t read_ahead = kDefaultReadAhead) override;
+  bool stream_records(const std::vector<std::string>& keys,
+                      const RecordVisitor& visit,
+                      size_t read_ahead = kDefaultReadAhead) override;
 
   std::string get_base_dir() const { return base_dir_.string(); }
+  Encoding get_encoding() const { return encoding_; }
+
+  // list_keys answers from the key manifest once one exists in base_dir.
+  // A manifest that files written through another root made stale is
+  // rebuilt on open; rebuild it after other changes outside this class.
+  bool has_manifest() const { return manifest_ != nullptr; }
+  bool rebuild_manifest(size_t* key_count = nullptr);
+  bool verify_manifest(std::vector<std::string>* missing = nullptr,
+                       std::vector<std::string>* stale   = nullptr);
+
+  // With N shard levels a key's file sits N hash-prefix directories below
+  // its logical directory, e.g. record/3f/a2/<id>.json for N = 2. The layout
+  // is stored in base_dir; reshard() moves existing files and can be re-run
+  // to finish an interrupted migration.
+  int get_shard_levels() const { return shard_levels_; }
+  bool reshard(int levels, size_t* moved = nullptr);
 
 private:
   fs::path base_dir_;
+  Encoding encoding_;
+  std::unique_ptr<KeyManifest> manifest_;
+  int shard_levels_ = 0;
 
-  fs::path key_to_path(const std::string& key) const;
+  fs::path key_to_path(const std::string& key) const {
+    return key_to_path(key, shard_levels_);
+  }
+  fs::path key_to_path(const std::string& key, int levels) const;
+  // Writes a temp file next to path. With open_fd the file is left open
+  // for the caller to sync and close.
+  bool write_temp(const fs::path& path,
+                  const json& data,
+                  fs::path& temp_path,
+                  int* open_fd = nullptr) const;
+  bool write_temp_bytes(const fs::path& path,
+                        std::string_view bytes,
+                        fs::path& temp_path,
+                        int* open_fd = nullptr) const;
+  bool commit_temp(const fs::path& temp_path, const fs::path& path);
   std::string path_to_key(const fs::path& path) const;
+  bool locate_key(const fs::path& path, int levels, std::string& key) const;
+  bool load_layout();
+  bool save_layout(int levels) const;
+  std::vector<std::string> scan_keys(const std::string& prefix) const;
+  void scan(const std::string& prefix,
+            const KeyVisitor& visit,
+            std::vector<std::string>* dirs = nullptr) const;
 };
 
 } // namespace storage
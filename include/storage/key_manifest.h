@@ -0,0 +1,59 @@
+#pragma once
+
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace tziakcha {
+namespace storage {
+
+// Sorted key index kept next to a FileSystemStorage tree so prefix listings
+// do not have to walk the directory. The file is an append-only journal of
+// "+key" / "-key" lines replayed on load and rewritten when it grows well
+// past the number of live keys. "/dir" lines record the directories of the
+// tree, so files written through another root (a storage opened on a parent
+// or a subdirectory) show up as a directory modified after the manifest.
+class KeyManifest {
+public:
+  static constexpr char kFileName[] = "keys.manifest";
+
+  explicit KeyManifest(const fs::path& base_dir);
+
+  static bool Exists(const fs::path& base_dir);
+
+  bool load();
+  bool rebuild(const std::vector<std::string>& keys,
+               const std::vector<std::string>& dirs);
+
+  bool add(const std::string& key);
+  bool remove(const std::string& key);
+  // Records dir (relative to base_dir, '/'-separated) and its parents.
+  bool add_dir(const std::string& dir);
+
+  // False if a recorded directory changed after the manifest was last
+  // written, or the manifest predates directory tracking.
+  bool is_current() const;
+
+  std::vector<std::string> list(const std::string& prefix) const;
+  size_t size() const;
+
+private:
+  fs::path path_;
+  std::set<std::string> keys_;
+  std::set<std::string> dirs_;
+  size_t journal_lines_ = 0;
+  bool tracks_dirs_     = false;
+  mutable std::mutex mutex_;
+
+  bool append_line(char op, const std::string& key);
+  bool write_snapshot();
+  bool is_current_locked() const;
+  void touch() const;
+};
+
+} // namespace storage
+} // namespace tziakcha
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace tziakcha {
+namespace storage {
+
+// Read-only private mapping of a whole file. The mapping stays valid for as
+// long as any shared_ptr to it (or a RecordView built on it) is alive.
+class MappedFile {
+public:
+  static std::shared_ptr<MappedFile> Open(const std::string& path);
+
+  ~MappedFile();
+
+  MappedFile(const MappedFile&)            = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  std::string_view view() const {
+    return std::string_view(static_cast<const char*>(data_), size_);
+  }
+  size_t size() const { return size_; }
+
+private:
+  MappedFile(void* data, size_t size) : data_(data), size_(size) {}
+
+  void* data_;
+  size_t size_;
+};
+
+} // namespace storage
+} // namespace tziakcha
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "storage/encoding.h"
+#include "storage/mapped_file.h"
+#include "storage/storage.h"
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace fs = std::filesystem;
+
+namespace tziakcha {
+namespace storage {
+
+// Append-only archive: records are appended to large segment files and
+// located through an in-memory offset index rebuilt from the segment headers
+// on open. Removals append a tombstone; compact() drops dead entries.
+//
+// A writer holds an exclusive flock on the archive and truncates a torn
+// tail of the last segment on open. Readers take no lock and index only the
+// complete entries, so they can open the archive while a writer appends.
+class PackedStorage : public Storage {
+public:
+  static constexpr uint64_t kDefaultSegmentBytes = 64ull << 20;
+
+  explicit PackedStorage(const std::string& base_dir = "data",
+                         uint64_t segment_bytes      = kDefaultSegmentBytes,
+                         Encoding encoding           = Encoding::kJson,
+                         OpenMode mode               = OpenMode::kReadWrite);
+  ~PackedStorage() override;
+
+  PackedStorage(const PackedStorage&)            = delete;
+  PackedStorage& operator=(const PackedStorage&) = delete;
+
+  static bool IsArchive(const std::string& base_dir);
+
+  bool save_json(const std::string& key, const json& data) override;
+  bool save_string(const std::string& key,
+                   const std::string& content) override;
+  bool load_json(const std::string& key, json& data) override;
+  bool load_string(const std::string& key, std::string& out) override;
+  bool load_view(const std::string& key, RecordView& out) override;
+  bool save_many(
+      const std::vector<std::pair<std::string, json>>& items) override;
+  bool exists(const std::string& key) override;
+  bool remove(const std::string& key) override;
+  std::vector<std::string> list_keys(const std::string& prefix) override;
+  void print_json(const std::string& key, int indent = 2) override;
+
+  struct CompactionStats {
+    size_t live_records    = 0;
+    size_t segments_before = 0;
+    size_t segments_after  = 0;
+    uint64_t bytes_before  = 0;
+    uint64_t bytes_after   = 0;
+  };
+
+  bool compact(CompactionStats* stats = nullptr);
+
+  size_t record_count() const;
+  uint64_t dead_bytes() const;
+
+  std::string get_base_dir() const { return base_dir_.string(); }
+
+private:
+  struct Location {
+    uint32_t segment;
+    uint64_t offset;
+    uint32_t length;
+  };
+
+  // Open segment descriptor. Readers hold a reference while they read
+  // outside mutex_, so compaction can drop a segment under them.
+  struct SegmentFile;
+
+  struct Segment {
+    std::shared_ptr<SegmentFile> file;
+    uint64_t size = 0;
+  };
+
+  fs::path base_dir_;
+  uint64_t segment_bytes_;
+  Encoding encoding_;
+  std::map<std::string, Location> index_;
+  std::map<uint32_t, Segment> segments_;
+  std::map<uint32_t, std::shared_ptr<MappedFile>> mappings_;
+  uint32_t active_segment_ = 0;
+  uint64_t dead_bytes_     = 0;
+  bool writable_           = false;
+  int lock_fd_             = -1;
+  mutable std::mutex mutex_;
+
+  fs::path segment_path(uint32_t id) const;
+  bool lock_archive();
+  bool open_archive(OpenMode mode);
+  bool scan_segment(uint32_t id, Segment& segment, bool last, OpenMode mode);
+  bool open_segment_for_append(uint32_t id);
+  bool put_value(const std::string& key, const std::string& value);
+  bool append_entry(uint8_t kind,
+                    const std::string& key,
+                    const std::string& value,
+                    Location* location);
+  void put_location(const std::string& key, const Location& location);
+  bool read_value(const Location& location, std::string& out) const;
+  bool map_value(const std::string& key, RecordView& out);
+};
+
+} // namespace storage
+} // namespace tziakcha
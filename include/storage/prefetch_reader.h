@@ -0,0 +1,57 @@
+#pragma once
+
+#include "storage/storage.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace tziakcha {
+namespace storage {
+
+class IoUring;
+
+// Reads a list of whole files while keeping up to queue_depth reads in
+// flight, and hands the contents to a visitor in list order on the calling
+// thread. Reads are issued through io_uring where the kernel allows it and
+// through a pool of reader threads otherwise.
+class PrefetchReader {
+public:
+  enum class Backend { kIoUring, kThreadPool };
+
+  static constexpr size_t kDefaultQueueDepth = 32;
+
+  // ok is false if the file could not be read; view is empty in that case.
+  // Return false to stop reading.
+  using Visitor =
+      std::function<bool(size_t index, bool ok, const RecordView& view)>;
+
+  explicit PrefetchReader(size_t queue_depth = kDefaultQueueDepth,
+                          Backend backend    = Backend::kIoUring);
+  ~PrefetchReader();
+
+  PrefetchReader(const PrefetchReader&)            = delete;
+  PrefetchReader& operator=(const PrefetchReader&) = delete;
+
+  Backend backend() const {
+    return ring_ ? Backend::kIoUring : Backend::kThreadPool;
+  }
+  size_t queue_depth() const { return queue_depth_; }
+
+  // Returns false if the visitor stopped the iteration.
+  bool read(const std::vector<std::string>& paths, const Visitor& visit);
+
+private:
+  size_t queue_depth_;
+  std::unique_ptr<IoUring> ring_;
+
+  bool read_with_ring(const std::vector<std::string>& paths,
+                      const Visitor& visit);
+  bool read_with_threads(const std::vector<std::string>& paths,
+                         const Visitor& visit);
+};
+
+const char* PrefetchBackendName(PrefetchReader::Backend backend);
+
+} // namespace storage
+} // namespace tziakcha
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <functional>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 #include <nlohmann/json.hpp>
 
@@ -9,8 +13,48 @@ using json = nlohmann::json;
 namespace tziakcha {
 namespace storage {
 
+// Read-only view of a stored document. The owner keeps the underlying
+// bytes (a mapping or an owned string) alive for the lifetime of the view.
+// The bytes are the document as stored, which is CBOR or MessagePack for
+// binary encodings; read them with the DecodeDocument or SaxParseDocument
+// helpers of storage/encoding.h.
+class RecordView {
+public:
+  RecordView() = default;
+  RecordView(std::shared_ptr<const void> owner, std::string_view data)
+      : owner_(std::move(owner)), data_(data) {}
+
+  static RecordView FromString(std::string content) {
+    auto owned = std::make_shared<const std::string>(std::move(content));
+    std::string_view data(*owned);
+    return RecordView(std::move(owned), data);
+  }
+
+  std::string_view data() const { return data_; }
+  size_t size() const { return data_.size(); }
+  bool empty() const { return data_.empty(); }
+
+private:
+  std::shared_ptr<const void> owner_;
+  std::string_view data_;
+};
+
+// Readers open storage kReadOnly so that they never modify files a writer
+// may be appending to.
+enum class OpenMode {
+  kReadWrite,
+  kReadOnly,
+};
+
+// Visitors return false to stop the iteration early.
+using KeyVisitor = std::function<bool(const std::string& key)>;
+using RecordVisitor =
+    std::function<bool(const std::string& key, const RecordView& view)>;
+
 class Storage {
 public:
+  static constexpr size_t kDefaultReadAhead = 16;
+
   virtual ~Storage() = default;
 
   virtual bool save_json(const std::string& key, const json& data)      = 0;
@@ -19,6 +63,80 @@ public:
   virtual bool remove(const std::string& key)                           = 0;
   virtual std::vector<std::string> list_keys(const std::string& prefix) = 0;
   virtual void print_json(const std::string& key, int indent = 2)       = 0;
+
+  // Loads a document as JSON text, converting binary documents.
+  virtual bool load_string(const std::string& key, std::string& out) {
+    json data;
+    if (!load_json(key, data)) {
+      return false;
+    }
+    out = data.dump();
+    return true;
+  }
+
+  // Saves a document given as JSON text, e.g. a response body. Backends
+  // that store JSON text write it as given, without parsing it only to dump
+  // it again, so the caller must pass a valid document.
+  virtual bool save_string(const std::string& key,
+                           const std::string& content);
+
+  virtual bool load_view(const std::string& key, RecordView& out) {
+    std::string content;
+    if (!load_string(key, content)) {
+      return false;
+    }
+    out = RecordView::FromString(std::move(content));
+    return true;
+  }
+
+  // Loads every key into the matching slot of out; slots of keys that could
+  // not be loaded are left null. Returns true only if every key loaded.
+  virtual bool load_many(const std::vector<std::string>& keys,
+                         std::vector<json>& out) {
+    out.assign(keys.size(), json());
+    bool ok = true;
+    for (size_t i = 0; i < keys.size(); ++i) {
+      ok = load_json(keys[i], out[i]) && ok;
+    }
+    return ok;
+  }
+
+  // Writes a group of documents. Backends override this to make the whole
+  // group durable with a single sync instead of one per document.
+  virtual bool
+  save_many(const std::vector<std::pair<std::string, json>>& items) {
+    bool ok = true;
+    for (const auto& [key, data] : items) {
+      ok = save_json(key, data) && ok;
+    }
+    return ok;
+  }
+
+  // Barrier: returns once every write issued before the call has reached
+  // the backend, and reports whether all of them succeeded.
+  virtual bool flush() { return true; }
+
+  virtual void for_each_key(const std::string& prefix,
+                            const KeyVisitor& visit) {
+    for (const auto& key : list_keys(prefix)) {
+      if (!visit(key)) {
+        return;
+      }
+    }
+  }
+
+  // Streams documents in for_each_key order while a background thread loads
+  // up to read_ahead documents ahead of the visitor. Keys that fail to load
+  // are skipped.
+  virtual void for_each_record(const std::string& prefix,
+                               const RecordVisitor& visit,
+                               size_t read_ahead = kDefaultReadAhead);
+
+  // Same as for_each_record over an explicit list of keys, in list order.
+  // Returns false if the visitor stopped the iteration.
+  virtual bool stream_records(const std::vector<std::string>& keys,
+                              const RecordVisitor& visit,
+                              size_t read_ahead = kDefaultReadAhead);
 };
 
 } // namespace storage
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "storage/encoding.h"
+#include "storage/storage.h"
+#include <memory>
+#include <string>
+
+namespace tziakcha {
+namespace storage {
+
+enum class StorageBackend {
+  kAuto,
+  kFileSystem,
+  kPacked,
+};
+
+bool ParseStorageBackend(const std::string& name, StorageBackend& backend);
+
+// kAuto opens a packed archive when base_dir already holds one and falls
+// back to one-file-per-key FileSystemStorage otherwise. The encoding only
+// applies to new writes; reads detect the format of each document. Only
+// packed archives act on the mode.
+std::shared_ptr<Storage>
+OpenStorage(const std::string& base_dir,
+            StorageBackend backend = StorageBackend::kAuto,
+            Encoding encoding      = Encoding::kJson,
+            OpenMode mode          = OpenMode::kReadWrite);
+
+} // namespace storage
+} // namespace tziakcha
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "storage/storage.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace tziakcha {
+namespace storage {
+
+// Queues save_json calls and writes them from a background thread in
+// batches through the wrapped storage's save_many. save_string documents
+// are queued as text and passed to the wrapped save_string unchanged.
+// Reads see queued documents immediately; flush() waits until the queue
+// has drained. A failed batch is reported by the next flush(), and until
+// then saves are refused and return false.
+class WriteBehindStorage : public Storage {
+public:
+  static constexpr size_t kDefaultBatchSize  = 64;
+  static constexpr size_t kDefaultMaxPending = 1024;
+
+  explicit WriteBehindStorage(std::shared_ptr<Storage> inner,
+                              size_t batch_size  = kDefaultBatchSize,
+                              size_t max_pending = kDefaultMaxPending);
+  ~WriteBehindStorage() override;
+
+  WriteBehindStorage(const WriteBehindStorage&)            = delete;
+  WriteBehindStorage& operator=(const WriteBehindStorage&) = delete;
+
+  bool save_json(const std::string& key, const json& data) override;
+  bool save_string(const std::string& key,
+                   const std::string& content) override;
+  bool load_json(const std::string& key, json& data) override;
+  bool load_string(const std::string& key, std::string& out) override;
+  bool load_view(const std::string& key, RecordView& out) override;
+  bool exists(const std::string& key) override;
+  bool remove(const std::string& key) override;
+  std::vector<std::string> list_keys(const std::string& prefix) override;
+  void print_json(const std::string& key, int indent = 2) override;
+  bool flush() override;
+
+  size_t written_count() const;
+  size_t failed_count() const;
+
+private:
+  // A queued document as it was given: JSON, or text from save_string.
+  struct Document {
+    json data;
+    std::string text;
+    bool is_text = false;
+  };
+
+  std::shared_ptr<Storage> inner_;
+  size_t batch_size_;
+  size_t max_pending_;
+
+  std::unordered_map<std::string, Document> pending_;
+  std::deque<std::string> order_;
+  std::vector<std::pair<std::string, json>> in_flight_;
+  std::vector<std::pair<std::string, std::string>> in_flight_text_;
+
+  size_t written_count_      = 0;
+  size_t failed_count_       = 0;
+  size_t failed_since_flush_ = 0;
+  bool stopping_             = false;
+
+  mutable std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable idle_cv_;
+  std::thread worker_;
+
+  bool enqueue(const std::string& key, Document document);
+  bool find_queued(const std::string& key, Document& document) const;
+  bool idle() const;
+  // Waits for the queue to drain without taking the failure report.
+  void drain();
+  void run();
+};
+
+} // namespace storage
+} // namespace tziakcha
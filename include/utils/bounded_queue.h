@@ -0,0 +1,66 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+namespace tziakcha {
+namespace utils {
+
+// Blocking multi-producer multi-consumer queue holding at most capacity
+// items, so a fast stage cannot run arbitrarily far ahead of a slow one.
+// Producers call close() once done (one call per queue, after every
+// producer has finished); pop() then drains the rest and returns nullopt.
+template <typename T>
+class BoundedQueue {
+public:
+  explicit BoundedQueue(size_t capacity)
+      : capacity_(capacity > 0 ? capacity : 1) {}
+
+  BoundedQueue(const BoundedQueue&)            = delete;
+  BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+  // Blocks while the queue is full. Returns false if it was closed.
+  bool push(T item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    space_cv_.wait(lock, [&] { return closed_ || items_.size() < capacity_; });
+    if (closed_) {
+      return false;
+    }
+    items_.push_back(std::move(item));
+    ready_cv_.notify_one();
+    return true;
+  }
+
+  // Blocks until an item is available or the queue is closed and empty.
+  std::optional<T> pop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ready_cv_.wait(lock, [&] { return closed_ || !items_.empty(); });
+    if (items_.empty()) {
+      return std::nullopt;
+    }
+    T item = std::move(items_.front());
+    items_.pop_front();
+    space_cv_.notify_one();
+    return item;
+  }
+
+  void close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    ready_cv_.notify_all();
+    space_cv_.notify_all();
+  }
+
+private:
+  size_t capacity_;
+  std::deque<T> items_;
+  bool closed_ = false;
+  std::mutex mutex_;
+  std::condition_variable ready_cv_;
+  std::condition_variable space_cv_;
+};
+
+} // namespace utils
+} // namespace tziakcha
@@ -1,14 +1,74 @@
 #pragma once
 
+#include <memory>
 #include <nlohmann/json.hpp>
 #include <string>
+#include <string_view>
+
+struct z_stream_s;
 
 using json = nlohmann::json;
 
 namespace tziakcha {
 namespace utils {
 
+// Decodes base64+zlib scripts, keeping its zlib stream and buffers from
+// call to call, so decoding many records does no per-call setup and, once
+// warmed up, no allocation. Not thread-safe; use one per thread.
+class ScriptDecoder {
+public:
+  static constexpr size_t kMinOutputSize = 4096;
+
+  ScriptDecoder();
+  ~ScriptDecoder();
+
+  ScriptDecoder(const ScriptDecoder&)            = delete;
+  ScriptDecoder& operator=(const ScriptDecoder&) = delete;
+
+  // Inflates into a buffer owned by the decoder; out stays valid until the
+  // next call. The buffer only ever grows, so once it is large enough no
+  // call allocates or clears it again. size_hint is the expected inflated
+  // size, if known, to size the buffer once.
+  bool Inflate(std::string_view encoded,
+               std::string_view& out,
+               size_t size_hint = 0);
+  // Same, copying the text into out.
+  bool Inflate(std::string_view encoded,
+               std::string& out,
+               size_t size_hint = 0);
+  bool Decode(std::string_view encoded, json& out, size_t size_hint = 0);
+
+private:
+  std::unique_ptr<z_stream_s> stream_;
+  std::string compressed_;
+  std::string text_;
+};
+
+// Uses a per-thread ScriptDecoder.
 bool DecodeScriptToJson(const std::string& encoded, json& out);
+bool EncodeScriptFromJson(const json& script, std::string& encoded);
+
+// Records are stored either with the script expanded into a "step" object
+// and "script" set to "<Decoded>", or with the compact base64+zlib "script"
+// string as served, which readers decode on demand.
+enum class ScriptMode {
+  kDecoded,
+  kCompressed,
+};
+
+bool ParseScriptMode(const std::string& name, ScriptMode& mode);
+
+// Convert a record in place between the two forms.
+bool ExpandRecordScript(json& record);
+bool CompressRecordScript(json& record);
+bool ApplyScriptMode(json& record, ScriptMode mode);
+
+// Same conversion on a record's JSON text as served, without building a
+// DOM: only the top-level "script" string is located and, for kDecoded,
+// inflated and spliced in as "step". Returns false, leaving record
+// unchanged, when the text is not of that plain shape (e.g. an escaped
+// script or a decoded one to compress); use ApplyScriptMode then.
+bool ApplyScriptModeToText(std::string& record, ScriptMode mode);
 
 } // namespace utils
 } // namespace tziakcha
@@ -0,0 +1,198 @@
+#include "analyzer/action_stream.h"
+#include <cstring>
+
+namespace tziakcha {
+namespace analyzer {
+
+namespace {
+
+void PutVarint(uint32_t value, std::string& out) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+// Reads one LEB128 value of up to 32 bits, advancing p. A fifth byte
+// carrying bits past 32 is rejected rather than truncated.
+bool GetVarint(const uint8_t*& p, const uint8_t* end, uint32_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 35 && p < end; shift += 7) {
+    uint8_t byte = *p++;
+    if (shift == 28 && byte > 0x0F) {
+      return false;
+    }
+    value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+    if (byte < 0x80) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Value of the varint in the low bytes of bytes, which holds only the
+// varint's bytes (at most four).
+uint32_t GatherVarint(uint64_t bytes) {
+  bytes &= 0x7F7F7F7F;
+  return static_cast<uint32_t>((bytes & 0x7F) | ((bytes >> 1) & 0x3F80) |
+                               ((bytes >> 2) & 0x1FC000) |
+                               ((bytes >> 3) & 0xFE00000));
+}
+
+// Finds the first varint of at most four bytes in word, returning its
+// value and byte length, or 0 if it is longer.
+int SplitVarint(uint64_t word, uint32_t& value) {
+  uint64_t stops = ~word & 0x80808080;
+  if (stops == 0) {
+    return 0;
+  }
+  uint64_t stop = stops & (~stops + 1);
+  value         = GatherVarint(word & ((stop << 1) - 1));
+  return (__builtin_ctzll(stop) >> 3) + 1;
+}
+
+// Decodes one action from an 8-byte load instead of byte by byte, which
+// keeps the length checks off the hot path. Needs nine readable bytes at
+// p and handles data and deltas of up to four varint bytes each.
+bool DecodeWordAction(const uint8_t*& p,
+                      uint8_t& head,
+                      uint32_t& data,
+                      uint32_t& delta) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  uint64_t word;
+  std::memcpy(&word, p + 1, sizeof(word));
+  int data_len = SplitVarint(word, data);
+  if (data_len == 0) {
+    return false;
+  }
+  int delta_len = SplitVarint(word >> (data_len * 8), delta);
+  if (delta_len == 0) {
+    return false;
+  }
+  head = p[0];
+  p += 1 + data_len + delta_len;
+  return true;
+#else
+  return false;
+#endif
+}
+
+uint32_t ZigZag(int32_t value) {
+  return (static_cast<uint32_t>(value) << 1) ^
+         static_cast<uint32_t>(value >> 31);
+}
+
+int32_t UnZigZag(uint32_t value) {
+  return static_cast<int32_t>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+// Decodes the count-prefixed stream into the columns behind the pointers
+// returned by reserve(count), which is called once.
+template <typename Reserve>
+bool Unpack(std::string_view packed, const Reserve& reserve) {
+  const auto* p   = reinterpret_cast<const uint8_t*>(packed.data());
+  const auto* end = p + packed.size();
+
+  uint32_t count = 0;
+  // Every action takes at least three bytes, which bounds a bogus count.
+  if (!GetVarint(p, end, count) ||
+      count > static_cast<size_t>(end - p) / 3) {
+    return false;
+  }
+
+  auto columns  = reserve(count);
+  uint32_t time = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    uint8_t head;
+    uint32_t data;
+    uint32_t delta;
+    if (end - p < 9 || !DecodeWordAction(p, head, data, delta)) {
+      if (p == end) {
+        return false;
+      }
+      head = *p++;
+      if (!GetVarint(p, end, data) || !GetVarint(p, end, delta)) {
+        return false;
+      }
+    }
+    time += static_cast<uint32_t>(UnZigZag(delta));
+    columns.Set(
+        i, (head >> 4) & 3, head & 15, data, static_cast<int32_t>(time));
+  }
+  return p == end;
+}
+
+} // namespace
+
+void PackActions(const std::vector<Action>& actions, std::string& out) {
+  out.clear();
+  out.reserve(5 + actions.size() * 8);
+  PutVarint(static_cast<uint32_t>(actions.size()), out);
+
+  uint32_t prev_time = 0;
+  for (const auto& action : actions) {
+    uint32_t time = static_cast<uint32_t>(action.time_ms);
+    out.push_back(static_cast<char>((action.player_idx & 3) << 4 |
+                                    (action.action_type & 15)));
+    PutVarint(static_cast<uint32_t>(action.data), out);
+    PutVarint(ZigZag(static_cast<int32_t>(time - prev_time)), out);
+    prev_time = time;
+  }
+}
+
+bool UnpackActions(std::string_view packed, ActionColumns& out) {
+  struct Columns {
+    uint8_t* player;
+    uint8_t* type;
+    int32_t* data;
+    int32_t* time_ms;
+
+    void Set(uint32_t i, int p, int t, uint32_t d, int32_t time) {
+      player[i]  = static_cast<uint8_t>(p);
+      type[i]    = static_cast<uint8_t>(t);
+      data[i]    = static_cast<int32_t>(d);
+      time_ms[i] = time;
+    }
+  };
+
+  bool ok = Unpack(packed, [&](uint32_t count) {
+    out.player.resize(count);
+    out.type.resize(count);
+    out.data.resize(count);
+    out.time_ms.resize(count);
+    return Columns{out.player.data(),
+                   out.type.data(),
+                   out.data.data(),
+                   out.time_ms.data()};
+  });
+  if (!ok) {
+    out.player.clear();
+    out.type.clear();
+    out.data.clear();
+    out.time_ms.clear();
+  }
+  return ok;
+}
+
+bool UnpackActions(std::string_view packed, std::vector<Action>& out) {
+  struct Rows {
+    Action* actions;
+
+    void Set(uint32_t i, int p, int t, uint32_t d, int32_t time) {
+      actions[i] = {p, t, static_cast<int>(d), time};
+    }
+  };
+
+  bool ok = Unpack(packed, [&](uint32_t count) {
+    out.resize(count);
+    return Rows{out.data()};
+  });
+  if (!ok) {
+    out.clear();
+  }
+  return ok;
+}
+
+} // namespace analyzer
+} // namespace tziakcha
@@ -1,5 +1,7 @@
 #include "analyzer/core.h"
 #include "analyzer/record_printer.h"
+#include "storage/mapped_file.h"
+#include "storage/storage_factory.h"
 #include <cxxopts.hpp>
 #include <glog/logging.h>
 #include <fstream>
@@ -8,15 +10,6 @@
 
 namespace fs = std::filesystem;
 
-std::string ReadFile(const std::string& filepath) {
-  std::ifstream file(filepath);
-  if (!file.is_open()) {
-    throw std::runtime_error("Cannot open file: " + filepath);
-  }
-  return std::string(
-      (std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-}
-
 void PrintUsage() {
   std::cout << "Tziakcha Record Analyzer - Analyzer CLI\n\n";
   std::cout << "Usage:\n";
@@ -60,7 +53,7 @@ int CmdAnalyze(int argc, char* argv[]) {
     FLAGS_minloglevel = 0;
   }
 
-  std::string record_json_str;
+  tziakcha::storage::RecordView record_view;
 
   if (result.count("file")) {
     std::string filepath = result["file"].as<std::string>();
@@ -69,15 +62,18 @@ int CmdAnalyze(int argc, char* argv[]) {
       return 1;
     }
 
-    try {
-      record_json_str = ReadFile(filepath);
-      LOG(INFO) << "Loaded record from file: " << filepath;
-    } catch (const std::exception& e) {
-      std::cerr << "Error reading file: " << e.what() << std::endl;
+    auto mapped = tziakcha::storage::MappedFile::Open(filepath);
+    if (!mapped) {
+      std::cerr << "Error reading file: Cannot open file: " << filepath
+                << std::endl;
       return 1;
     }
+    std::string_view data = mapped->view();
+    record_view = tziakcha::storage::RecordView(std::move(mapped), data);
+    LOG(INFO) << "Loaded record from file: " << filepath;
   } else if (result.count("json")) {
-    record_json_str = result["json"].as<std::string>();
+    record_view = tziakcha::storage::RecordView::FromString(
+        result["json"].as<std::string>());
     LOG(INFO) << "Using provided JSON string";
   } else {
     std::cerr << "Error: Either --file or --json is required" << std::endl;
@@ -87,7 +83,7 @@ int CmdAnalyze(int argc, char* argv[]) {
 
   try {
     auto& analyzer       = tziakcha::analyzer::RecordAnalyzer::GetInstance();
-    auto analysis_result = analyzer.Analyze(record_json_str);
+    auto analysis_result = analyzer.Analyze(record_view.data());
 
     if (!analysis_result.success) {
       std::cerr << "Analysis failed: " << analysis_result.error_message
@@ -161,12 +157,15 @@ int CmdBatch(int argc, char* argv[]) {
   cxxopts::Options options(
       "analyzer_cli batch", "Analyze multiple records from a directory");
   options.add_options()("d,directory",
-                        "Directory containing record JSON files",
+                        "Record directory or packed archive",
                         cxxopts::value<std::string>())(
       "p,pattern",
       "File pattern to match (default: *.json)",
       cxxopts::value<std::string>()->default_value("*.json"))(
       "s,summary", "Output summary to file", cxxopts::value<std::string>())(
+      "q,queue-depth",
+      "Number of record reads kept in flight",
+      cxxopts::value<size_t>()->default_value("32"))(
       "v,verbose",
       "Enable verbose logging",
       cxxopts::value<bool>()->default_value("false"))("h,help", "Print help");
@@ -199,19 +198,20 @@ int CmdBatch(int argc, char* argv[]) {
 
   auto& analyzer = tziakcha::analyzer::RecordAnalyzer::GetInstance();
 
-  std::vector<std::string> json_files;
   int success_count = 0;
   int error_count   = 0;
 
   std::cout << "Scanning directory: " << directory << std::endl;
 
-  for (const auto& entry : fs::recursive_directory_iterator(directory)) {
-    if (entry.is_regular_file() && entry.path().extension() == ".json") {
-      json_files.push_back(entry.path().string());
-    }
-  }
+  auto storage = tziakcha::storage::OpenStorage(
+      directory,
+      tziakcha::storage::StorageBackend::kAuto,
+      tziakcha::storage::Encoding::kJson,
+      tziakcha::storage::OpenMode::kReadOnly);
+
+  auto record_keys = storage->list_keys("");
 
-  std::cout << "Found " << json_files.size() << " JSON files to process"
+  std::cout << "Found " << record_keys.size() << " records to process"
             << std::endl;
   std::cout << std::endl;
 
@@ -225,15 +225,16 @@ int CmdBatch(int argc, char* argv[]) {
     }
   }
 
-  for (size_t i = 0; i < json_files.size(); ++i) {
-    const auto& filepath = json_files[i];
+  size_t queue_depth = result["queue-depth"].as<size_t>();
+  size_t loaded      = 0;
 
-    std::cout << "[" << (i + 1) << "/" << json_files.size()
-              << "] Processing: " << filepath << std::endl;
+  auto process = [&](const std::string& record_key,
+                     const tziakcha::storage::RecordView& record_view) {
+    std::cout << "[" << (++loaded) << "/" << record_keys.size()
+              << "] Processing: " << record_key << std::endl;
 
     try {
-      std::string record_json_str = ReadFile(filepath);
-      auto analysis_result        = analyzer.Analyze(record_json_str);
+      auto analysis_result = analyzer.Analyze(record_view.data());
 
       if (analysis_result.success) {
         const auto& win_info = analysis_result.win_analysis;
@@ -241,7 +242,7 @@ int CmdBatch(int argc, char* argv[]) {
                   << " | Fan: " << win_info.total_fan << std::endl;
 
         if (summary_file.is_open()) {
-          summary_file << filepath << "\t" << win_info.winner_name << "\t"
+          summary_file << record_key << "\t" << win_info.winner_name << "\t"
                        << win_info.total_fan << "\t" << win_info.base_fan
                        << "\t" << win_info.flower_count << "\n";
         }
@@ -257,11 +258,20 @@ int CmdBatch(int argc, char* argv[]) {
       std::cerr << "  ✗ Exception: " << e.what() << std::endl;
       error_count++;
     }
+    return true;
+  };
+
+  storage->stream_records(record_keys, process, queue_depth);
+
+  if (loaded < record_keys.size()) {
+    std::cerr << "Failed to load " << (record_keys.size() - loaded)
+              << " records" << std::endl;
+    error_count += static_cast<int>(record_keys.size() - loaded);
   }
 
   std::cout << std::endl;
   std::cout << "========== Batch Analysis Summary ==========" << std::endl;
-  std::cout << "Total files: " << json_files.size() << std::endl;
+  std::cout << "Total records: " << record_keys.size() << std::endl;
   std::cout << "Success: " << success_count << std::endl;
   std::cout << "Failed: " << error_count << std::endl;
 
@@ -6,7 +6,7 @@ namespace analyzer {
 
 RecordAnalyzer::RecordAnalyzer() : simulator_() {}
 
-SimulationResult RecordAnalyzer::Analyze(const std::string& record_json_str) {
+SimulationResult RecordAnalyzer::Analyze(std::string_view record_json_str) {
   try {
     return simulator_.Simulate(record_json_str);
   } catch (const std::exception& e) {
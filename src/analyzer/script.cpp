@@ -0,0 +1,657 @@
+#include "analyzer/script.h"
+#include "storage/encoding.h"
+#include "utils/script_decoder.h"
+#include <algorithm>
+#include <charconv>
+
+namespace tziakcha {
+namespace analyzer {
+
+namespace {
+
+constexpr size_t kNoRoot = std::string::npos;
+
+// What a value is, judged from the containers and keys above it.
+enum class Slot {
+  kNone,
+  kWall,
+  kDice,
+  kRound,
+  kWinFlags,
+  kTimestamp,
+  kTitle,
+  kPlayer,
+  kPlayerId,
+  kPlayerName,
+  kPlayerElo,
+  kWin,
+  kWinTotal,
+  kWinHand,
+  kWinFan,
+  kAction,
+  kActionField,
+};
+
+struct Scalar {
+  enum Kind { kNull, kBool, kInteger, kUnsigned, kFloat, kString };
+
+  Kind kind         = kNull;
+  bool boolean      = false;
+  int64_t integer   = 0;
+  uint64_t natural  = 0;
+  double real       = 0;
+  std::string* text = nullptr;
+
+  bool AsInteger(int64_t& out) const {
+    if (kind == kInteger) {
+      out = integer;
+      return true;
+    }
+    if (kind == kUnsigned && natural <= INT64_MAX) {
+      out = static_cast<int64_t>(natural);
+      return true;
+    }
+    return false;
+  }
+};
+
+// Writes v as json::dump() would.
+void AppendScalar(const Scalar& v, std::string& out) {
+  switch (v.kind) {
+  case Scalar::kNull:
+    out += "null";
+    break;
+  case Scalar::kBool:
+    out += v.boolean ? "true" : "false";
+    break;
+  case Scalar::kInteger:
+    out += std::to_string(v.integer);
+    break;
+  case Scalar::kUnsigned:
+    out += std::to_string(v.natural);
+    break;
+  case Scalar::kFloat:
+    out += json(v.real).dump();
+    break;
+  case Scalar::kString:
+    out += json(*v.text).dump();
+    break;
+  }
+}
+
+int HexDigit(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+bool DecodeWall(std::string_view hex, std::vector<uint8_t>& wall) {
+  wall.clear();
+  wall.reserve((hex.size() + 1) / 2);
+  for (size_t i = 0; i < hex.size(); i += 2) {
+    int value = HexDigit(hex[i]);
+    if (i + 1 < hex.size()) {
+      int low = HexDigit(hex[i + 1]);
+      value   = low < 0 ? -1 : value << 4 | low;
+    }
+    if (value < 0) {
+      return false;
+    }
+    wall.push_back(static_cast<uint8_t>(value));
+  }
+  return true;
+}
+
+// Orders a win's fans by the text of their ids, the order in which a json
+// DOM iterated the "t" object, so output keeps listing tied fans the same
+// way regardless of the order the server wrote them in.
+void SortFans(std::vector<std::pair<int, int>>& fans) {
+  std::stable_sort(fans.begin(), fans.end(), [](const auto& a, const auto& b) {
+    return std::to_string(a.first) < std::to_string(b.first);
+  });
+}
+
+// nlohmann SAX handler filling a Script. In record mode the script is the
+// top-level "step" object, the "script" string is kept for decoding and
+// the record's header is filled too; header_only skips everything else.
+// The "h" of a win is re-serialized as it streams past.
+class ScriptSax {
+public:
+  ScriptSax(Script& script, bool record, bool header_only = false)
+      : script_(script), record_(record), header_only_(header_only) {}
+
+  bool found() const { return found_; }
+  bool has_encoded() const { return has_encoded_; }
+  const std::string& encoded() const { return encoded_; }
+  const char* error() const { return error_; }
+
+  bool null() { return OnScalar(Scalar{}); }
+
+  bool boolean(bool val) {
+    Scalar v;
+    v.kind    = Scalar::kBool;
+    v.boolean = val;
+    return OnScalar(v);
+  }
+
+  bool number_integer(json::number_integer_t val) {
+    Scalar v;
+    v.kind    = Scalar::kInteger;
+    v.integer = val;
+    return OnScalar(v);
+  }
+
+  bool number_unsigned(json::number_unsigned_t val) {
+    Scalar v;
+    v.kind    = Scalar::kUnsigned;
+    v.natural = val;
+    return OnScalar(v);
+  }
+
+  bool number_float(json::number_float_t val, const json::string_t&) {
+    Scalar v;
+    v.kind = Scalar::kFloat;
+    v.real = val;
+    return OnScalar(v);
+  }
+
+  bool string(json::string_t& val) {
+    Scalar v;
+    v.kind = Scalar::kString;
+    v.text = &val;
+    return OnScalar(v);
+  }
+
+  bool binary(json::binary_t&) { return true; }
+
+  bool start_object(std::size_t) { return Open(false); }
+  bool end_object() { return Close(); }
+  bool start_array(std::size_t) { return Open(true); }
+  bool end_array() { return Close(); }
+
+  bool key(json::string_t& val) {
+    Frame& frame = stack_.back();
+    if (capture_) {
+      if (frame.count > 0) {
+        capture_->push_back(',');
+      }
+      *capture_ += json(val).dump();
+      capture_->push_back(':');
+    }
+    frame.key = std::move(val);
+    frame.count++;
+    return true;
+  }
+
+  bool parse_error(std::size_t, const std::string&, const json::exception&) {
+    return false;
+  }
+
+private:
+  struct Frame {
+    bool array;
+    Slot slot;
+    // Members seen so far in an object, values in an array.
+    size_t count = 0;
+    std::string key;
+  };
+
+  Script& script_;
+  bool record_;
+  bool header_only_;
+  bool step_timestamp_ = false;
+  std::vector<Frame> stack_;
+  size_t root_ = kNoRoot;
+  bool found_  = false;
+
+  bool has_encoded_ = false;
+  std::string encoded_;
+  const char* error_ = nullptr;
+
+  std::string* capture_ = nullptr;
+  size_t capture_depth_ = 0;
+
+  int action_fields_ = 0;
+  bool action_valid_ = false;
+  int64_t action_[3] = {};
+
+  Slot Locate() const {
+    if (root_ == kNoRoot || stack_.size() <= root_) {
+      return Slot::kNone;
+    }
+    size_t depth              = stack_.size() - root_;
+    const std::string& member = stack_[root_].key;
+    if (depth == 1) {
+      if (member == "w") {
+        return Slot::kWall;
+      }
+      if (member == "d") {
+        return Slot::kDice;
+      }
+      if (member == "i") {
+        return Slot::kRound;
+      }
+      if (member == "b") {
+        return Slot::kWinFlags;
+      }
+      if (member == "t") {
+        return Slot::kTimestamp;
+      }
+      return Slot::kNone;
+    }
+
+    const Frame& outer = stack_[root_ + 1];
+    if (depth == 2) {
+      if (member == "g" && !outer.array && outer.key == "t") {
+        return Slot::kTitle;
+      }
+      if (!outer.array) {
+        return Slot::kNone;
+      }
+      if (member == "p") {
+        return Slot::kPlayer;
+      }
+      if (member == "y") {
+        return Slot::kWin;
+      }
+      if (member == "a") {
+        return Slot::kAction;
+      }
+      return Slot::kNone;
+    }
+
+    if (!outer.array) {
+      return Slot::kNone;
+    }
+    const Frame& entry = stack_[root_ + 2];
+    if (depth == 3) {
+      if (member == "a" && entry.array) {
+        return Slot::kActionField;
+      }
+      if (entry.array) {
+        return Slot::kNone;
+      }
+      if (member == "p") {
+        if (entry.key == "i") {
+          return Slot::kPlayerId;
+        }
+        if (entry.key == "n") {
+          return Slot::kPlayerName;
+        }
+        if (entry.key == "e") {
+          return Slot::kPlayerElo;
+        }
+      } else if (member == "y") {
+        if (entry.key == "f") {
+          return Slot::kWinTotal;
+        }
+        if (entry.key == "h") {
+          return Slot::kWinHand;
+        }
+      }
+      return Slot::kNone;
+    }
+
+    if (depth == 4 && member == "y" && !entry.array && entry.key == "t" &&
+        !stack_[root_ + 3].array) {
+      return Slot::kWinFan;
+    }
+    return Slot::kNone;
+  }
+
+  // A scalar member of the record object itself.
+  void OnRecordMember(const std::string& key,
+                      const Scalar& v,
+                      bool is_int,
+                      int64_t n) {
+    if (key == "script") {
+      has_encoded_ = true;
+      if (v.kind == Scalar::kString && !header_only_) {
+        encoded_ = std::move(*v.text);
+      }
+    } else if (key == "id" && v.kind == Scalar::kString) {
+      script_.header.id = *v.text;
+    } else if (key == "belongs" && v.kind == Scalar::kString) {
+      script_.header.session = *v.text;
+    } else if (key == "t" && is_int && !step_timestamp_) {
+      script_.header.timestamp = n;
+    }
+  }
+
+  // Counts a finished value in the enclosing array.
+  void Next() {
+    if (!stack_.empty() && stack_.back().array) {
+      stack_.back().count++;
+    }
+  }
+
+  void CaptureSeparator() {
+    if (stack_.size() > capture_depth_ && stack_.back().array &&
+        stack_.back().count > 0) {
+      capture_->push_back(',');
+    }
+  }
+
+  bool OnScalar(const Scalar& v) {
+    if (capture_) {
+      CaptureSeparator();
+      AppendScalar(v, *capture_);
+      Next();
+      return true;
+    }
+
+    int64_t n   = 0;
+    bool is_int = v.AsInteger(n);
+    Slot slot   = Locate();
+    if (header_only_ && slot != Slot::kTimestamp) {
+      slot = Slot::kNone;
+    }
+    switch (slot) {
+    case Slot::kWall:
+      if (v.kind == Scalar::kString) {
+        if (!DecodeWall(*v.text, script_.wall)) {
+          error_ = "Invalid wall data";
+          return false;
+        }
+        script_.has_wall = true;
+      }
+      break;
+    case Slot::kDice:
+      if (is_int) {
+        script_.dice     = static_cast<int>(n);
+        script_.has_dice = true;
+      }
+      break;
+    case Slot::kRound:
+      if (is_int) {
+        script_.round = static_cast<int>(n);
+      }
+      break;
+    case Slot::kWinFlags:
+      if (is_int) {
+        script_.win_flags = static_cast<int>(n);
+      }
+      break;
+    case Slot::kTimestamp:
+      if (is_int) {
+        script_.timestamp = n;
+        if (record_) {
+          script_.header.timestamp = n;
+          step_timestamp_          = true;
+        }
+      }
+      break;
+    case Slot::kTitle:
+      if (v.kind == Scalar::kString) {
+        script_.title = std::move(*v.text);
+      }
+      break;
+    case Slot::kPlayer:
+      script_.players.emplace_back();
+      break;
+    case Slot::kPlayerId:
+      if (v.kind == Scalar::kString) {
+        script_.players.back().id = std::move(*v.text);
+      }
+      break;
+    case Slot::kPlayerName:
+      if (v.kind == Scalar::kString) {
+        script_.players.back().name = std::move(*v.text);
+      }
+      break;
+    case Slot::kPlayerElo:
+      if (v.kind == Scalar::kFloat) {
+        script_.players.back().elo = v.real;
+      } else if (is_int) {
+        script_.players.back().elo = static_cast<double>(n);
+      }
+      break;
+    case Slot::kWin:
+      script_.wins.emplace_back();
+      break;
+    case Slot::kWinTotal:
+      if (is_int) {
+        script_.wins.back().total_fan = static_cast<int>(n);
+      }
+      break;
+    case Slot::kWinHand:
+      AppendScalar(v, script_.wins.back().hand);
+      break;
+    case Slot::kWinFan: {
+      const std::string& id = stack_.back().key;
+      const char* last      = id.data() + id.size();
+      int fan_id            = 0;
+      auto [end, ec]        = std::from_chars(id.data(), last, fan_id);
+      if (is_int && ec == std::errc() && end == last) {
+        script_.wins.back().fans.emplace_back(fan_id, static_cast<int>(n));
+      }
+      break;
+    }
+    case Slot::kActionField:
+      if (action_fields_ < 3) {
+        action_[action_fields_] = n;
+        action_valid_           = action_valid_ && is_int;
+      }
+      action_fields_++;
+      break;
+    case Slot::kAction:
+      break;
+    case Slot::kNone:
+      if (record_ && stack_.size() == 1) {
+        OnRecordMember(stack_[0].key, v, is_int, n);
+      }
+      break;
+    }
+    Next();
+    return true;
+  }
+
+  bool Open(bool array) {
+    if (capture_) {
+      CaptureSeparator();
+      capture_->push_back(array ? '[' : '{');
+      stack_.push_back({array, Slot::kNone, 0, {}});
+      return true;
+    }
+
+    Slot slot = header_only_ ? Slot::kNone : Locate();
+    switch (slot) {
+    case Slot::kPlayer:
+      script_.players.emplace_back();
+      break;
+    case Slot::kWin:
+      script_.wins.emplace_back();
+      break;
+    case Slot::kWinHand:
+      capture_       = &script_.wins.back().hand;
+      capture_depth_ = stack_.size();
+      capture_->push_back(array ? '[' : '{');
+      break;
+    case Slot::kAction:
+      action_fields_ = 0;
+      action_valid_  = true;
+      break;
+    default:
+      break;
+    }
+
+    bool is_root = !array && !found_ && root_ == kNoRoot &&
+                   (record_ ? stack_.size() == 1 && stack_[0].key == "step"
+                            : stack_.empty());
+    if (is_root) {
+      root_ = stack_.size();
+    }
+    stack_.push_back({array, slot, 0, {}});
+    return true;
+  }
+
+  bool Close() {
+    Frame frame = std::move(stack_.back());
+    stack_.pop_back();
+
+    if (capture_) {
+      capture_->push_back(frame.array ? ']' : '}');
+      if (stack_.size() == capture_depth_) {
+        capture_ = nullptr;
+      }
+      Next();
+      return true;
+    }
+
+    if (frame.slot == Slot::kAction && frame.array && action_valid_ &&
+        action_fields_ >= 3) {
+      int combined = static_cast<int>(action_[0]);
+      script_.actions.push_back({(combined >> 4) & 3,
+                                 combined & 15,
+                                 static_cast<int>(action_[1]),
+                                 static_cast<int>(action_[2])});
+    }
+    if (frame.slot == Slot::kWin && !frame.array) {
+      SortFans(script_.wins.back().fans);
+    }
+    if (stack_.size() == root_) {
+      root_  = kNoRoot;
+      found_ = true;
+    }
+    Next();
+    return true;
+  }
+};
+
+// Replays a json value as SAX events.
+bool Walk(const json& value, ScriptSax& sax) {
+  switch (value.type()) {
+  case json::value_t::object:
+    if (!sax.start_object(value.size())) {
+      return false;
+    }
+    for (const auto& [key, member] : value.items()) {
+      json::string_t name = key;
+      if (!sax.key(name) || !Walk(member, sax)) {
+        return false;
+      }
+    }
+    return sax.end_object();
+  case json::value_t::array:
+    if (!sax.start_array(value.size())) {
+      return false;
+    }
+    for (const auto& element : value) {
+      if (!Walk(element, sax)) {
+        return false;
+      }
+    }
+    return sax.end_array();
+  case json::value_t::string: {
+    json::string_t text = value.get_ref<const json::string_t&>();
+    return sax.string(text);
+  }
+  case json::value_t::boolean:
+    return sax.boolean(value.get<bool>());
+  case json::value_t::number_integer:
+    return sax.number_integer(value.get<json::number_integer_t>());
+  case json::value_t::number_unsigned:
+    return sax.number_unsigned(value.get<json::number_unsigned_t>());
+  case json::value_t::number_float:
+    return sax.number_float(value.get<json::number_float_t>(), "");
+  default:
+    return sax.null();
+  }
+}
+
+void SetError(std::string* error, const char* message) {
+  if (error) {
+    *error = message;
+  }
+}
+
+bool ParseEncodedScript(std::string_view encoded,
+                        Script& script,
+                        std::string* error) {
+  if (encoded == "<Decoded>") {
+    SetError(error, "Script marked as decoded but step field missing");
+    return false;
+  }
+
+  thread_local utils::ScriptDecoder decoder;
+  std::string_view text;
+  if (!decoder.Inflate(encoded, text)) {
+    SetError(error, "Failed to decode script");
+    return false;
+  }
+  RecordHeader header = std::move(script.header);
+  bool parsed         = ParseScript(text, script);
+  script.header       = std::move(header);
+  if (!parsed) {
+    SetError(error, "Failed to parse script");
+    return false;
+  }
+  return true;
+}
+
+// Completes a record parsed by sax: inflates the "script" string if the
+// record had no "step".
+bool FinishRecordScript(const ScriptSax& sax,
+                        Script& script,
+                        std::string* error) {
+  if (sax.found()) {
+    return true;
+  }
+  if (!sax.has_encoded()) {
+    SetError(error, "Script field not found in record");
+    return false;
+  }
+  return ParseEncodedScript(sax.encoded(), script, error);
+}
+
+} // namespace
+
+bool ParseScript(std::string_view text, Script& script) {
+  script = Script();
+  ScriptSax sax(script, false);
+  return json::sax_parse(text.begin(), text.end(), &sax);
+}
+
+bool ParseRecordScript(std::string_view record,
+                       Script& script,
+                       std::string* error) {
+  script = Script();
+  ScriptSax sax(script, true);
+  if (!storage::SaxParseDocument(record, &sax)) {
+    SetError(error, sax.error() ? sax.error() : "Failed to parse JSON");
+    return false;
+  }
+  return FinishRecordScript(sax, script, error);
+}
+
+bool ParseRecordHeader(std::string_view record, RecordHeader& header) {
+  Script script;
+  ScriptSax sax(script, true, true);
+  if (!storage::SaxParseDocument(record, &sax)) {
+    return false;
+  }
+  header = std::move(script.header);
+  return true;
+}
+
+bool ExtractRecordScript(const json& record,
+                         Script& script,
+                         std::string* error) {
+  script = Script();
+  ScriptSax sax(script, true);
+  if (!Walk(record, sax)) {
+    SetError(error, sax.error() ? sax.error() : "Failed to parse script");
+    return false;
+  }
+  return FinishRecordScript(sax, script, error);
+}
+
+} // namespace analyzer
+} // namespace tziakcha
@@ -17,37 +17,28 @@ void RecordSimulator::AddActionObserver(ActionObserver observer) {
 
 void RecordSimulator::ClearActionObservers() { action_observers_.clear(); }
 
-SimulationResult RecordSimulator::Simulate(const std::string& record_json_str) {
+SimulationResult RecordSimulator::Simulate(std::string_view record_json_str) {
+  if (!parser_.Parse(record_json_str)) {
+    SimulationResult result;
+    result.success       = false;
+    result.error_message = parser_.GetError();
+    LOG(ERROR) << result.error_message;
+    return result;
+  }
+
+  LOG(INFO) << "Record parsed successfully";
+  return Simulate(parser_.GetScript());
+}
+
+SimulationResult RecordSimulator::Simulate(const Script& script) {
   SimulationResult result;
   result.success = false;
 
   try {
     LOG(INFO) << "=== Starting record simulation ===";
 
-    json record_json;
-    try {
-      record_json = json::parse(record_json_str);
-    } catch (const std::exception& e) {
-      result.error_message = std::string("Failed to parse JSON: ") + e.what();
-      LOG(ERROR) << result.error_message;
-      return result;
-    }
-
-    if (record_json.contains("script") && record_json["script"].is_string() &&
-        record_json["script"].get<std::string>() == "<Decoded>" &&
-        !record_json.contains("step")) {
-      result.error_message = "Script already decoded but step field missing";
-      LOG(ERROR) << result.error_message;
-      return result;
-    }
-
-    if (!parser_.Parse(record_json_str)) {
-      result.error_message = "Failed to parse record";
-      LOG(ERROR) << result.error_message;
-      return result;
-    }
-
-    LOG(INFO) << "Record parsed successfully";
+    script_         = &script;
+    round_wind_idx_ = (script.round / 4) % 4;
 
     state_.Reset();
     step_logs_.clear();
@@ -61,7 +52,7 @@ SimulationResult RecordSimulator::Simulate(const std::string& record_json_str) {
 
     result.success = true;
     analyzer_.SetGameState(state_);
-    analyzer_.SetScriptData(parser_.GetScriptData());
+    analyzer_.SetScript(script);
     result.win_analysis       = analyzer_.Analyze();
     result.game_log           = game_log_;
     result.game_log.step_logs = step_logs_;
@@ -78,19 +69,14 @@ SimulationResult RecordSimulator::Simulate(const std::string& record_json_str) {
 void RecordSimulator::ProcessGameInfoAndSetup() {
   LOG(INFO) << "Setting up game and dealing initial tiles";
 
-  const auto& script_data = parser_.GetScriptData();
+  const auto& script = *script_;
 
-  if (!script_data.contains("w")) {
+  if (!script.has_wall) {
     LOG(ERROR) << "Wall data not found in script";
     return;
   }
 
-  std::string wall_hex = script_data["w"].get<std::string>();
-  std::vector<int> wall_indices;
-  for (size_t i = 0; i < wall_hex.length(); i += 2) {
-    std::string hex_pair = wall_hex.substr(i, 2);
-    wall_indices.push_back(std::stoi(hex_pair, nullptr, 16));
-  }
+  std::vector<int> wall_indices(script.wall.begin(), script.wall.end());
 
   LOG(INFO) << "Wall loaded with " << wall_indices.size() << " tiles";
   LOG(INFO) << "DEBUG: First 20 wall tiles: ";
@@ -98,12 +84,12 @@ void RecordSimulator::ProcessGameInfoAndSetup() {
     LOG(INFO) << "  wall[" << i << "] = " << wall_indices[i];
   }
 
-  if (!script_data.contains("d")) {
+  if (!script.has_dice) {
     LOG(ERROR) << "Dice data not found in script";
     return;
   }
 
-  int dice_val            = script_data["d"].get<int>();
+  int dice_val            = script.dice;
   std::array<int, 4> dice = {
       dice_val & 15,
       (dice_val >> 4) & 15,
@@ -125,19 +111,17 @@ void RecordSimulator::ProcessGameInfoAndSetup() {
 }
 
 void RecordSimulator::LogGameInfo() {
-  const auto& script_data = parser_.GetScriptData();
-  const auto& game_config = parser_.GetGameConfig();
-  const auto& player_info = parser_.GetPlayerInfo();
+  const auto& script = *script_;
 
-  if (game_config.contains("t")) {
-    game_log_.game_title = game_config["t"].get<std::string>();
+  if (!script.title.empty()) {
+    game_log_.game_title = script.title;
     LOG(INFO) << "Game title: " << game_log_.game_title;
   }
 
   game_log_.dealer_idx = state_.GetDealerIdx();
-  if (player_info.is_array() && player_info.size() == 4) {
+  if (script.players.size() == 4) {
     for (size_t i = 0; i < 4; ++i) {
-      std::string name = player_info[i]["n"].get<std::string>();
+      const std::string& name = script.players[i].name;
       game_log_.player_names.push_back(name);
       LOG(INFO) << base::WIND[i] << "家: " << name;
     }
@@ -147,12 +131,13 @@ void RecordSimulator::LogGameInfo() {
 void RecordSimulator::ProcessAllActions() {
   LOG(INFO) << "Processing game actions";
 
-  const auto& actions = parser_.GetActions();
+  const auto& actions = script_->actions;
   int prev_time       = 0;
   int step_number     = 0;
   size_t action_idx   = 0;
 
-  for (const auto& action : actions) {
+  for (; action_idx < actions.size(); ++action_idx) {
+    const Action action = actions[action_idx];
     int time_elapsed_ms = action.time_ms - prev_time;
     step_number++;
 
@@ -188,37 +173,34 @@ void RecordSimulator::ProcessAllActions() {
         }
       }
 
-      const auto& script_data = parser_.GetScriptData();
-      if (script_data.contains("b")) {
-        int win_flags        = script_data["b"].get<int>();
-        int script_winner    = -1;
-        int script_discarder = -1;
+      int win_flags        = script_->win_flags;
+      int script_winner    = -1;
+      int script_discarder = -1;
 
-        for (int i = 0; i < 4; ++i) {
-          if ((win_flags & (1 << i)) != 0) {
-            script_winner = i;
-          }
-          if ((win_flags & (1 << (i + 4))) != 0) {
-            script_discarder = i;
-          }
+      for (int i = 0; i < 4; ++i) {
+        if ((win_flags & (1 << i)) != 0) {
+          script_winner = i;
         }
+        if ((win_flags & (1 << (i + 4))) != 0) {
+          script_discarder = i;
+        }
+      }
 
-        bool script_is_self_drawn =
-            (script_discarder < 0 || script_discarder == script_winner);
-
-        if (script_winner >= 0 && script_winner == winner_idx) {
-          if (is_self_drawn != script_is_self_drawn) {
-            LOG(ERROR) << "ASSERTION FAILED: is_self_drawn mismatch!";
-            LOG(ERROR) << "  Deduced from actions: "
-                       << (is_self_drawn ? "true" : "false");
-            LOG(ERROR) << "  From script data: "
-                       << (script_is_self_drawn ? "true" : "false");
-            LOG(ERROR) << "  Script discarder_idx: " << script_discarder;
-            is_self_drawn = script_is_self_drawn;
-          } else {
-            LOG(INFO) << "is_self_drawn validation passed: "
-                      << (is_self_drawn ? "SELF-DRAWN" : "OTHERS-WIN");
-          }
+      bool script_is_self_drawn =
+          (script_discarder < 0 || script_discarder == script_winner);
+
+      if (script_winner >= 0 && script_winner == winner_idx) {
+        if (is_self_drawn != script_is_self_drawn) {
+          LOG(ERROR) << "ASSERTION FAILED: is_self_drawn mismatch!";
+          LOG(ERROR) << "  Deduced from actions: "
+                     << (is_self_drawn ? "true" : "false");
+          LOG(ERROR) << "  From script data: "
+                     << (script_is_self_drawn ? "true" : "false");
+          LOG(ERROR) << "  Script discarder_idx: " << script_discarder;
+          is_self_drawn = script_is_self_drawn;
+        } else {
+          LOG(INFO) << "is_self_drawn validation passed: "
+                    << (is_self_drawn ? "SELF-DRAWN" : "OTHERS-WIN");
         }
       }
 
@@ -268,7 +250,6 @@ void RecordSimulator::ProcessAllActions() {
     }
 
     prev_time = action.time_ms;
-    action_idx++;
   }
 
   LOG(INFO) << "All actions processed, total steps recorded: "
@@ -276,14 +257,14 @@ void RecordSimulator::ProcessAllActions() {
 }
 
 void RecordSimulator::ExtractWinInfoFromScript() {
-  const auto& script_data = parser_.GetScriptData();
+  const auto& script = *script_;
 
-  if (!script_data.contains("y") || script_data["y"].empty()) {
+  if (script.wins.empty()) {
     LOG(WARNING) << "No win info in script data";
     return;
   }
 
-  auto win_flags = script_data.value("b", 0);
+  int win_flags = script.win_flags;
 
   if ((win_flags & 0x0F) == 0) {
     LOG(INFO) << "No valid winner in script data (荒庄)";
@@ -325,8 +306,8 @@ void RecordSimulator::ExtractWinInfoFromScript() {
             << base::WIND[winner_idx] << ")";
   LOG(INFO) << "  Is self-drawn: " << (is_self_drawn ? "true" : "false");
 
-  auto win_data = script_data["y"][winner_idx];
-  if (win_data.contains("h")) {
+  if (winner_idx < static_cast<int>(script.wins.size()) &&
+      !script.wins[winner_idx].hand.empty()) {
     int win_tile = -1;
 
     if (is_robbing_kong) {
@@ -544,12 +525,7 @@ const std::vector<StepLog>& RecordSimulator::GetStepLogs() const {
 }
 
 int RecordSimulator::GetRoundWindIndex() const {
-  const auto& script_data = parser_.GetScriptData();
-  if (!script_data.contains("i")) {
-    return 0;
-  }
-  int i = script_data["i"].get<int>();
-  return (i / 4) % 4;
+  return round_wind_idx_;
 }
 
 } // namespace analyzer
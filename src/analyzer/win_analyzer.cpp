@@ -11,7 +11,11 @@ namespace tziakcha {
 namespace analyzer {
 
 WinAnalyzer::WinAnalyzer()
-    : winner_idx_(-1), win_tile_(-1), is_self_drawn_(false), state_(nullptr) {}
+    : winner_idx_(-1),
+      win_tile_(-1),
+      is_self_drawn_(false),
+      state_(nullptr),
+      script_(nullptr) {}
 
 void WinAnalyzer::SetWinInfo(int winner_idx, int win_tile, bool is_self_drawn) {
   winner_idx_    = winner_idx;
@@ -21,24 +25,22 @@ void WinAnalyzer::SetWinInfo(int winner_idx, int win_tile, bool is_self_drawn) {
 
 void WinAnalyzer::SetGameState(const GameState& state) { state_ = &state; }
 
-void WinAnalyzer::SetScriptData(const json& script_data) {
-  script_data_ = script_data;
-}
+void WinAnalyzer::SetScript(const Script& script) { script_ = &script; }
 
 WinAnalysis WinAnalyzer::Analyze() {
   WinAnalysis result;
 
-  if (winner_idx_ < 0 || !state_) {
+  if (winner_idx_ < 0 || !state_ || !script_) {
     return result;
   }
 
   result.winner_idx   = winner_idx_;
-  result.winner_name  = script_data_["p"][winner_idx_]["n"].get<std::string>();
+  result.winner_name  = script_->players.at(winner_idx_).name;
   result.winner_wind  = GetWindChar(winner_idx_);
   result.flower_count = state_->GetFlowerCount(winner_idx_);
-
-  auto win_data    = script_data_["y"][winner_idx_];
-  result.total_fan = win_data.value("f", 0);
+  result.total_fan    = winner_idx_ < static_cast<int>(script_->wins.size())
+                            ? script_->wins[winner_idx_].total_fan
+                            : 0;
 
   result.formatted_hand      = BuildFormattedHand();
   result.hand_string_for_gb  = BuildHandStringForGB();
@@ -242,25 +244,17 @@ std::vector<FanDetail> WinAnalyzer::ExtractFanDetails() {
     return result;
   }
 
-  auto win_data = script_data_["y"][winner_idx_];
-  if (!win_data.is_object()) {
+  if (!script_ || winner_idx_ >= static_cast<int>(script_->wins.size())) {
     return result;
   }
 
-  auto fan_details = win_data.value("t", json::object());
-  if (!fan_details.is_object()) {
-    return result;
-  }
-
-  for (auto& [fan_id_str, fan_val] : fan_details.items()) {
-    int fan_id = std::stoi(fan_id_str);
+  for (const auto& [fan_id, fan_val] : script_->wins[winner_idx_].fans) {
     if (fan_id == 83) {
       continue;
     }
 
-    int fan_val_int = fan_val.get<int>();
-    int fan_points  = fan_val_int & 0xFF;
-    int count       = ((fan_val_int >> 8) & 0xFF) + 1;
+    int fan_points = fan_val & 0xFF;
+    int count      = ((fan_val >> 8) & 0xFF) + 1;
     std::string fan_name;
 
     if (fan_id >= 0 && fan_id < static_cast<int>(base::FAN_NAMES.size())) {
@@ -312,13 +306,11 @@ std::string WinAnalyzer::GetWindChar(int player_idx) const {
 }
 
 std::string WinAnalyzer::GetRoundWindChar() const {
-  auto gi_val = script_data_.value("i", json(0));
-  if (gi_val.is_number_integer()) {
-    int val                                     = gi_val.get<int>();
-    const std::array<std::string, 4> wind_chars = {"E", "S", "W", "N"};
-    return wind_chars[(val / 4) % 4];
+  if (!script_) {
+    return "E";
   }
-  return "E";
+  const std::array<std::string, 4> wind_chars = {"E", "S", "W", "N"};
+  return wind_chars[(script_->round / 4) % 4];
 }
 
 int WinAnalyzer::CalculateFanWithGB(const std::string& gb_string) {
@@ -70,6 +70,13 @@ bool FetcherConfig::use_ssl() const {
   return config_["http"].value("use_ssl", true);
 }
 
+int FetcherConfig::get_port() const {
+  int default_port = use_ssl() ? 443 : 80;
+  if (!loaded_ || !config_.contains("http"))
+    return default_port;
+  return config_["http"].value("port", default_port);
+}
+
 std::string FetcherConfig::get_history_endpoint() const {
   if (!loaded_ || !config_.contains("http"))
     return "";
@@ -94,6 +101,54 @@ int FetcherConfig::get_timeout_ms() const {
   return config_["http"].value("timeout_ms", 30000);
 }
 
+bool FetcherConfig::use_keep_alive() const {
+  if (!loaded_ || !config_.contains("http"))
+    return true;
+  return config_["http"].value("keep_alive", true);
+}
+
+int FetcherConfig::get_max_connections() const {
+  if (!loaded_ || !config_.contains("http"))
+    return 8;
+  return config_["http"].value("max_connections", 8);
+}
+
+int FetcherConfig::get_retry_attempts() const {
+  if (!loaded_ || !config_.contains("http"))
+    return 4;
+  return config_["http"].value("retry_attempts", 4);
+}
+
+int FetcherConfig::get_retry_base_delay_ms() const {
+  if (!loaded_ || !config_.contains("http"))
+    return 500;
+  return config_["http"].value("retry_base_delay_ms", 500);
+}
+
+int FetcherConfig::get_retry_max_delay_ms() const {
+  if (!loaded_ || !config_.contains("http"))
+    return 30000;
+  return config_["http"].value("retry_max_delay_ms", 30000);
+}
+
+int FetcherConfig::get_breaker_window() const {
+  if (!loaded_ || !config_.contains("http"))
+    return 50;
+  return config_["http"].value("breaker_window", 50);
+}
+
+double FetcherConfig::get_breaker_error_rate() const {
+  if (!loaded_ || !config_.contains("http"))
+    return 0.5;
+  return config_["http"].value("breaker_error_rate", 0.5);
+}
+
+int FetcherConfig::get_breaker_cooldown_ms() const {
+  if (!loaded_ || !config_.contains("http"))
+    return 5000;
+  return config_["http"].value("breaker_cooldown_ms", 5000);
+}
+
 const std::map<std::string, std::string>& FetcherConfig::get_headers() const {
   return headers_;
 }
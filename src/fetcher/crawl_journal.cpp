@@ -0,0 +1,291 @@
+#include "fetcher/crawl_journal.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <glog/logging.h>
+
+namespace fs = std::filesystem;
+
+namespace tziakcha {
+namespace fetcher {
+
+namespace {
+
+constexpr size_t kCompactSlack = 4096;
+
+char StateCode(CrawlJournal::State state) {
+  switch (state) {
+  case CrawlJournal::State::kAttempted:
+    return 'A';
+  case CrawlJournal::State::kSucceeded:
+    return 'S';
+  case CrawlJournal::State::kFailed:
+    return 'F';
+  default:
+    return '?';
+  }
+}
+
+bool ParseStateCode(char code, CrawlJournal::State& state) {
+  switch (code) {
+  case 'A':
+    state = CrawlJournal::State::kAttempted;
+    return true;
+  case 'S':
+    state = CrawlJournal::State::kSucceeded;
+    return true;
+  case 'F':
+    state = CrawlJournal::State::kFailed;
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Reasons come from error messages and must stay on the id's line.
+std::string SanitizeReason(const std::string& reason) {
+  std::string clean = reason;
+  std::replace_if(
+      clean.begin(),
+      clean.end(),
+      [](char c) { return c == '\n' || c == '\r' || c == '\t'; },
+      ' ');
+  return clean;
+}
+
+} // namespace
+
+CrawlJournal::CrawlJournal(std::string path) : path_(std::move(path)) {}
+
+CrawlJournal::~CrawlJournal() { close(); }
+
+bool CrawlJournal::open() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (file_) {
+    return true;
+  }
+
+  entries_.clear();
+  journal_lines_ = 0;
+
+  std::ifstream in(path_, std::ios::binary);
+  if (in.is_open()) {
+    std::string line;
+    uintmax_t complete_bytes = 0;
+    bool torn                = false;
+    while (std::getline(in, line)) {
+      // A last line without its newline was cut short by a crash.
+      if (in.eof()) {
+        torn = true;
+        break;
+      }
+      complete_bytes += line.size() + 1;
+
+      State state;
+      if (line.size() < 3 || line[1] != ' ' ||
+          !ParseStateCode(line[0], state)) {
+        continue;
+      }
+      size_t tab = line.find('\t', 2);
+      std::string id =
+          line.substr(2, tab == std::string::npos ? tab : tab - 2);
+
+      Entry& entry = entries_[id];
+      entry.state  = state;
+      entry.reason = (state == State::kFailed && tab != std::string::npos)
+                         ? line.substr(tab + 1)
+                         : std::string();
+      journal_lines_++;
+    }
+    in.close();
+
+    if (torn) {
+      LOG(WARNING) << "Dropping torn last line of crawl journal " << path_;
+      std::error_code ec;
+      fs::resize_file(path_, complete_bytes, ec);
+      if (ec) {
+        LOG(ERROR) << "Failed to truncate crawl journal " << path_ << ": "
+                   << ec.message();
+        return false;
+      }
+    }
+
+    if (journal_lines_ > 2 * entries_.size() + kCompactSlack) {
+      write_snapshot();
+    }
+  } else {
+    std::error_code ec;
+    fs::path parent = fs::path(path_).parent_path();
+    if (!parent.empty()) {
+      fs::create_directories(parent, ec);
+    }
+  }
+
+  file_ = std::fopen(path_.c_str(), "a");
+  if (!file_) {
+    LOG(ERROR) << "Failed to open crawl journal: " << path_;
+    return false;
+  }
+
+  LOG(INFO) << "Loaded crawl journal " << path_ << " with " << entries_.size()
+            << " ids";
+  return true;
+}
+
+void CrawlJournal::close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (file_) {
+    std::fclose(file_);
+    file_ = nullptr;
+  }
+}
+
+CrawlJournal::State CrawlJournal::state(const std::string& id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(id);
+  return it == entries_.end() ? State::kUnknown : it->second.state;
+}
+
+std::string CrawlJournal::failure_reason(const std::string& id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(id);
+  return it == entries_.end() ? std::string() : it->second.reason;
+}
+
+bool CrawlJournal::mark_attempted(const std::string& id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Entry& entry = entries_[id];
+  if (entry.state == State::kAttempted) {
+    return true;
+  }
+  entry.state = State::kAttempted;
+  entry.reason.clear();
+  return append_line(State::kAttempted, id, "");
+}
+
+bool CrawlJournal::mark_succeeded(const std::string& id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Entry& entry = entries_[id];
+  if (entry.state == State::kSucceeded) {
+    return true;
+  }
+  entry.state = State::kSucceeded;
+  entry.reason.clear();
+  return append_line(State::kSucceeded, id, "");
+}
+
+bool CrawlJournal::mark_failed(const std::string& id,
+                               const std::string& reason) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Entry& entry = entries_[id];
+  entry.state  = State::kFailed;
+  entry.reason = SanitizeReason(reason);
+  return append_line(State::kFailed, id, entry.reason);
+}
+
+std::vector<std::string> CrawlJournal::failed_ids() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  std::vector<std::string> ids;
+  for (const auto& [id, entry] : entries_) {
+    if (entry.state == State::kFailed) {
+      ids.push_back(id);
+    }
+  }
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+CrawlJournal::Counts CrawlJournal::counts() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  Counts counts;
+  for (const auto& [id, entry] : entries_) {
+    switch (entry.state) {
+    case State::kAttempted:
+      counts.attempted++;
+      break;
+    case State::kSucceeded:
+      counts.succeeded++;
+      break;
+    case State::kFailed:
+      counts.failed++;
+      break;
+    default:
+      break;
+    }
+  }
+  return counts;
+}
+
+bool CrawlJournal::append_line(State state,
+                               const std::string& id,
+                               const std::string& reason) {
+  if (!file_) {
+    LOG(ERROR) << "Crawl journal is not open: " << path_;
+    return false;
+  }
+  if (id.find_first_of("\t\r\n") != std::string::npos) {
+    LOG(ERROR) << "Id cannot be stored in crawl journal: " << id;
+    return false;
+  }
+
+  std::string line;
+  line.reserve(id.size() + reason.size() + 4);
+  line += StateCode(state);
+  line += ' ';
+  line += id;
+  if (state == State::kFailed) {
+    line += '\t';
+    line += reason;
+  }
+  line += '\n';
+
+  // One write per event: a crash loses at most the line being written.
+  bool ok = std::fwrite(line.data(), 1, line.size(), file_) == line.size() &&
+            std::fflush(file_) == 0;
+  if (!ok) {
+    LOG(ERROR) << "Failed to append to crawl journal: " << path_;
+    return false;
+  }
+  journal_lines_++;
+  return true;
+}
+
+bool CrawlJournal::write_snapshot() {
+  std::string tmp_path = path_ + ".tmp";
+
+  {
+    std::ofstream out(tmp_path, std::ios::trunc);
+    if (!out.is_open()) {
+      LOG(ERROR) << "Failed to write crawl journal: " << tmp_path;
+      return false;
+    }
+    for (const auto& [id, entry] : entries_) {
+      out << StateCode(entry.state) << ' ' << id;
+      if (entry.state == State::kFailed) {
+        out << '\t' << entry.reason;
+      }
+      out << '\n';
+    }
+    if (!out.good()) {
+      LOG(ERROR) << "Failed to write crawl journal: " << tmp_path;
+      return false;
+    }
+  }
+
+  std::error_code ec;
+  fs::rename(tmp_path, path_, ec);
+  if (ec) {
+    LOG(ERROR) << "Failed to replace crawl journal " << path_ << ": "
+               << ec.message();
+    return false;
+  }
+
+  journal_lines_ = entries_.size();
+  return true;
+}
+
+} // namespace fetcher
+} // namespace tziakcha
@@ -0,0 +1,178 @@
+#include "fetcher/fetch_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <numeric>
+#include <thread>
+
+namespace tziakcha {
+namespace fetcher {
+
+RateLimiter::RateLimiter(double rate_per_sec, double burst)
+    : rate_per_sec_(rate_per_sec),
+      burst_(std::max(burst, 1.0)),
+      tokens_(burst_),
+      last_refill_(Clock::now()) {}
+
+void RateLimiter::acquire() {
+  if (rate_per_sec_ <= 0) {
+    return;
+  }
+
+  std::chrono::duration<double> wait(0);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    refill(Clock::now());
+
+    // Taking the token before sleeping keeps callers in arrival order: a
+    // negative balance is the time the next caller has to wait for.
+    tokens_ -= 1.0;
+    if (tokens_ < 0) {
+      wait = std::chrono::duration<double>(-tokens_ / rate_per_sec_);
+    }
+  }
+
+  if (wait.count() > 0) {
+    std::this_thread::sleep_for(wait);
+  }
+}
+
+bool RateLimiter::try_acquire() {
+  if (rate_per_sec_ <= 0) {
+    return true;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  refill(Clock::now());
+  if (tokens_ < 1.0) {
+    return false;
+  }
+  tokens_ -= 1.0;
+  return true;
+}
+
+void RateLimiter::refill(Clock::time_point now) {
+  std::chrono::duration<double> since = now - last_refill_;
+  last_refill_                        = now;
+  tokens_ = std::min(burst_, tokens_ + since.count() * rate_per_sec_);
+}
+
+double FetchStats::mean_ms() const {
+  if (latencies_ms.empty()) {
+    return 0;
+  }
+  return std::accumulate(latencies_ms.begin(), latencies_ms.end(), 0.0) /
+         latencies_ms.size();
+}
+
+double FetchStats::percentile_ms(double p) const {
+  if (latencies_ms.empty()) {
+    return 0;
+  }
+  std::vector<double> sorted = latencies_ms;
+  std::sort(sorted.begin(), sorted.end());
+  double rank  = std::ceil(p / 100.0 * sorted.size());
+  size_t index = rank < 1 ? 0 : static_cast<size_t>(rank) - 1;
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+double FetchStats::requests_per_second() const {
+  return elapsed_seconds > 0 ? requests() / elapsed_seconds : 0;
+}
+
+void FetchStats::merge(const FetchStats& other) {
+  succeeded += other.succeeded;
+  failed += other.failed;
+  elapsed_seconds += other.elapsed_seconds;
+  latencies_ms.insert(latencies_ms.end(),
+                      other.latencies_ms.begin(),
+                      other.latencies_ms.end());
+}
+
+void LatencyHistogram::add(double ms) {
+  size_t bucket =
+      std::lower_bound(kBucketBoundsMs.begin(), kBucketBoundsMs.end(), ms) -
+      kBucketBoundsMs.begin();
+  buckets_[bucket]++;
+  count_++;
+  sum_ms_ += ms;
+  max_ms_ = std::max(max_ms_, ms);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+  for (size_t i = 0; i < buckets_.size(); ++i) {
+    buckets_[i] += other.buckets_[i];
+  }
+  count_ += other.count_;
+  sum_ms_ += other.sum_ms_;
+  max_ms_ = std::max(max_ms_, other.max_ms_);
+}
+
+double LatencyHistogram::percentile_ms(double p) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  double rank   = std::max(1.0, std::ceil(p / 100.0 * count_));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBucketBoundsMs.size(); ++i) {
+    seen += buckets_[i];
+    if (seen >= rank) {
+      return std::min(kBucketBoundsMs[i], max_ms_);
+    }
+  }
+  return max_ms_;
+}
+
+FetchPool::FetchPool(size_t concurrency, double rate_per_sec, double burst)
+    : concurrency_(concurrency > 0 ? concurrency : 1),
+      limiter_(rate_per_sec, burst) {}
+
+FetchStats FetchPool::run(const std::vector<std::string>& ids,
+                          const Task& task) {
+  return run(ids.size(), [&](size_t index) { return task(index, ids[index]); });
+}
+
+FetchStats FetchPool::run(size_t count, const IndexTask& task) {
+  using Clock = std::chrono::steady_clock;
+
+  FetchStats stats;
+  std::mutex stats_mutex;
+  std::atomic<size_t> next{0};
+
+  auto worker = [&] {
+    for (size_t i = next++; i < count; i = next++) {
+      limiter_.acquire();
+
+      auto start = Clock::now();
+      bool ok    = task(i);
+      std::chrono::duration<double, std::milli> latency = Clock::now() - start;
+
+      std::lock_guard<std::mutex> lock(stats_mutex);
+      stats.latencies_ms.push_back(latency.count());
+      if (ok) {
+        stats.succeeded++;
+      } else {
+        stats.failed++;
+      }
+    }
+  };
+
+  auto start = Clock::now();
+
+  size_t workers = std::min(concurrency_, count);
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < workers; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+  stats.elapsed_seconds                 = elapsed.count();
+  return stats;
+}
+
+} // namespace fetcher
+} // namespace tziakcha
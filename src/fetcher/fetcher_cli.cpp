@@ -1,14 +1,25 @@
+#include "fetcher/crawl_journal.h"
+#include "fetcher/fetch_pool.h"
 #include "fetcher/history_fetcher.h"
+#include "fetcher/http_client_pool.h"
 #include "fetcher/session_fetcher.h"
 #include "fetcher/record_fetcher.h"
 #include "config/fetcher_config.h"
+#include "storage/caching_storage.h"
 #include "storage/filesystem_storage.h"
+#include "storage/storage_factory.h"
+#include "storage/write_behind_storage.h"
 #include <cxxopts.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
+#include <iomanip>
 #include <iostream>
+#include <mutex>
+#include <string_view>
+#include <unordered_set>
 #include <filesystem>
-#include <chrono>
-#include <thread>
 #include <glog/logging.h>
 
 namespace fs = std::filesystem;
@@ -28,6 +39,30 @@ void print_usage() {
                "command.\n";
 }
 
+void print_request_stats() {
+  auto& pool = tziakcha::fetcher::HttpClientPool::instance();
+  auto stats = pool.stats();
+  if (stats.requests == 0) {
+    return;
+  }
+
+  std::cout << "\n=== Request Stats ===\n";
+  std::cout << "Connections: " << stats.connections_opened << " opened for "
+            << stats.requests << " requests (" << stats.connections_reused()
+            << " reused)\n";
+  std::cout << "Retries: " << stats.retries
+            << ", circuit breaker trips: " << stats.breaker_trips << "\n";
+  std::cout << std::fixed << std::setprecision(1);
+  for (const auto& [endpoint, histogram] : pool.latencies()) {
+    std::cout << "Latency " << endpoint << " (ms, " << histogram.count()
+              << " requests): mean " << histogram.mean_ms() << ", p50 <= "
+              << histogram.percentile_ms(50) << ", p90 <= "
+              << histogram.percentile_ms(90) << ", p99 <= "
+              << histogram.percentile_ms(99) << ", max "
+              << histogram.max_ms() << "\n";
+  }
+}
+
 int cmd_history(int argc, char* argv[]) {
   cxxopts::Options options(
       "fetcher_cli history", "Fetch game history from server");
@@ -49,6 +84,12 @@ int cmd_history(int argc, char* argv[]) {
       "End date (YYYYMMDD)",
       cxxopts::value<std::string>()->default_value(""))(
       "f,filter", "Filter by title keyword", cxxopts::value<std::string>())(
+      "incremental",
+      "Only fetch games newer than the stored history and merge them in",
+      cxxopts::value<bool>()->default_value("false"))(
+      "concurrency",
+      "Number of pages fetched in parallel for a date range",
+      cxxopts::value<int>()->default_value("4"))(
       "p,print",
       "Print JSON to console after fetching",
       cxxopts::value<bool>()->default_value("false"))("h,help", "Print help");
@@ -87,6 +128,14 @@ int cmd_history(int argc, char* argv[]) {
   std::string storage_key = result["key"].as<std::string>();
   std::string start_date  = result["start-date"].as<std::string>();
   std::string end_date    = result["end-date"].as<std::string>();
+  bool incremental        = result["incremental"].as<bool>();
+  int concurrency         = result["concurrency"].as<int>();
+
+  if (incremental && (!start_date.empty() || !end_date.empty())) {
+    std::cerr << "Error: --incremental cannot be combined with a date range"
+              << std::endl;
+    return 1;
+  }
 
   if (!start_date.empty() || !end_date.empty()) {
     if (start_date.empty() || end_date.empty()) {
@@ -109,7 +158,14 @@ int cmd_history(int argc, char* argv[]) {
 
   tziakcha::fetcher::HistoryFetcher fetcher(storage);
 
-  if (!fetcher.fetch(cookie, storage_key, start_date, end_date)) {
+  bool fetched = incremental
+                     ? fetcher.fetch_incremental(cookie, storage_key)
+                     : fetcher.fetch(cookie,
+                                     storage_key,
+                                     start_date,
+                                     end_date,
+                                     std::max(concurrency, 1));
+  if (!fetched) {
     LOG(ERROR) << "Failed to fetch history records";
     return 1;
   }
@@ -155,6 +211,9 @@ int cmd_sessions(int argc, char* argv[]) {
       "Output record parent map key",
       cxxopts::value<std::string>()->default_value(
           "sessions/record_parent_map"))(
+      "concurrency",
+      "Number of sessions fetched in parallel",
+      cxxopts::value<int>()->default_value("4"))(
       "p,print",
       "Print grouped sessions JSON to console",
       cxxopts::value<bool>()->default_value("false"))("h,help", "Print help");
@@ -183,13 +242,14 @@ int cmd_sessions(int argc, char* argv[]) {
   std::string input_key  = result["input"].as<std::string>();
   std::string output_key = result["output"].as<std::string>();
   std::string map_key    = result["map"].as<std::string>();
+  int concurrency        = result["concurrency"].as<int>();
 
-  auto storage =
-      std::make_shared<tziakcha::storage::FileSystemStorage>(data_dir);
+  auto storage = std::make_shared<tziakcha::storage::CachingStorage>(
+      std::make_shared<tziakcha::storage::FileSystemStorage>(data_dir));
 
   tziakcha::fetcher::SessionFetcher fetcher(storage);
 
-  if (!fetcher.fetch_sessions(input_key)) {
+  if (!fetcher.fetch_sessions(input_key, std::max(concurrency, 1))) {
     LOG(ERROR) << "Failed to fetch session records";
     return 1;
   }
@@ -297,6 +357,9 @@ int cmd_record(int argc, char* argv[]) {
       cxxopts::value<std::string>()->default_value("data"))(
       "r,record-id", "Record ID to fetch", cxxopts::value<std::string>())(
       "o,output", "Output key for record data", cxxopts::value<std::string>())(
+      "script-mode",
+      "Store the script decoded or compressed (decoded, compressed)",
+      cxxopts::value<std::string>()->default_value("decoded"))(
       "p,print",
       "Print JSON to console after fetching",
       cxxopts::value<bool>()->default_value("false"))("h,help", "Print help");
@@ -334,10 +397,17 @@ int cmd_record(int argc, char* argv[]) {
       result.count("output") ? result["output"].as<std::string>()
                              : "record/" + record_id;
 
+  tziakcha::utils::ScriptMode script_mode;
+  if (!tziakcha::utils::ParseScriptMode(
+          result["script-mode"].as<std::string>(), script_mode)) {
+    std::cerr << "Error: Unknown script mode" << std::endl;
+    return 1;
+  }
+
   auto storage =
       std::make_shared<tziakcha::storage::FileSystemStorage>(data_dir);
 
-  tziakcha::fetcher::RecordFetcher fetcher(storage);
+  tziakcha::fetcher::RecordFetcher fetcher(storage, script_mode);
 
   if (!fetcher.fetch_record(record_id, output_key)) {
     LOG(ERROR) << "Failed to fetch record: " << record_id;
@@ -376,11 +446,37 @@ int cmd_records(int argc, char* argv[]) {
       "Limit number of records to fetch (0 = no limit)",
       cxxopts::value<int>()->default_value("0"))(
       "delay",
-      "Delay between requests in milliseconds",
+      "Delay between requests in milliseconds (used when --rate is 0)",
       cxxopts::value<int>()->default_value("500"))(
+      "concurrency",
+      "Number of records fetched in parallel",
+      cxxopts::value<int>()->default_value("1"))(
+      "rate",
+      "Maximum requests per second across all workers (0 = use --delay)",
+      cxxopts::value<double>()->default_value("0"))(
       "skip-existing",
-      "Skip records that already exist in storage",
-      cxxopts::value<bool>()->default_value("true"))("h,help", "Print help");
+      "Skip records that already exist in storage or the journal lists as "
+      "done or failed (false refetches everything)",
+      cxxopts::value<bool>()->default_value("true"))(
+      "storage",
+      "Record storage backend (auto, fs, packed)",
+      cxxopts::value<std::string>()->default_value("auto"))(
+      "encoding",
+      "Record document encoding (json, cbor, msgpack)",
+      cxxopts::value<std::string>()->default_value("json"))(
+      "script-mode",
+      "Store scripts decoded or compressed (decoded, compressed)",
+      cxxopts::value<std::string>()->default_value("decoded"))(
+      "async-writes",
+      "Write records from a background thread in synced batches",
+      cxxopts::value<bool>()->default_value("true"))(
+      "journal",
+      "Crawl journal path (default: <data-dir>/<output-dir>.journal)",
+      cxxopts::value<std::string>()->default_value(""))(
+      "retry-failed",
+      "Only fetch records the journal lists as failed",
+      cxxopts::value<bool>()->default_value("false"))(
+      "h,help", "Print help");
 
   auto result = options.parse(argc, argv);
 
@@ -407,10 +503,49 @@ int cmd_records(int argc, char* argv[]) {
   std::string output_dir = result["output-dir"].as<std::string>();
   int limit              = result["limit"].as<int>();
   int delay_ms           = result["delay"].as<int>();
+  int concurrency        = result["concurrency"].as<int>();
+  double rate            = result["rate"].as<double>();
   bool skip_existing     = result["skip-existing"].as<bool>();
+  bool async_writes      = result["async-writes"].as<bool>();
+  bool retry_failed      = result["retry-failed"].as<bool>();
+
+  std::string journal_path = result["journal"].as<std::string>();
+  if (journal_path.empty()) {
+    journal_path = (fs::path(data_dir) / (output_dir + ".journal")).string();
+  }
+
+  tziakcha::storage::StorageBackend backend;
+  if (!tziakcha::storage::ParseStorageBackend(
+          result["storage"].as<std::string>(), backend)) {
+    std::cerr << "Error: Unknown storage backend" << std::endl;
+    return 1;
+  }
+
+  tziakcha::storage::Encoding encoding;
+  if (!tziakcha::storage::ParseEncoding(result["encoding"].as<std::string>(),
+                                        encoding)) {
+    std::cerr << "Error: Unknown document encoding" << std::endl;
+    return 1;
+  }
+
+  tziakcha::utils::ScriptMode script_mode;
+  if (!tziakcha::utils::ParseScriptMode(
+          result["script-mode"].as<std::string>(), script_mode)) {
+    std::cerr << "Error: Unknown script mode" << std::endl;
+    return 1;
+  }
 
   auto storage =
       std::make_shared<tziakcha::storage::FileSystemStorage>(data_dir);
+  auto record_storage = tziakcha::storage::OpenStorage(
+      (fs::path(data_dir) / output_dir).string(), backend, encoding);
+
+  std::shared_ptr<tziakcha::storage::WriteBehindStorage> writer;
+  if (async_writes) {
+    writer =
+        std::make_shared<tziakcha::storage::WriteBehindStorage>(record_storage);
+    record_storage = writer;
+  }
 
   json session_json;
   if (!storage->load_json(input_key, session_json)) {
@@ -418,39 +553,8 @@ int cmd_records(int argc, char* argv[]) {
     return 1;
   }
 
-  std::vector<std::string> record_ids;
-  if (session_json.is_array()) {
-    for (const auto& session : session_json) {
-      if (session.contains("records") && session["records"].is_array()) {
-        for (const auto& record_id : session["records"]) {
-          if (record_id.is_string()) {
-            record_ids.push_back(record_id.get<std::string>());
-          }
-        }
-      } else if (session.contains("l") && session["l"].is_array()) {
-        for (const auto& record_id : session["l"]) {
-          if (record_id.is_string()) {
-            record_ids.push_back(record_id.get<std::string>());
-          }
-        }
-      }
-    }
-  } else if (session_json.is_object()) {
-    if (session_json.contains("records") &&
-        session_json["records"].is_array()) {
-      for (const auto& record_id : session_json["records"]) {
-        if (record_id.is_string()) {
-          record_ids.push_back(record_id.get<std::string>());
-        }
-      }
-    } else if (session_json.contains("l") && session_json["l"].is_array()) {
-      for (const auto& record_id : session_json["l"]) {
-        if (record_id.is_string()) {
-          record_ids.push_back(record_id.get<std::string>());
-        }
-      }
-    }
-  }
+  std::vector<std::string> record_ids =
+      tziakcha::fetcher::CollectRecordIds(session_json);
 
   if (record_ids.empty()) {
     LOG(WARNING) << "No record IDs found in session JSON";
@@ -464,45 +568,159 @@ int cmd_records(int argc, char* argv[]) {
     LOG(INFO) << "Limited to " << limit << " records";
   }
 
-  tziakcha::fetcher::RecordFetcher fetcher(storage);
-  int success_count = 0;
-  int skip_count    = 0;
-  int fail_count    = 0;
+  tziakcha::fetcher::CrawlJournal journal(journal_path);
+  if (!journal.open()) {
+    return 1;
+  }
 
-  for (size_t i = 0; i < record_ids.size(); ++i) {
-    const auto& record_id  = record_ids[i];
-    std::string output_key = output_dir + "/" + record_id;
+  // The journal answers "done before?" with a hash lookup; storage is only
+  // consulted for ids it has never seen, e.g. records fetched before the
+  // journal existed, which are then recorded so the next run skips them.
+  // That check is one pass over the storage's keys (its manifest or index
+  // when it has one) rather than an exists() call, i.e. a stat, per id.
+  using JournalState = tziakcha::fetcher::CrawlJournal::State;
+  std::unordered_set<std::string_view> existing;
+  if (skip_existing && !retry_failed) {
+    std::unordered_set<std::string_view> unknown;
+    for (const auto& record_id : record_ids) {
+      if (journal.state(record_id) == JournalState::kUnknown) {
+        unknown.insert(record_id);
+      }
+    }
 
-    if (skip_existing && storage->exists(output_key)) {
-      LOG(INFO) << "[" << (i + 1) << "/" << record_ids.size()
-                << "] Skipping existing record: " << record_id;
+    auto scan_start = std::chrono::steady_clock::now();
+    size_t scanned  = 0;
+    if (!unknown.empty()) {
+      record_storage->for_each_key("", [&](const std::string& key) {
+        scanned++;
+        auto it = unknown.find(key);
+        if (it != unknown.end()) {
+          existing.insert(*it);
+        }
+        return existing.size() < unknown.size();
+      });
+    }
+    std::chrono::duration<double, std::milli> scan_ms =
+        std::chrono::steady_clock::now() - scan_start;
+    LOG(INFO) << "Checked " << unknown.size()
+              << " records unknown to the journal against " << scanned
+              << " stored keys in " << static_cast<int>(scan_ms.count())
+              << " ms: " << existing.size() << " already stored";
+  }
+
+  std::vector<std::string> pending_ids;
+  int skip_count   = 0;
+  int stored_count = 0;
+  int known_failed = 0;
+  for (const auto& record_id : record_ids) {
+    JournalState state = journal.state(record_id);
+    if (retry_failed) {
+      if (state == JournalState::kFailed) {
+        pending_ids.push_back(record_id);
+      }
+    } else if (!skip_existing) {
+      pending_ids.push_back(record_id);
+    } else if (state == JournalState::kSucceeded) {
+      skip_count++;
+    } else if (state == JournalState::kFailed) {
+      known_failed++;
+    } else if (state == JournalState::kUnknown &&
+               existing.count(record_id) > 0) {
+      journal.mark_succeeded(record_id);
       skip_count++;
-      continue;
+      stored_count++;
+    } else {
+      pending_ids.push_back(record_id);
     }
-
-    LOG(INFO) << "[" << (i + 1) << "/" << record_ids.size()
-              << "] Fetching record: " << record_id;
-
-    if (fetcher.fetch_record(record_id, output_key)) {
-      success_count++;
-      LOG(INFO) << "  Successfully fetched: " << record_id;
+  }
+  if (known_failed > 0) {
+    LOG(INFO) << "Skipping " << known_failed
+              << " records that failed before; use --retry-failed to retry";
+  }
+
+  if (rate <= 0 && delay_ms > 0) {
+    rate = 1000.0 / delay_ms;
+  }
+  LOG(INFO) << "Fetching " << pending_ids.size() << " records with "
+            << concurrency << " workers, rate limit " << rate << " req/s";
+
+  tziakcha::fetcher::RecordFetcher fetcher(record_storage, script_mode);
+  tziakcha::fetcher::FetchPool pool(std::max(concurrency, 1), rate);
+  std::atomic<size_t> started{0};
+
+  // Records are fetched in chunks so a success is journaled only after the
+  // storage flush that made it durable; a crash never marks a record done
+  // that did not reach disk.
+  constexpr size_t kJournalChunk = 1000;
+  tziakcha::fetcher::FetchStats stats;
+  bool flushed = true;
+  for (size_t begin = 0; begin < pending_ids.size(); begin += kJournalChunk) {
+    size_t end = std::min(begin + kJournalChunk, pending_ids.size());
+    std::vector<std::string> chunk(pending_ids.begin() + begin,
+                                   pending_ids.begin() + end);
+    std::vector<std::string> fetched;
+    std::mutex fetched_mutex;
+
+    auto chunk_stats =
+        pool.run(chunk, [&](size_t, const std::string& record_id) {
+          LOG(INFO) << "[" << (++started) << "/" << pending_ids.size()
+                    << "] Fetching record: " << record_id;
+          journal.mark_attempted(record_id);
+
+          std::string error;
+          if (!fetcher.fetch_record(record_id, record_id, &error)) {
+            LOG(ERROR) << "  Failed to fetch: " << record_id;
+            journal.mark_failed(record_id, error);
+            return false;
+          }
+          LOG(INFO) << "  Successfully fetched: " << record_id;
+          std::lock_guard<std::mutex> lock(fetched_mutex);
+          fetched.push_back(record_id);
+          return true;
+        });
+    stats.merge(chunk_stats);
+
+    if (record_storage->flush()) {
+      for (const auto& record_id : fetched) {
+        journal.mark_succeeded(record_id);
+      }
     } else {
-      fail_count++;
-      LOG(ERROR) << "  Failed to fetch: " << record_id;
+      // The failed writes are not known individually; leaving the chunk as
+      // attempted makes the next run fetch it again.
+      flushed = false;
     }
+  }
 
-    if (i < record_ids.size() - 1 && delay_ms > 0) {
-      std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
-    }
+  if (!flushed) {
+    LOG(ERROR) << "Some records could not be written to storage";
   }
 
   std::cout << "\n=== Batch Fetch Summary ===\n";
   std::cout << "Total records: " << record_ids.size() << "\n";
-  std::cout << "Successfully fetched: " << success_count << "\n";
+  std::cout << "Successfully fetched: " << stats.succeeded << "\n";
   std::cout << "Skipped (existing): " << skip_count << "\n";
-  std::cout << "Failed: " << fail_count << "\n";
+  if (stored_count > 0) {
+    std::cout << "  found in storage, not journal: " << stored_count << "\n";
+  }
+  std::cout << "Failed: " << stats.failed << "\n";
+  if (known_failed > 0) {
+    std::cout << "Skipped (failed before): " << known_failed << "\n";
+  }
+  std::cout << "Journal: " << journal.path() << " ("
+            << journal.counts().failed << " failed)\n";
+  if (writer) {
+    std::cout << "Write failures: " << writer->failed_count() << "\n";
+  }
+  if (stats.requests() > 0) {
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Throughput: " << stats.requests_per_second() << " req/s\n";
+    std::cout << "Latency (ms): mean " << stats.mean_ms() << ", p50 "
+              << stats.percentile_ms(50) << ", p90 " << stats.percentile_ms(90)
+              << ", p99 " << stats.percentile_ms(99) << ", max "
+              << stats.percentile_ms(100) << "\n";
+  }
 
-  return (fail_count > 0) ? 1 : 0;
+  return (stats.failed > 0 || !flushed) ? 1 : 0;
 }
 
 int main(int argc, char* argv[]) {
@@ -520,19 +738,25 @@ int main(int argc, char* argv[]) {
   if (command == "help" || command == "--help" || command == "-h") {
     print_usage();
     return 0;
-  } else if (command == "history") {
-    return cmd_history(argc - 1, argv + 1);
+  }
+
+  int status;
+  if (command == "history") {
+    status = cmd_history(argc - 1, argv + 1);
   } else if (command == "sessions") {
-    return cmd_sessions(argc - 1, argv + 1);
+    status = cmd_sessions(argc - 1, argv + 1);
   } else if (command == "session") {
-    return cmd_session(argc - 1, argv + 1);
+    status = cmd_session(argc - 1, argv + 1);
   } else if (command == "record") {
-    return cmd_record(argc - 1, argv + 1);
+    status = cmd_record(argc - 1, argv + 1);
   } else if (command == "records") {
-    return cmd_records(argc - 1, argv + 1);
+    status = cmd_records(argc - 1, argv + 1);
   } else {
     std::cerr << "Unknown command: " << command << std::endl;
     std::cerr << "Run 'fetcher_cli help' for usage." << std::endl;
     return 1;
   }
+
+  print_request_stats();
+  return status;
 }
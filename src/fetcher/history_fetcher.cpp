@@ -1,9 +1,11 @@
 #include "fetcher/history_fetcher.h"
 #include "config/fetcher_config.h"
+#include "fetcher/fetch_pool.h"
+#include "fetcher/http_client_pool.h"
 #include "storage/filesystem_storage.h"
+#include <algorithm>
 #include <chrono>
 #include <ctime>
-#include <httplib.h>
 #include <fstream>
 #include <glog/logging.h>
 #include <iostream>
@@ -69,6 +71,38 @@ build_date_range(const std::string& start_date, const std::string& end_date) {
 
   return HistoryFetcher::DateRangeMs{*start_ms, *end_ms};
 }
+
+int64_t GameStartMs(const json& game) {
+  if (game.contains("start_time") && game["start_time"].is_number()) {
+    return game["start_time"].get<int64_t>();
+  }
+  return 0;
+}
+
+// Newest and oldest start time on a page; false if no game has one.
+bool PageBounds(const json& games, int64_t& newest, int64_t& oldest) {
+  newest = std::numeric_limits<int64_t>::min();
+  oldest = std::numeric_limits<int64_t>::max();
+  for (const auto& game : games) {
+    int64_t start_ms = GameStartMs(game);
+    if (start_ms > 0) {
+      newest = std::max(newest, start_ms);
+      oldest = std::min(oldest, start_ms);
+    }
+  }
+  return newest >= oldest;
+}
+
+bool IsKnownGame(const json& game,
+                 int64_t start_ms,
+                 const HistoryFetcher::Watermark& watermark,
+                 const std::unordered_set<std::string>& known_ids) {
+  if (start_ms > 0 && start_ms < watermark.start_ms) {
+    return true;
+  }
+  std::string id = game.value("id", "");
+  return !id.empty() && known_ids.count(id) > 0;
+}
 } // namespace
 
 HistoryFetcher::HistoryFetcher(std::shared_ptr<storage::Storage> storage)
@@ -78,142 +112,171 @@ HistoryFetcher::HistoryFetcher(std::shared_ptr<storage::Storage> storage)
   }
 }
 
-bool HistoryFetcher::fetch_page(
-    const std::string& url,
-    const std::string& headers,
-    int page,
-    const std::optional<DateRangeMs>& date_range,
-    bool& reached_range_end) {
+bool HistoryFetcher::request_page(const std::string& cookie,
+                                  int page,
+                                  json& games) const {
   auto& config = config::FetcherConfig::instance();
 
   std::string body = (page > 0) ? ("p=" + std::to_string(page)) : "";
 
   LOG(INFO) << "Fetching page " << (page + 1) << ", body: '" << body << "'";
 
-  httplib::Headers header_map;
-  for (const auto& [key, value] : config.get_headers()) {
-    header_map.emplace(key, value);
-  }
-  header_map.emplace("Cookie", headers);
-
-  httplib::Result result;
-
-#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-  if (config.use_ssl()) {
-    httplib::SSLClient cli(config.get_base_url(), 443);
-    cli.enable_server_certificate_verification(false);
-    cli.set_follow_location(true);
-    cli.set_connection_timeout(config.get_timeout_ms() / 1000);
-    cli.set_read_timeout(config.get_timeout_ms() / 1000);
-    cli.set_write_timeout(config.get_timeout_ms() / 1000);
-
-    LOG(INFO) << "Using HTTPS to " << config.get_base_url() << ":443"
-              << config.get_history_endpoint();
-
-    result = cli.Post(
-        config.get_history_endpoint(),
-        header_map,
-        body,
-        "text/plain;charset=UTF-8");
-  } else {
-#endif
-    httplib::Client cli(config.get_base_url(), 80);
-    cli.set_follow_location(true);
-    cli.set_connection_timeout(config.get_timeout_ms() / 1000);
-    cli.set_read_timeout(config.get_timeout_ms() / 1000);
-    cli.set_write_timeout(config.get_timeout_ms() / 1000);
-
-    LOG(INFO) << "Using HTTP to " << config.get_base_url() << ":80"
-              << config.get_history_endpoint();
-
-    result = cli.Post(
-        config.get_history_endpoint(),
-        header_map,
-        body,
-        "text/plain;charset=UTF-8");
-#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-  }
-#endif
+  auto result = HttpClientPool::instance().post(
+      config.get_history_endpoint(),
+      body,
+      "text/plain;charset=UTF-8",
+      {{"Cookie", cookie}});
 
   if (!result) {
-    auto err = result.error();
     LOG(ERROR) << "Request failed: no result returned";
-    LOG(ERROR) << "Error code: " << static_cast<int>(err);
-    LOG(ERROR) << "Error message: " << httplib::to_string(err);
+    LOG(ERROR) << "Error message: " << result.error;
     return false;
   }
 
-  if (result->status != 200) {
-    LOG(ERROR) << "Request failed with status: " << result->status;
-    LOG(ERROR) << "Response body: " << result->body;
+  if (result.status != 200) {
+    LOG(ERROR) << "Request failed with status: " << result.status;
+    LOG(ERROR) << "Response body: " << result.body;
     return false;
   }
 
   LOG(INFO) << "Request succeeded with status 200, response size: "
-            << result->body.size();
+            << result.body.size();
 
   try {
-    auto data = json::parse(result->body);
+    auto data = json::parse(result.body);
     if (data.is_object() && data.contains("games") &&
         data["games"].is_array()) {
-      size_t game_count = data["games"].size();
-      LOG(INFO) << "Found " << game_count << " games on page " << (page + 1);
-
-      size_t added_count = 0;
-      int64_t min_start  = std::numeric_limits<int64_t>::max();
-
-      for (const auto& game : data["games"]) {
-        int64_t start_ms = 0;
-        bool has_start   = false;
-        if (game.contains("start_time") &&
-            (game["start_time"].is_number_integer() ||
-             game["start_time"].is_number())) {
-          start_ms  = game["start_time"].get<int64_t>();
-          has_start = true;
-          if (start_ms < min_start) {
-            min_start = start_ms;
-          }
-        }
-
-        if (date_range) {
-          if (!has_start) {
-            continue;
-          }
-
-          if (start_ms < date_range->start_ms) {
-            reached_range_end = true;
-          }
-
-          if (start_ms < date_range->start_ms ||
-              start_ms > date_range->end_ms) {
-            continue;
-          }
-        }
-
-        records_.push_back(game);
-        added_count++;
-      }
-
-      if (!date_range) {
-        reached_range_end = false;
-      } else if (min_start != std::numeric_limits<int64_t>::max() &&
-                 min_start < date_range->start_ms) {
-        reached_range_end = true;
-      }
-
-      LOG(INFO) << "Added " << added_count << " records from page "
-                << (page + 1);
+      games = std::move(data["games"]);
+      LOG(INFO) << "Found " << games.size() << " games on page " << (page + 1);
       return true;
     }
 
     LOG(WARNING) << "Response JSON does not contain 'games' array";
-    LOG(WARNING) << "Response: " << result->body.substr(0, 500);
+    LOG(WARNING) << "Response: " << result.body.substr(0, 500);
     return false;
   } catch (const std::exception& e) {
     LOG(ERROR) << "Failed to parse JSON response: " << e.what();
-    LOG(ERROR) << "Response body: " << result->body.substr(0, 500);
+    LOG(ERROR) << "Response body: " << result.body.substr(0, 500);
+    return false;
+  }
+}
+
+bool HistoryFetcher::fetch_page(
+    const std::string& headers,
+    int page,
+    const std::optional<DateRangeMs>& date_range,
+    bool& reached_range_end) {
+  json games;
+  if (!request_page(headers, page, games)) {
     return false;
   }
+  add_games(games, page, date_range, reached_range_end);
+  return true;
+}
+
+void HistoryFetcher::add_games(const json& games,
+                               int page,
+                               const std::optional<DateRangeMs>& date_range,
+                               bool& reached_range_end) {
+  size_t added_count = 0;
+  int64_t min_start  = std::numeric_limits<int64_t>::max();
+  bool reached_known = false;
+
+  for (const auto& game : games) {
+    int64_t start_ms = 0;
+    bool has_start   = false;
+    if (game.contains("start_time") &&
+        (game["start_time"].is_number_integer() ||
+         game["start_time"].is_number())) {
+      start_ms  = game["start_time"].get<int64_t>();
+      has_start = true;
+      if (start_ms < min_start) {
+        min_start = start_ms;
+      }
+    }
+
+    if (watermark_ && IsKnownGame(game, start_ms, *watermark_, known_ids_)) {
+      reached_known = true;
+      continue;
+    }
+
+    if (date_range) {
+      if (!has_start) {
+        continue;
+      }
+
+      if (start_ms < date_range->start_ms) {
+        reached_range_end = true;
+      }
+
+      if (start_ms < date_range->start_ms || start_ms > date_range->end_ms) {
+        continue;
+      }
+    }
+
+    records_.push_back(game);
+    added_count++;
+  }
+
+  if (!date_range) {
+    reached_range_end = reached_known;
+  } else if (min_start != std::numeric_limits<int64_t>::max() &&
+             min_start < date_range->start_ms) {
+    reached_range_end = true;
+  }
+
+  LOG(INFO) << "Added " << added_count << " records from page " << (page + 1);
+}
+
+bool HistoryFetcher::find_range_pages(const std::string& cookie,
+                                      const DateRangeMs& range,
+                                      int max_pages,
+                                      std::map<int, json>& probed,
+                                      int& first,
+                                      int& end) const {
+  auto probe = [&](int page, int64_t& newest, int64_t& oldest, bool& ok) {
+    auto it = probed.find(page);
+    if (it == probed.end()) {
+      json games;
+      if (!request_page(cookie, page, games)) {
+        ok = false;
+        return false;
+      }
+      it = probed.emplace(page, std::move(games)).first;
+    }
+    return PageBounds(it->second, newest, oldest);
+  };
+
+  // Smallest page in [0, max_pages] for which past(page) holds. Pages are
+  // ordered newest first, so past() flips from false to true exactly once;
+  // empty pages lie beyond the end of the history and count as past.
+  auto bisect = [&](auto past, bool& ok) {
+    int lo = 0;
+    int hi = max_pages;
+    while (lo < hi && ok) {
+      int mid = lo + (hi - lo) / 2;
+      int64_t newest;
+      int64_t oldest;
+      if (!probe(mid, newest, oldest, ok) || past(newest, oldest)) {
+        hi = mid;
+      } else {
+        lo = mid + 1;
+      }
+    }
+    return lo;
+  };
+
+  auto reaches_end = [&](int64_t, int64_t oldest) {
+    return oldest <= range.end_ms;
+  };
+  auto before_start = [&](int64_t newest, int64_t) {
+    return newest < range.start_ms;
+  };
+
+  bool ok = true;
+  first   = bisect(reaches_end, ok);
+  end     = bisect(before_start, ok);
+  return ok;
 }
 
 bool HistoryFetcher::save_records(const std::string& key) const {
@@ -227,10 +290,47 @@ bool HistoryFetcher::save_records(const std::string& key) const {
   return true;
 }
 
+void HistoryFetcher::fetch_pages(const std::string& cookie,
+                                 int first,
+                                 int end,
+                                 const DateRangeMs& range,
+                                 std::map<int, json>& probed,
+                                 size_t concurrency) {
+  std::vector<int> missing;
+  for (int page = first; page < end; ++page) {
+    if (probed.count(page) == 0) {
+      missing.push_back(page);
+    }
+  }
+
+  std::vector<json> fetched(missing.size());
+  FetchPool pool(concurrency, 0);
+  pool.run(missing.size(), [&](size_t index) {
+    return request_page(cookie, missing[index], fetched[index]);
+  });
+  for (size_t i = 0; i < missing.size(); ++i) {
+    if (fetched[i].is_array()) {
+      probed[missing[i]] = std::move(fetched[i]);
+    }
+  }
+
+  for (int page = first; page < end; ++page) {
+    auto it = probed.find(page);
+    if (it == probed.end()) {
+      LOG(WARNING) << "Failed to fetch page " << (page + 1)
+                   << ", continuing...";
+      continue;
+    }
+    bool reached_range_end = false;
+    add_games(it->second, page, range, reached_range_end);
+  }
+}
+
 bool HistoryFetcher::fetch(const std::string& cookie,
                            const std::string& key,
                            const std::string& start_date,
-                           const std::string& end_date) {
+                           const std::string& end_date,
+                           size_t concurrency) {
   auto& config = config::FetcherConfig::instance();
 
   records_.clear();
@@ -244,27 +344,137 @@ bool HistoryFetcher::fetch(const std::string& cookie,
   LOG(INFO) << "Starting to fetch history records";
   LOG(INFO) << "Max pages to fetch: " << config.get_max_pages();
 
-  std::string url = config.get_base_url() + config.get_history_endpoint();
+  std::map<int, json> probed;
+  int first = 0;
+  int end   = 0;
+  if (date_range && find_range_pages(cookie,
+                                     *date_range,
+                                     config.get_max_pages(),
+                                     probed,
+                                     first,
+                                     end)) {
+    LOG(INFO) << "Requested date range spans pages " << (first + 1) << " to "
+              << end << " (" << probed.size() << " pages probed)";
+    fetch_pages(cookie, first, end, *date_range, probed, concurrency);
+  } else {
+    for (int page = 1; page <= config.get_max_pages(); ++page) {
+      int page_param         = (page > 1) ? (page - 1) : 0;
+      bool reached_range_end = false;
+      if (!fetch_page(cookie, page_param, date_range, reached_range_end)) {
+        LOG(WARNING) << "Failed to fetch page " << page << ", continuing...";
+        continue;
+      }
 
-  for (int page = 1; page <= config.get_max_pages(); ++page) {
-    int page_param         = (page > 1) ? (page - 1) : 0;
-    bool reached_range_end = false;
-    if (!fetch_page(url, cookie, page_param, date_range, reached_range_end)) {
-      LOG(WARNING) << "Failed to fetch page " << page << ", continuing...";
-      continue;
+      if (date_range && reached_range_end) {
+        LOG(INFO)
+            << "Reached start of requested date range; stopping early at page "
+            << page;
+        break;
+      }
+    }
+  }
+
+  LOG(INFO) << "Finished fetching. Total records: " << records_.size();
+
+  if (!save_records(key)) {
+    return false;
+  }
+  if (!date_range) {
+    save_watermark(key);
+  }
+  return true;
+}
+
+bool HistoryFetcher::load_watermark(const std::string& key,
+                                    const json& history) {
+  watermark_.reset();
+  known_ids_.clear();
+
+  for (const auto& game : history) {
+    std::string id = game.value("id", "");
+    if (!id.empty()) {
+      known_ids_.insert(id);
     }
+  }
+
+  json stored;
+  if (storage_->exists(watermark_key(key)) &&
+      storage_->load_json(watermark_key(key), stored) && stored.is_object()) {
+    watermark_ = Watermark{stored.value("start_ms", int64_t{0}),
+                           stored.value("id", "")};
+    return true;
+  }
 
-    if (date_range && reached_range_end) {
-      LOG(INFO)
-          << "Reached start of requested date range; stopping early at page "
-          << page;
-      break;
+  // Older history files have no watermark yet; derive it from the games.
+  for (const auto& game : history) {
+    int64_t start_ms = GameStartMs(game);
+    if (!watermark_ || start_ms > watermark_->start_ms) {
+      watermark_ = Watermark{start_ms, game.value("id", "")};
     }
   }
+  return watermark_.has_value();
+}
 
-  LOG(INFO) << "Finished fetching. Total records: " << records_.size();
+bool HistoryFetcher::save_watermark(const std::string& key) const {
+  Watermark newest;
+  for (const auto& game : records_) {
+    int64_t start_ms = GameStartMs(game);
+    if (start_ms > newest.start_ms) {
+      newest = Watermark{start_ms, game.value("id", "")};
+    }
+  }
+
+  json stored = {{"start_ms", newest.start_ms},
+                 {"id", newest.id},
+                 {"games", records_.size()}};
+  if (!storage_->save_json(watermark_key(key), stored)) {
+    LOG(ERROR) << "Failed to save history watermark: " << watermark_key(key);
+    return false;
+  }
+  LOG(INFO) << "History watermark at " << newest.start_ms << " (" << newest.id
+            << ")";
+  return true;
+}
+
+bool HistoryFetcher::fetch_incremental(const std::string& cookie,
+                                       const std::string& key) {
+  auto& config = config::FetcherConfig::instance();
+
+  json history;
+  if (!storage_->exists(key) || !storage_->load_json(key, history) ||
+      !history.is_array() || !load_watermark(key, history)) {
+    LOG(INFO) << "No stored history under " << key << "; fetching all pages";
+    return fetch(cookie, key);
+  }
+
+  LOG(INFO) << "Fetching history newer than " << watermark_->start_ms << " ("
+            << known_ids_.size() << " games stored)";
+
+  records_.clear();
+
+  bool reached_known = false;
+  for (int page = 1; page <= config.get_max_pages() && !reached_known;
+       ++page) {
+    int page_param = (page > 1) ? (page - 1) : 0;
+    // A skipped page would leave a gap behind the new watermark.
+    if (!fetch_page(cookie, page_param, std::nullopt, reached_known)) {
+      LOG(ERROR) << "Failed to fetch page " << page
+                 << "; keeping stored history unchanged";
+      watermark_.reset();
+      return false;
+    }
+  }
+  watermark_.reset();
+
+  size_t new_count = records_.size();
+  for (auto& game : history) {
+    records_.push_back(std::move(game));
+  }
+
+  LOG(INFO) << "Found " << new_count << " new games; history now has "
+            << records_.size() << " games";
 
-  return save_records(key);
+  return save_records(key) && save_watermark(key);
 }
 
 std::vector<json>
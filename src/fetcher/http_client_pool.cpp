@@ -0,0 +1,282 @@
+#include "fetcher/http_client_pool.h"
+#include "config/fetcher_config.h"
+#include <httplib.h>
+#include <glog/logging.h>
+#include <algorithm>
+#include <random>
+#include <thread>
+
+namespace tziakcha {
+namespace fetcher {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+RetryPolicy ConfiguredRetryPolicy() {
+  auto& config = config::FetcherConfig::instance();
+
+  RetryPolicy policy;
+  policy.max_attempts  = std::max(config.get_retry_attempts(), 1);
+  policy.base_delay_ms = config.get_retry_base_delay_ms();
+  policy.max_delay_ms  = config.get_retry_max_delay_ms();
+  return policy;
+}
+
+CircuitBreaker::Options ConfiguredBreakerOptions() {
+  auto& config = config::FetcherConfig::instance();
+
+  CircuitBreaker::Options options;
+  options.window      = std::max(config.get_breaker_window(), 1);
+  options.error_rate  = config.get_breaker_error_rate();
+  options.cooldown_ms = config.get_breaker_cooldown_ms();
+  options.min_samples = std::min(options.min_samples, options.window);
+  return options;
+}
+
+double Jitter() {
+  thread_local std::mt19937 engine{std::random_device{}()};
+  return std::uniform_real_distribution<double>(0, 1)(engine);
+}
+
+std::string Describe(const HttpResponse& response) {
+  return response ? "HTTP status " + std::to_string(response.status)
+                  : response.error;
+}
+
+// Sends a POST whose 200 body goes to receiver as it is read. Bodies of
+// other statuses are collected in response.body as usual.
+void PostStreaming(httplib::ClientImpl& client,
+                   const std::string& path,
+                   const httplib::Headers& headers,
+                   const std::string& body,
+                   const std::string& content_type,
+                   const HttpClientPool::BodyReceiver& receiver,
+                   HttpResponse& response) {
+  httplib::Request req;
+  req.method  = "POST";
+  req.path    = path;
+  req.headers = headers;
+  req.headers.emplace("Content-Type", content_type);
+  req.body = body;
+
+  bool streaming       = false;
+  req.response_handler = [&](const httplib::Response& res) {
+    streaming = res.status == 200;
+    return true;
+  };
+  req.content_receiver =
+      [&](const char* data, size_t size, uint64_t offset, uint64_t) {
+        if (streaming) {
+          return receiver(data, size, offset);
+        }
+        response.body.append(data, size);
+        return true;
+      };
+
+  httplib::Response res;
+  httplib::Error error = httplib::Error::Success;
+  if (client.send(req, res, error)) {
+    response.status = res.status;
+  } else {
+    response.error = httplib::to_string(error);
+  }
+}
+
+} // namespace
+
+HttpClientPool::HttpClientPool()  = default;
+HttpClientPool::~HttpClientPool() = default;
+
+HttpClientPool& HttpClientPool::instance() {
+  static HttpClientPool pool;
+  return pool;
+}
+
+std::unique_ptr<httplib::ClientImpl> HttpClientPool::acquire() {
+  auto& config = config::FetcherConfig::instance();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!idle_.empty()) {
+      auto client = std::move(idle_.back());
+      idle_.pop_back();
+      return client;
+    }
+    stats_.clients_created++;
+  }
+
+  std::unique_ptr<httplib::ClientImpl> client;
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+  if (config.use_ssl()) {
+    auto ssl_client = std::make_unique<httplib::SSLClient>(
+        config.get_base_url(), config.get_port());
+    ssl_client->enable_server_certificate_verification(false);
+    client = std::move(ssl_client);
+  } else {
+#endif
+    client = std::make_unique<httplib::ClientImpl>(config.get_base_url(),
+                                                   config.get_port());
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+  }
+#endif
+
+  int timeout_sec = config.get_timeout_ms() / 1000;
+  client->set_keep_alive(config.use_keep_alive());
+  client->set_follow_location(true);
+  // Called for every socket the client connects, including the silent
+  // reconnects httplib makes when a kept-alive connection was closed.
+  client->set_socket_options([this](httplib::socket_t) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.connections_opened++;
+  });
+  client->set_connection_timeout(timeout_sec);
+  client->set_read_timeout(timeout_sec);
+  client->set_write_timeout(timeout_sec);
+  return client;
+}
+
+void HttpClientPool::release(std::unique_ptr<httplib::ClientImpl> client) {
+  auto& config = config::FetcherConfig::instance();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (config.use_keep_alive() && client->is_socket_open() &&
+      idle_.size() < static_cast<size_t>(config.get_max_connections())) {
+    idle_.push_back(std::move(client));
+  }
+}
+
+HttpResponse
+HttpClientPool::post(const std::string& path,
+                     const std::string& body,
+                     const std::string& content_type,
+                     const std::map<std::string, std::string>& extra_headers) {
+  return send(path, body, content_type, extra_headers, nullptr);
+}
+
+HttpResponse HttpClientPool::post_streaming(
+    const std::string& path,
+    const std::string& body,
+    const std::string& content_type,
+    const BodyReceiver& receiver,
+    const std::map<std::string, std::string>& extra_headers) {
+  return send(path, body, content_type, extra_headers, &receiver);
+}
+
+HttpResponse
+HttpClientPool::send(const std::string& path,
+                     const std::string& body,
+                     const std::string& content_type,
+                     const std::map<std::string, std::string>& extra_headers,
+                     const BodyReceiver* receiver) {
+  auto& config = config::FetcherConfig::instance();
+
+  httplib::Headers headers;
+  for (const auto& [key, value] : config.get_headers()) {
+    headers.emplace(key, value);
+  }
+  for (const auto& [key, value] : extra_headers) {
+    headers.emplace(key, value);
+  }
+
+  std::string origin = (config.use_ssl() ? "https://" : "http://") +
+                       config.get_base_url() + ":" +
+                       std::to_string(config.get_port());
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (origin != origin_) {
+      idle_.clear();
+      breaker_ = CircuitBreaker(ConfiguredBreakerOptions());
+      origin_  = origin;
+    }
+  }
+
+  RetryPolicy policy   = ConfiguredRetryPolicy();
+  std::string endpoint = path.substr(0, path.find('?'));
+
+  for (int attempt = 1;; ++attempt) {
+    wait_for_breaker();
+
+    auto client = acquire();
+    auto start  = Clock::now();
+
+    HttpResponse response;
+    response.attempts = attempt;
+    if (receiver) {
+      PostStreaming(
+          *client, path, headers, body, content_type, *receiver, response);
+    } else {
+      auto result = client->Post(path, headers, body, content_type);
+      if (result) {
+        response.status = result->status;
+        response.body   = std::move(result->body);
+      } else {
+        response.error = httplib::to_string(result.error());
+      }
+    }
+
+    std::chrono::duration<double, std::milli> latency = Clock::now() - start;
+    release(std::move(client));
+
+    bool retryable = RetryPolicy::IsRetryable(response.status);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stats_.requests++;
+      latencies_[endpoint].add(latency.count());
+      if (breaker_.record(!retryable)) {
+        stats_.breaker_trips++;
+        auto pause = std::chrono::duration_cast<std::chrono::milliseconds>(
+            breaker_.blocked_until() - Clock::now());
+        LOG(WARNING) << "Error rate too high, pausing requests for "
+                     << pause.count() << " ms";
+      }
+    }
+
+    if (!retryable || attempt >= policy.max_attempts) {
+      return response;
+    }
+
+    double delay_ms = policy.backoff_ms(attempt, Jitter());
+    LOG(WARNING) << "Request to " << endpoint << " failed ("
+                 << Describe(response) << "), retry " << attempt << "/"
+                 << (policy.max_attempts - 1) << " in "
+                 << static_cast<int>(delay_ms) << " ms";
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stats_.retries++;
+    }
+    std::this_thread::sleep_for(
+        std::chrono::duration<double, std::milli>(delay_ms));
+  }
+}
+
+void HttpClientPool::wait_for_breaker() {
+  Clock::time_point until;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    until = breaker_.blocked_until();
+  }
+  if (until > Clock::now()) {
+    std::this_thread::sleep_until(until);
+  }
+}
+
+HttpClientPool::Stats HttpClientPool::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Stats stats        = stats_;
+  stats.idle_clients = idle_.size();
+  return stats;
+}
+
+std::map<std::string, LatencyHistogram> HttpClientPool::latencies() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return latencies_;
+}
+
+void HttpClientPool::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  idle_.clear();
+}
+
+} // namespace fetcher
+} // namespace tziakcha
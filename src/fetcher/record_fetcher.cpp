@@ -1,6 +1,6 @@
 #include "fetcher/record_fetcher.h"
 #include "config/fetcher_config.h"
-#include <httplib.h>
+#include "fetcher/http_client_pool.h"
 #include <glog/logging.h>
 #include <sstream>
 #include <vector>
@@ -9,106 +9,111 @@
 namespace tziakcha {
 namespace fetcher {
 
-RecordFetcher::RecordFetcher(std::shared_ptr<storage::Storage> storage)
-    : storage_(storage) {}
+RecordFetcher::RecordFetcher(std::shared_ptr<storage::Storage> storage,
+                             utils::ScriptMode script_mode)
+    : storage_(storage), script_mode_(script_mode) {}
 
-bool RecordFetcher::fetch_record(const std::string& record_id,
-                                 const std::string& output_key) {
-  auto& config = config::FetcherConfig::instance();
+namespace {
+
+bool Fail(std::string* error, const std::string& reason) {
+  if (error) {
+    *error = reason;
+  }
+  return false;
+}
 
-  std::string base_url = config.get_base_url();
-  std::string endpoint = config.get_record_endpoint();
-  int timeout          = config.get_timeout_ms();
-  bool use_ssl         = config.use_ssl();
-  auto headers         = config.get_headers();
+} // namespace
+
+bool RecordFetcher::download_record(const std::string& record_id,
+                                    std::string& body,
+                                    std::string* error) {
+  auto& config = config::FetcherConfig::instance();
 
   std::string payload = "id=" + record_id;
 
   LOG(INFO) << "Fetching record: " << record_id;
 
-  try {
-    httplib::Result response;
-
-    if (use_ssl) {
-      httplib::SSLClient client(base_url, 443);
-      client.enable_server_certificate_verification(false);
-      client.set_connection_timeout(timeout / 1000);
-      client.set_read_timeout(timeout / 1000);
-      client.set_write_timeout(timeout / 1000);
-
-      httplib::Headers http_headers;
-      for (const auto& [key, value] : headers) {
-        http_headers.insert({key, value});
-      }
-
-      response = client.Post(endpoint, http_headers, payload, "text/plain");
-    } else {
-      httplib::Client client(base_url);
-      client.set_connection_timeout(timeout / 1000);
-      client.set_read_timeout(timeout / 1000);
-      client.set_write_timeout(timeout / 1000);
-
-      httplib::Headers http_headers;
-      for (const auto& [key, value] : headers) {
-        http_headers.insert({key, value});
-      }
-
-      response = client.Post(endpoint, http_headers, payload, "text/plain");
+  // The body is appended straight from the socket reads, so a caller that
+  // reuses body keeps its capacity from record to record.
+  body.clear();
+  auto receiver = [&body](const char* data, size_t size, uint64_t offset) {
+    if (offset == 0) {
+      body.clear();
     }
+    body.append(data, size);
+    return true;
+  };
+
+  try {
+    auto response = HttpClientPool::instance().post_streaming(
+        config.get_record_endpoint(), payload, "text/plain", receiver);
 
     if (!response) {
       LOG(ERROR) << "Failed to fetch record " << record_id
-                 << ": Connection error";
-      return false;
+                 << ": Connection error: " << response.error;
+      return Fail(error, "connection error: " + response.error);
     }
 
-    if (response->status != 200) {
+    if (response.status != 200) {
       LOG(ERROR) << "Failed to fetch record " << record_id << ": HTTP status "
-                 << response->status;
-      return false;
+                 << response.status;
+      return Fail(error, "HTTP status " + std::to_string(response.status));
     }
 
-    std::string key = output_key.empty() ? "record/" + record_id : output_key;
+    return true;
 
-    json record_data;
-    try {
-      record_data = json::parse(response->body);
-    } catch (const std::exception& e) {
-      LOG(ERROR) << "Failed to parse record JSON: " << e.what();
-      return false;
-    }
+  } catch (const std::exception& e) {
+    LOG(ERROR) << "Exception while fetching record " << record_id << ": "
+               << e.what();
+    return Fail(error, std::string("exception: ") + e.what());
+  }
+}
 
-    if (record_data.contains("script") && record_data["script"].is_string()) {
-      std::string script_str = record_data["script"];
-      if (script_str == "<Decoded>") {
-        LOG(INFO) << "Script already decoded, skipping";
-      } else {
-        json script_json;
-        if (utils::DecodeScriptToJson(script_str, script_json)) {
-          record_data["step"]   = script_json;
-          record_data["script"] = "<Decoded>";
-          LOG(INFO) << "Parsed script and added step field";
-        } else {
-          LOG(WARNING) << "Script parsing failed; step not added";
-        }
-      }
-    } else {
-      LOG(WARNING) << "Record JSON missing script field";
-    }
+bool RecordFetcher::fetch_record(const std::string& record_id,
+                                 const std::string& output_key,
+                                 std::string* error) {
+  thread_local std::string body;
+  if (!download_record(record_id, body, error)) {
+    return false;
+  }
+
+  std::string key = output_key.empty() ? "record/" + record_id : output_key;
 
-    if (!storage_->save_json(key, record_data)) {
+  // Records as served convert on the text and are stored as is; only an
+  // unusual one is parsed into a DOM and dumped again.
+  if (utils::ApplyScriptModeToText(body, script_mode_)) {
+    if (!storage_->save_string(key, body)) {
       LOG(ERROR) << "Failed to save record " << record_id << " to storage";
-      return false;
+      return Fail(error, "storage write failed");
     }
 
     LOG(INFO) << "Successfully saved record " << record_id << " to " << key;
     return true;
+  }
 
+  json record_data;
+  try {
+    record_data = json::parse(body);
   } catch (const std::exception& e) {
-    LOG(ERROR) << "Exception while fetching record " << record_id << ": "
-               << e.what();
-    return false;
+    LOG(ERROR) << "Failed to parse record JSON: " << e.what();
+    return Fail(error, std::string("invalid JSON: ") + e.what());
+  }
+
+  bool has_script =
+      record_data.contains("script") && record_data["script"].is_string();
+  if (!has_script) {
+    LOG(WARNING) << "Record JSON missing script field";
+  } else if (!utils::ApplyScriptMode(record_data, script_mode_)) {
+    LOG(WARNING) << "Script conversion failed; storing as received";
+  }
+
+  if (!storage_->save_json(key, record_data)) {
+    LOG(ERROR) << "Failed to save record " << record_id << " to storage";
+    return Fail(error, "storage write failed");
   }
+
+  LOG(INFO) << "Successfully saved record " << record_id << " to " << key;
+  return true;
 }
 
 } // namespace fetcher
@@ -0,0 +1,53 @@
+#include "fetcher/retry_policy.h"
+#include <algorithm>
+#include <cmath>
+
+namespace tziakcha {
+namespace fetcher {
+
+bool RetryPolicy::IsRetryable(int status) {
+  return status == 0 || status == 429 || status >= 500;
+}
+
+double RetryPolicy::backoff_ms(int retry, double jitter) const {
+  double delay = base_delay_ms * std::pow(2.0, std::max(retry - 1, 0));
+  delay        = std::min(delay, max_delay_ms);
+  return delay / 2 + delay / 2 * jitter;
+}
+
+CircuitBreaker::CircuitBreaker(const Options& options) : options_(options) {}
+
+bool CircuitBreaker::record(bool ok, Clock::time_point now) {
+  outcomes_.push_back(ok);
+  if (!ok) {
+    failures_++;
+  }
+  if (outcomes_.size() > options_.window) {
+    if (!outcomes_.front()) {
+      failures_--;
+    }
+    outcomes_.pop_front();
+  }
+  since_trip_++;
+
+  if (ok || outcomes_.size() < options_.min_samples ||
+      failures_ < options_.error_rate * outcomes_.size()) {
+    return false;
+  }
+
+  bool recent     = trips_ > 0 && since_trip_ <= options_.window;
+  cooldown_scale_ = recent ? std::min(cooldown_scale_ * 2, kMaxCooldownScale)
+                           : 1;
+  trips_++;
+  since_trip_ = 0;
+  outcomes_.clear();
+  failures_ = 0;
+
+  auto cooldown = std::chrono::duration<double, std::milli>(
+      options_.cooldown_ms * cooldown_scale_);
+  blocked_until_ = now + std::chrono::duration_cast<Clock::duration>(cooldown);
+  return true;
+}
+
+} // namespace fetcher
+} // namespace tziakcha
@@ -1,13 +1,46 @@
 #include "fetcher/session_fetcher.h"
 #include "config/fetcher_config.h"
+#include "fetcher/fetch_pool.h"
+#include "fetcher/http_client_pool.h"
 #include "storage/filesystem_storage.h"
-#include <httplib.h>
 #include <sstream>
 #include <glog/logging.h>
 
 namespace tziakcha {
 namespace fetcher {
 
+namespace {
+
+void AppendRecordIds(const json& session, std::vector<std::string>& ids) {
+  for (const char* field : {"records", "l"}) {
+    if (!session.contains(field) || !session[field].is_array()) {
+      continue;
+    }
+    for (const auto& record_id : session[field]) {
+      if (record_id.is_string()) {
+        ids.push_back(record_id.get<std::string>());
+      }
+    }
+    return;
+  }
+}
+
+} // namespace
+
+std::vector<std::string> CollectRecordIds(const json& session_json) {
+  std::vector<std::string> ids;
+  if (session_json.is_array()) {
+    for (const auto& session : session_json) {
+      if (session.is_object()) {
+        AppendRecordIds(session, ids);
+      }
+    }
+  } else if (session_json.is_object()) {
+    AppendRecordIds(session_json, ids);
+  }
+  return ids;
+}
+
 SessionFetcher::SessionFetcher(std::shared_ptr<storage::Storage> storage)
     : storage_(storage) {
   if (!storage_) {
@@ -16,70 +49,33 @@ SessionFetcher::SessionFetcher(std::shared_ptr<storage::Storage> storage)
 }
 
 bool SessionFetcher::fetch_session_records(const std::string& session_id,
-                                           const std::string& title,
                                            std::vector<std::string>& records) {
   auto& config = config::FetcherConfig::instance();
 
-  httplib::Headers header_map;
-  for (const auto& [key, value] : config.get_headers()) {
-    header_map.emplace(key, value);
-  }
-
   std::string endpoint = config.get_game_endpoint() + "/?id=" + session_id;
 
-  httplib::Result result;
-
-#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-  if (config.use_ssl()) {
-    httplib::SSLClient cli(config.get_base_url(), 443);
-    cli.enable_server_certificate_verification(false);
-    cli.set_follow_location(true);
-    cli.set_connection_timeout(config.get_timeout_ms() / 1000);
-    cli.set_read_timeout(config.get_timeout_ms() / 1000);
-    cli.set_write_timeout(config.get_timeout_ms() / 1000);
-
-    result = cli.Post(endpoint, header_map, "", "text/plain;charset=UTF-8");
-  } else {
-#endif
-    httplib::Client cli(config.get_base_url(), 80);
-    cli.set_follow_location(true);
-    cli.set_connection_timeout(config.get_timeout_ms() / 1000);
-    cli.set_read_timeout(config.get_timeout_ms() / 1000);
-    cli.set_write_timeout(config.get_timeout_ms() / 1000);
-
-    result = cli.Post(endpoint, header_map, "", "text/plain;charset=UTF-8");
-#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
-  }
-#endif
+  auto result = HttpClientPool::instance().post(
+      endpoint, "", "text/plain;charset=UTF-8");
 
   if (!result) {
-    LOG(ERROR) << "Failed to fetch session " << session_id << ": no result";
+    LOG(ERROR) << "Failed to fetch session " << session_id
+               << ": no result: " << result.error;
     return false;
   }
 
-  if (result->status != 200) {
+  if (result.status != 200) {
     LOG(ERROR) << "Failed to fetch session " << session_id
-               << ", status: " << result->status;
+               << ", status: " << result.status;
     return false;
   }
 
   try {
-    auto data = json::parse(result->body);
+    auto data = json::parse(result.body);
     if (data.is_object() && data.contains("records") &&
         data["records"].is_array()) {
-      int idx = 0;
       for (const auto& record : data["records"]) {
         if (record.is_object() && record.contains("i")) {
-          std::string rec_id = record["i"].get<std::string>();
-          records.push_back(rec_id);
-
-          RecordParentInfo parent_info;
-          parent_info.session_id       = session_id;
-          parent_info.title            = title;
-          parent_info.order_in_session = idx + 1;
-          record_parent_map_[rec_id]   = parent_info;
-
-          idx++;
+          records.push_back(record["i"].get<std::string>());
         }
       }
       return true;
@@ -95,7 +91,20 @@ bool SessionFetcher::fetch_session_records(const std::string& session_id,
   }
 }
 
-bool SessionFetcher::fetch_sessions(const std::string& history_key) {
+void SessionFetcher::add_parent_info(const std::string& session_id,
+                                     const std::string& title,
+                                     const std::vector<std::string>& records) {
+  for (size_t i = 0; i < records.size(); ++i) {
+    RecordParentInfo parent_info;
+    parent_info.session_id         = session_id;
+    parent_info.title              = title;
+    parent_info.order_in_session   = static_cast<int>(i) + 1;
+    record_parent_map_[records[i]] = parent_info;
+  }
+}
+
+bool SessionFetcher::fetch_sessions(const std::string& history_key,
+                                    size_t concurrency) {
   grouped_sessions_.clear();
   record_parent_map_.clear();
 
@@ -112,36 +121,52 @@ bool SessionFetcher::fetch_sessions(const std::string& history_key) {
 
   LOG(INFO) << "Processing " << history_data.size() << " history items";
 
-  int success_count = 0;
-  int failed_count  = 0;
-
+  std::vector<std::string> session_ids;
+  std::vector<std::string> titles;
   for (const auto& item : history_data) {
     if (!item.is_object()) {
       continue;
     }
 
     std::string session_id = item.value("id", "");
-    std::string title      = item.value("title", "");
-
     if (session_id.empty()) {
       continue;
     }
+    session_ids.push_back(session_id);
+    titles.push_back(item.value("title", ""));
+  }
 
-    std::vector<std::string> records;
-    if (fetch_session_records(session_id, title, records)) {
-      SessionRecords session;
-      session.session_id = session_id;
-      session.title      = title;
-      session.records    = records;
-      grouped_sessions_.push_back(session);
-
-      LOG(INFO) << "Fetched session " << session_id << " with "
-                << records.size() << " records";
-      success_count++;
-    } else {
-      LOG(WARNING) << "Failed to fetch session " << session_id;
+  // Workers fill one slot per session; results are merged afterwards in
+  // history order so the output does not depend on completion order.
+  std::vector<std::vector<std::string>> fetched(session_ids.size());
+  std::vector<char> fetched_ok(session_ids.size(), 0);
+
+  FetchPool pool(concurrency, 0);
+  pool.run(session_ids, [&](size_t index, const std::string& session_id) {
+    fetched_ok[index] = fetch_session_records(session_id, fetched[index]);
+    return fetched_ok[index] != 0;
+  });
+
+  int success_count = 0;
+  int failed_count  = 0;
+
+  for (size_t i = 0; i < session_ids.size(); ++i) {
+    if (!fetched_ok[i]) {
+      LOG(WARNING) << "Failed to fetch session " << session_ids[i];
       failed_count++;
+      continue;
     }
+
+    SessionRecords session;
+    session.session_id = session_ids[i];
+    session.title      = titles[i];
+    session.records    = std::move(fetched[i]);
+    add_parent_info(session.session_id, session.title, session.records);
+    grouped_sessions_.push_back(std::move(session));
+
+    LOG(INFO) << "Fetched session " << session_ids[i] << " with "
+              << grouped_sessions_.back().records.size() << " records";
+    success_count++;
   }
 
   LOG(INFO) << "Finished fetching sessions. Success: " << success_count
@@ -192,10 +217,11 @@ bool SessionFetcher::fetch_single_session(const std::string& session_id,
   LOG(INFO) << "Fetching single session: " << session_id;
 
   std::vector<std::string> records;
-  if (!fetch_session_records(session_id, "", records)) {
+  if (!fetch_session_records(session_id, records)) {
     LOG(ERROR) << "Failed to fetch session records for: " << session_id;
     return false;
   }
+  add_parent_info(session_id, "", records);
 
   json session_data;
   session_data["session_id"]   = session_id;
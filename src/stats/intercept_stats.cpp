@@ -307,5 +307,156 @@ std::vector<int> InterceptStats::GetWinPriorityOrder(int discarder_idx) const {
   return order;
 }
 
+InterceptCollector::InterceptCollector()
+    : last_result_(RecordInterceptResult::Round::kDraw) {
+  simulator_.AddActionObserver(
+      [this](const analyzer::Action& action,
+             int step,
+             const analyzer::GameState& state) {
+        OnAction(action, step, state);
+      });
+}
+
+RecordInterceptResult
+InterceptCollector::Collect(const std::string& round_id,
+                            std::string_view record_json) {
+  Begin(round_id);
+  return Finish(simulator_.Simulate(record_json));
+}
+
+RecordInterceptResult
+InterceptCollector::Collect(const std::string& round_id,
+                            const analyzer::Script& script) {
+  Begin(round_id);
+  return Finish(simulator_.Simulate(script));
+}
+
+void InterceptCollector::Begin(const std::string& round_id) {
+  stats_.Reset();
+  stats_.SetRoundId(round_id);
+  last_discard_player_ = -1;
+  last_discard_step_   = -1;
+  last_draw_player_    = -1;
+  last_draw_step_      = -1;
+  has_ron_event_       = false;
+  last_result_         = RecordInterceptResult::Round::kDraw;
+}
+
+RecordInterceptResult
+InterceptCollector::Finish(const analyzer::SimulationResult& sim) {
+  RecordInterceptResult result;
+  if (!sim.success) {
+    result.error_message = sim.error_message;
+    return result;
+  }
+
+  result.success     = true;
+  result.round       = last_result_;
+  result.ron_checked = last_result_ == RecordInterceptResult::Round::kRon &&
+                       has_ron_event_ &&
+                       !last_ron_event_.potential_winners.empty();
+  if (result.ron_checked) {
+    stats_.AddEvent(last_ron_event_);
+  }
+  result.stats = stats_.GetResult();
+  return result;
+}
+
+void InterceptCollector::OnAction(const analyzer::Action& action,
+                                  int step,
+                                  const analyzer::GameState& state) {
+  switch (action.action_type) {
+  case 2:
+    last_discard_player_ = action.player_idx;
+    last_discard_step_   = step;
+    break;
+  case 1:
+  case 7:
+    last_draw_player_ = action.player_idx;
+    last_draw_step_   = step;
+    break;
+  case 6: {
+    int fan = action.data >> 1;
+    if (fan <= 0) {
+      break;
+    }
+
+    bool is_self_drawn = (last_draw_player_ == action.player_idx) &&
+                         (last_draw_step_ > last_discard_step_);
+    if (is_self_drawn) {
+      last_result_ = RecordInterceptResult::Round::kTsumo;
+      break;
+    }
+    last_result_ = RecordInterceptResult::Round::kRon;
+
+    int discarder_idx = state.GetLastDiscardPlayer();
+    int discard_tile  = state.GetLastDiscardTile();
+    if (discarder_idx < 0 || discard_tile < 0) {
+      LOG(WARNING) << "Skip intercept check: missing discarder info";
+      break;
+    }
+
+    last_ron_event_ = stats_.CheckIntercept(discarder_idx,
+                                            discard_tile,
+                                            state,
+                                            state.GetDealerIdx(),
+                                            simulator_.GetRoundWindIndex(),
+                                            step);
+    has_ron_event_  = true;
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+void InterceptSummary::Add(const RecordInterceptResult& result) {
+  files_seen++;
+  if (!result.success) {
+    return;
+  }
+
+  files_success++;
+  total_ron_wins += result.stats.total_ron_wins;
+  intercept_cnt += result.stats.intercept_count;
+  total_events += static_cast<int>(result.stats.events.size());
+
+  switch (result.round) {
+  case RecordInterceptResult::Round::kDraw:
+    draw_rounds++;
+    break;
+  case RecordInterceptResult::Round::kTsumo:
+    tsumo_rounds++;
+    break;
+  case RecordInterceptResult::Round::kRon:
+    ron_rounds++;
+    if (result.ron_checked) {
+      ron_calc_ok++;
+    } else {
+      ron_calc_fail++;
+    }
+    break;
+  }
+}
+
+void InterceptSummary::Print(std::ostream& out) const {
+  double intercept_rate = 0.0;
+  if (total_ron_wins > 0) {
+    intercept_rate = static_cast<double>(intercept_cnt) / total_ron_wins;
+  }
+
+  out << "\n=== Intercept Stats Summary ===\n";
+  out << "Files scanned: " << files_seen << " (success: " << files_success
+      << ")\n";
+  out << "Ron wins: " << total_ron_wins << "\n";
+  out << "Intercepts: " << intercept_cnt << "\n";
+  out << "Intercept rate: " << intercept_rate * 100.0 << "%\n";
+  out << "Rounds - Draw: " << draw_rounds << ", Self-draw: " << tsumo_rounds
+      << ", Ron: " << ron_rounds << "\n";
+  out << "Ron calc success: " << ron_calc_ok
+      << ", Ron calc failed/invalid: " << ron_calc_fail << "\n";
+  out << "Events recorded: " << total_events << "\n";
+}
+
 } // namespace stats
 } // namespace tziakcha
@@ -1,20 +1,19 @@
 #include "stats/player_stats.h"
 
 #include "base/mahjong_constants.h"
-#include "stats/player_stats_config.h"
-#include "storage/filesystem_storage.h"
-#include "utils/script_decoder.h"
+#include "storage/storage_factory.h"
+#include "storage/write_behind_storage.h"
+#include "analyzer/script.h"
 #include "analyzer/simulator.h"
 
 #include <algorithm>
 #include <array>
 #include <filesystem>
-#include <fstream>
 #include <glog/logging.h>
 #include <limits>
 #include <nlohmann/json.hpp>
-#include <sstream>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -79,14 +78,16 @@ struct PlayerSlot {
   std::string name;
 };
 
+constexpr size_t kRecordLoadBatch = 64;
+
+// script is only populated while the record's load batch is being
+// processed.
 struct RecordMeta {
-  fs::path path;
+  std::string key;
   std::string record_id;
   std::string session_id;
   int64_t timestamp_ms = 0;
-  json script_json;
-  std::string content;
-  json raw_json;
+  analyzer::Script script;
 };
 
 struct WinFlagInfo {
@@ -103,56 +104,18 @@ struct SessionInfo {
 
 namespace {
 
-bool ReadFile(const fs::path& path, std::string& out) {
-  std::ifstream ifs(path);
-  if (!ifs.is_open()) {
-    return false;
-  }
-  std::ostringstream ss;
-  ss << ifs.rdbuf();
-  out = ss.str();
-  return true;
-}
-
-json ParseJson(const std::string& content, const fs::path& path) {
-  try {
-    return json::parse(content);
-  } catch (const std::exception& e) {
-    LOG(WARNING) << "Failed to parse json from " << path << ": " << e.what();
-    return json::object();
-  }
-}
-
-bool DecodeScript(const json& record_json, json& script_json) {
-  if (!record_json.contains("script")) {
-    return false;
-  }
-  std::string encoded = record_json.value("script", "");
-  return utils::DecodeScriptToJson(encoded, script_json);
-}
-
-std::vector<PlayerSlot> ExtractPlayers(const json& script_json) {
+std::vector<PlayerSlot> ExtractPlayers(const analyzer::Script& script) {
   std::vector<PlayerSlot> players;
-  if (!script_json.contains(PlayerStatsConfig::kScriptPlayers) ||
-      !script_json[PlayerStatsConfig::kScriptPlayers].is_array()) {
-    return players;
-  }
-  const auto& p_arr = script_json[PlayerStatsConfig::kScriptPlayers];
-  for (size_t i = 0; i < p_arr.size(); ++i) {
-    PlayerSlot slot{static_cast<int>(i), "", ""};
-    const auto& obj = p_arr[i];
-    if (obj.is_object()) {
-      slot.id   = obj.value("i", "");
-      slot.name = obj.value("n", "");
-    }
-    players.push_back(slot);
+  for (size_t i = 0; i < script.players.size(); ++i) {
+    const auto& player = script.players[i];
+    players.push_back({static_cast<int>(i), player.id, player.name});
   }
   return players;
 }
 
-WinFlagInfo ParseWinFlags(const json& script_json) {
+WinFlagInfo ParseWinFlags(const analyzer::Script& script) {
   WinFlagInfo info;
-  int win_flags = script_json.value(PlayerStatsConfig::kScriptWinFlags, 0);
+  int win_flags = script.win_flags;
 
   for (int i = 0; i < 4; ++i) {
     if ((win_flags & (1 << i)) != 0) {
@@ -170,17 +133,8 @@ WinFlagInfo ParseWinFlags(const json& script_json) {
   return info;
 }
 
-std::vector<FanSummary> ExtractMaxFans(const json& win_data) {
+std::vector<FanSummary> ExtractMaxFans(const analyzer::ScriptWin& win) {
   std::vector<FanSummary> fans;
-  if (!win_data.is_object() ||
-      !win_data.contains(PlayerStatsConfig::kWinFanMap)) {
-    return fans;
-  }
-
-  const auto& t_obj = win_data[PlayerStatsConfig::kWinFanMap];
-  if (!t_obj.is_object()) {
-    return fans;
-  }
 
   int max_points = 0;
   struct FanDetailParsed {
@@ -191,11 +145,9 @@ std::vector<FanSummary> ExtractMaxFans(const json& win_data) {
   };
   std::vector<FanDetailParsed> parsed;
 
-  for (auto it = t_obj.begin(); it != t_obj.end(); ++it) {
-    int fan_id  = std::stoi(it.key());
-    int raw_val = it.value().get<int>();
-    int points  = raw_val & 0xFF;
-    int count   = ((raw_val >> 8) & 0xFF) + 1;
+  for (const auto& [fan_id, raw_val] : win.fans) {
+    int points = raw_val & 0xFF;
+    int count  = ((raw_val >> 8) & 0xFF) + 1;
     std::string name =
         (fan_id >= 0 && fan_id < static_cast<int>(base::FAN_NAMES.size()))
             ? base::FAN_NAMES[fan_id]
@@ -215,15 +167,38 @@ std::vector<FanSummary> ExtractMaxFans(const json& win_data) {
   return fans;
 }
 
-int64_t GetRecordTimestamp(const json& record_json) {
-  if (record_json.contains(PlayerStatsConfig::kStep) &&
-      record_json[PlayerStatsConfig::kStep].is_object()) {
-    const auto& step_obj = record_json[PlayerStatsConfig::kStep];
-    return step_obj.value(
-        PlayerStatsConfig::kStepTimestamp,
-        record_json.value(PlayerStatsConfig::kRecordTimestamp, 0LL));
+void LoadRecordBatch(storage::Storage& record_storage,
+                     std::vector<RecordMeta>& records,
+                     size_t begin) {
+  size_t release_from =
+      begin >= kRecordLoadBatch ? begin - kRecordLoadBatch : 0;
+  for (size_t i = release_from; i < begin; ++i) {
+    records[i].script = analyzer::Script();
+  }
+
+  size_t end = std::min(records.size(), begin + kRecordLoadBatch);
+  std::vector<std::string> keys;
+  for (size_t i = begin; i < end; ++i) {
+    keys.push_back(records[i].key);
   }
-  return record_json.value(PlayerStatsConfig::kRecordTimestamp, 0LL);
+
+  // Keys that fail to load are skipped, so match each one up by key.
+  size_t next = begin;
+  record_storage.stream_records(
+      keys, [&](const std::string& key, const storage::RecordView& content) {
+        while (next < end && records[next].key != key) {
+          LOG(WARNING) << "Failed to load " << records[next].key;
+          next++;
+        }
+        if (next == end) {
+          return false;
+        }
+        auto& record = records[next++];
+        if (!analyzer::ParseRecordScript(content.data(), record.script)) {
+          LOG(WARNING) << "Failed to decode script for " << record.key;
+        }
+        return true;
+      });
 }
 
 struct DurationBreakdown {
@@ -231,30 +206,14 @@ struct DurationBreakdown {
   int64_t record_ms = 0;
 };
 
-DurationBreakdown ComputeActionDurations(const json& record_json) {
+DurationBreakdown
+ComputeActionDurations(const analyzer::ActionColumns& actions) {
   DurationBreakdown out;
   out.player_ms.fill(0);
 
-  if (!record_json.contains(PlayerStatsConfig::kStep) ||
-      !record_json[PlayerStatsConfig::kStep].is_object()) {
-    return out;
-  }
-  const auto& step_obj = record_json[PlayerStatsConfig::kStep];
-  if (!step_obj.contains(PlayerStatsConfig::kStepActions) ||
-      !step_obj[PlayerStatsConfig::kStepActions].is_array()) {
-    return out;
-  }
-
-  const auto& acts = step_obj[PlayerStatsConfig::kStepActions];
-  int64_t prev_t   = 0;
-
-  for (const auto& act : acts) {
-    if (!act.is_array() || act.size() <= PlayerStatsConfig::kActionTimeIndex ||
-        !act[0].is_number_integer() ||
-        !act[PlayerStatsConfig::kActionTimeIndex].is_number_integer()) {
-      continue;
-    }
-    int64_t t = act[PlayerStatsConfig::kActionTimeIndex].get<int64_t>();
+  int64_t prev_t = 0;
+  for (size_t i = 0; i < actions.size(); ++i) {
+    int64_t t = actions.time_ms[i];
     if (t < 0) {
       LOG(WARNING) << "Skipping negative action time " << t;
       continue;
@@ -268,12 +227,7 @@ DurationBreakdown ComputeActionDurations(const json& record_json) {
       continue;
     }
 
-    int combined   = act[0].get<int>();
-    int player_idx = (combined >> 4) & 3;
-    if (player_idx >= 0 &&
-        player_idx < static_cast<int>(out.player_ms.size())) {
-      out.player_ms[player_idx] += delta;
-    }
+    out.player_ms[actions.player[i]] += delta;
 
     prev_t        = t;
     out.record_ms = t;
@@ -282,30 +236,13 @@ DurationBreakdown ComputeActionDurations(const json& record_json) {
   return out;
 }
 
-std::array<int64_t, 4> CountStepsByPlayer(const json& record_json) {
+std::array<int64_t, 4>
+CountStepsByPlayer(const analyzer::ActionColumns& actions) {
   std::array<int64_t, 4> counts{};
   counts.fill(0);
 
-  if (!record_json.contains(PlayerStatsConfig::kStep) ||
-      !record_json[PlayerStatsConfig::kStep].is_object()) {
-    return counts;
-  }
-  const auto& step_obj = record_json[PlayerStatsConfig::kStep];
-  if (!step_obj.contains(PlayerStatsConfig::kStepActions) ||
-      !step_obj[PlayerStatsConfig::kStepActions].is_array()) {
-    return counts;
-  }
-
-  const auto& acts = step_obj[PlayerStatsConfig::kStepActions];
-  for (const auto& act : acts) {
-    if (!act.is_array() || act.empty() || !act[0].is_number_integer()) {
-      continue;
-    }
-    int combined   = act[0].get<int>();
-    int player_idx = (combined >> 4) & 3;
-    if (player_idx >= 0 && player_idx < static_cast<int>(counts.size())) {
-      counts[player_idx]++;
-    }
+  for (uint8_t player : actions.player) {
+    counts[player]++;
   }
 
   return counts;
@@ -468,46 +405,46 @@ bool RunPlayerStats(const PlayerStatsOptions& options) {
   (void)options.session_map_path;
   (void)options.verbose;
 
-  storage::FileSystemStorage storage(options.output_dir);
+  storage::Encoding encoding;
+  if (!storage::ParseEncoding(options.encoding, encoding)) {
+    return false;
+  }
 
+  auto player_storage = std::make_shared<storage::WriteBehindStorage>(
+      storage::OpenStorage(
+          options.output_dir, storage::StorageBackend::kAuto, encoding));
+  auto record_storage = storage::OpenStorage(record_dir.string(),
+                                             storage::StorageBackend::kAuto,
+                                             storage::Encoding::kJson,
+                                             storage::OpenMode::kReadOnly);
+
+  // Only the ordering metadata is kept for every record; documents are
+  // loaded again in batches while the sorted records are processed.
   std::vector<RecordMeta> records;
-  for (auto it = fs::recursive_directory_iterator(record_dir);
-       it != fs::recursive_directory_iterator();
-       ++it) {
-    if (!it->is_regular_file() || it->path().extension() != ".json") {
-      continue;
-    }
-    if (options.limit > 0 &&
-        static_cast<int>(records.size()) >= options.limit) {
-      break;
-    }
+  record_storage->for_each_record(
+      "", [&](const std::string& key, const storage::RecordView& content) {
+        if (options.limit > 0 &&
+            static_cast<int>(records.size()) >= options.limit) {
+          return false;
+        }
 
-    std::string content;
-    if (!ReadFile(it->path(), content)) {
-      LOG(WARNING) << "Failed to read record: " << it->path();
-      continue;
-    }
-    auto record_json = ParseJson(content, it->path());
-    json script_json;
-    if (record_json.contains("step") && record_json["step"].is_object()) {
-      script_json = record_json["step"];
-    } else if (!DecodeScript(record_json, script_json)) {
-      LOG(WARNING) << "Failed to decode script for " << it->path();
-      continue;
-    }
+        analyzer::RecordHeader header;
+        if (!analyzer::ParseRecordHeader(content.data(), header)) {
+          LOG(WARNING) << "Skipping unparsable record " << key;
+          return true;
+        }
 
-    RecordMeta meta;
-    meta.path        = it->path();
-    meta.content     = std::move(content);
-    meta.script_json = script_json;
-    meta.raw_json    = record_json;
-    meta.record_id   = record_json.value(
-        PlayerStatsConfig::kRecordId, it->path().stem().string());
-    meta.session_id   = record_json.value(PlayerStatsConfig::kSessionId, "");
-    meta.timestamp_ms = GetRecordTimestamp(record_json);
-
-    records.push_back(std::move(meta));
-  }
+        RecordMeta meta;
+        meta.key          = key;
+        meta.record_id    = header.id.empty()
+                                ? key.substr(key.find_last_of('/') + 1)
+                                : std::move(header.id);
+        meta.session_id   = std::move(header.session);
+        meta.timestamp_ms = header.timestamp;
+
+        records.push_back(std::move(meta));
+        return true;
+      });
 
   std::sort(records.begin(),
             records.end(),
@@ -532,7 +469,7 @@ bool RunPlayerStats(const PlayerStatsOptions& options) {
     ps.name      = slot.name;
 
     json existing;
-    if (storage.load_json(slot.id, existing)) {
+    if (player_storage->load_json(slot.id, existing)) {
       ps = FromJson(existing);
       if (!slot.name.empty()) {
         ps.name = slot.name;
@@ -554,39 +491,23 @@ bool RunPlayerStats(const PlayerStatsOptions& options) {
   };
 
   int processed_records = 0;
-  for (const auto& record : records) {
-    auto slots = ExtractPlayers(record.script_json);
+  for (size_t record_idx = 0; record_idx < records.size(); ++record_idx) {
+    if (record_idx % kRecordLoadBatch == 0) {
+      LoadRecordBatch(*record_storage, records, record_idx);
+    }
+
+    const auto& record = records[record_idx];
+    auto slots         = ExtractPlayers(record.script);
     if (slots.empty()) {
       continue;
     }
 
-    auto durations   = ComputeActionDurations(record.raw_json);
-    auto step_counts = CountStepsByPlayer(record.raw_json);
-
-    const json* player_e_src = nullptr;
-    if (record.raw_json.contains(PlayerStatsConfig::kStep) &&
-        record.raw_json[PlayerStatsConfig::kStep].is_object()) {
-      const auto& step_obj = record.raw_json[PlayerStatsConfig::kStep];
-      if (step_obj.contains(PlayerStatsConfig::kStepPlayers) &&
-          step_obj[PlayerStatsConfig::kStepPlayers].is_array()) {
-        player_e_src = &step_obj[PlayerStatsConfig::kStepPlayers];
-      }
-    } else if (record.script_json.contains(PlayerStatsConfig::kScriptPlayers) &&
-               record.script_json[PlayerStatsConfig::kScriptPlayers]
-                   .is_array()) {
-      player_e_src = &record.script_json[PlayerStatsConfig::kScriptPlayers];
-    }
+    auto durations   = ComputeActionDurations(record.script.actions);
+    auto step_counts = CountStepsByPlayer(record.script.actions);
 
-    if (player_e_src) {
-      const auto& sp = *player_e_src;
-      for (size_t i = 0; i < sp.size() && i < slots.size(); ++i) {
-        if (!sp[i].is_object()) {
-          continue;
-        }
-        double elo_val = sp[i].value(PlayerStatsConfig::kEloField, 1500.0);
-        auto& ps       = get_player(slots[i]);
-        ps.current_elo = elo_val;
-      }
+    for (size_t i = 0; i < slots.size(); ++i) {
+      auto& ps       = get_player(slots[i]);
+      ps.current_elo = record.script.players[i].elo;
     }
 
     std::vector<PlayerStats*> stats_ptrs;
@@ -613,7 +534,7 @@ bool RunPlayerStats(const PlayerStatsOptions& options) {
       continue;
     }
 
-    const auto flag_info = ParseWinFlags(record.script_json);
+    const auto flag_info = ParseWinFlags(record.script);
     const int winner_idx =
         flag_info.winners.empty() ? -1 : flag_info.winners.front();
     const bool is_draw = winner_idx < 0;
@@ -621,18 +542,12 @@ bool RunPlayerStats(const PlayerStatsOptions& options) {
         (!is_draw &&
          (flag_info.discarder < 0 || flag_info.discarder == winner_idx));
 
-    json win_data;
-    if (!is_draw &&
-        record.script_json.contains(PlayerStatsConfig::kScriptWins) &&
-        record.script_json[PlayerStatsConfig::kScriptWins].is_array() &&
-        winner_idx <
-            static_cast<int>(
-                record.script_json[PlayerStatsConfig::kScriptWins].size())) {
-      win_data = record.script_json[PlayerStatsConfig::kScriptWins][winner_idx];
-    }
-    int total_fan = win_data.is_object()
-                      ? win_data.value(PlayerStatsConfig::kWinFanTotal, 0)
-                      : 0;
+    static const analyzer::ScriptWin kNoWin;
+    const auto& win_data =
+        !is_draw && winner_idx < static_cast<int>(record.script.wins.size())
+            ? record.script.wins[winner_idx]
+            : kNoWin;
+    int total_fan = win_data.total_fan;
     auto max_fans = ExtractMaxFans(win_data);
 
     auto& session  = sessions[record.session_id];
@@ -643,7 +558,7 @@ bool RunPlayerStats(const PlayerStatsOptions& options) {
     std::string gb_hand_str;
     if (!is_draw) {
       analyzer::RecordSimulator simulator;
-      auto sim_result = simulator.Simulate(record.content);
+      auto sim_result = simulator.Simulate(record.script);
       if (sim_result.success &&
           sim_result.win_analysis.winner_idx == winner_idx) {
         gb_hand_str = sim_result.win_analysis.hand_string_for_gb;
@@ -689,15 +604,8 @@ bool RunPlayerStats(const PlayerStatsOptions& options) {
         win_entry.timestamp_ms = record.timestamp_ms;
         win_entry.win_type     = is_self_drawn ? "tsumo" : "ron";
         win_entry.total_fan    = total_fan;
-        if (!gb_hand_str.empty()) {
-          win_entry.hand_raw = gb_hand_str;
-        } else if (win_data.contains(PlayerStatsConfig::kWinHand)) {
-          try {
-            win_entry.hand_raw = win_data[PlayerStatsConfig::kWinHand].dump();
-          } catch (const std::exception&) {
-            win_entry.hand_raw.clear();
-          }
-        }
+        win_entry.hand_raw =
+            gb_hand_str.empty() ? win_data.hand : gb_hand_str;
         win_entry.max_fans = max_fans;
         ps.wins.push_back(std::move(win_entry));
       } else {
@@ -742,17 +650,19 @@ bool RunPlayerStats(const PlayerStatsOptions& options) {
     }
   }
 
-  int saved = 0;
   for (auto& [pid, ps] : players) {
-    if (storage.save_json(pid, ToJson(ps))) {
-      saved++;
-    }
+    player_storage->save_json(pid, ToJson(ps));
   }
 
+  bool flushed = player_storage->flush();
   LOG(INFO) << "Player stats processed records: " << processed_records
-            << ", players saved: " << saved;
+            << ", players saved: " << player_storage->written_count();
 
-  return true;
+  if (!flushed) {
+    LOG(ERROR) << "Failed to write " << player_storage->failed_count()
+               << " player stats files";
+  }
+  return flushed;
 }
 
 } // namespace stats
@@ -0,0 +1,191 @@
+#include "stats/record_pipeline.h"
+#include "analyzer/script.h"
+#include "utils/bounded_queue.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <glog/logging.h>
+#include <thread>
+
+namespace tziakcha {
+namespace stats {
+
+namespace {
+
+struct RawRecord {
+  std::string id;
+  std::string body;
+};
+
+struct DecodedRecord {
+  std::string id;
+  analyzer::Script script;
+};
+
+struct AnalysedRecord {
+  std::string id;
+  RecordInterceptResult result;
+};
+
+// Starts workers threads running work; the last one to finish calls done,
+// which closes the stage's output queue.
+void StartStage(size_t workers,
+                std::vector<std::thread>& threads,
+                const std::function<void()>& work,
+                const std::function<void()>& done) {
+  workers        = std::max<size_t>(workers, 1);
+  auto remaining = std::make_shared<std::atomic<size_t>>(workers);
+  for (size_t i = 0; i < workers; ++i) {
+    threads.emplace_back([work, done, remaining] {
+      work();
+      if (--*remaining == 0) {
+        done();
+      }
+    });
+  }
+}
+
+// Parses the record into the script the simulator reads. The persisted
+// copy is converted to the requested script mode first and the script is
+// read from that text, so the record is parsed once and its script is
+// inflated at most once. If the text cannot be converted in place, the
+// record is expanded as json and the script is read from that json.
+// The text is handed to the persist storage as is; a WriteBehindStorage
+// queues it without parsing it again.
+bool DecodeRecord(const RawRecord& raw,
+                  const RecordPipelineOptions& options,
+                  analyzer::Script& script,
+                  bool& persisted) {
+  bool expand = options.persist &&
+                options.script_mode == utils::ScriptMode::kDecoded;
+  persisted   = true;
+
+  std::string expanded;
+  json record;
+  if (expand) {
+    expanded = raw.body;
+    if (!utils::ApplyScriptModeToText(expanded, options.script_mode)) {
+      record = json::parse(raw.body, nullptr, false);
+      if (record.is_discarded() || !utils::ExpandRecordScript(record)) {
+        LOG(WARNING) << "Failed to decode record " << raw.id;
+        return false;
+      }
+      expanded = record.dump();
+    }
+  }
+
+  const std::string& text = expand ? expanded : raw.body;
+  std::string error;
+  bool parsed = record.is_object()
+                    ? analyzer::ExtractRecordScript(record, script, &error)
+                    : analyzer::ParseRecordScript(text, script, &error);
+  if (!parsed) {
+    LOG(WARNING) << "Failed to decode record " << raw.id << ": " << error;
+    return false;
+  }
+
+  if (options.persist) {
+    persisted = options.persist->save_string(raw.id, text);
+  }
+  return true;
+}
+
+} // namespace
+
+RecordPipelineStats RunRecordPipeline(const std::vector<std::string>& ids,
+                                      const RecordSource& source,
+                                      const RecordSink& sink,
+                                      const RecordPipelineOptions& options) {
+  using Clock = std::chrono::steady_clock;
+  auto start  = Clock::now();
+
+  utils::BoundedQueue<RawRecord> raw_queue(options.queue_capacity);
+  utils::BoundedQueue<DecodedRecord> decoded_queue(options.queue_capacity);
+  utils::BoundedQueue<AnalysedRecord> analysed_queue(options.queue_capacity);
+
+  std::atomic<size_t> next{0};
+  std::atomic<size_t> fetched{0};
+  std::atomic<size_t> fetch_failed{0};
+  std::atomic<size_t> decode_failed{0};
+  std::atomic<size_t> persist_failed{0};
+
+  std::vector<std::thread> threads;
+
+  StartStage(
+      options.fetch_workers,
+      threads,
+      [&] {
+        for (size_t i = next++; i < ids.size(); i = next++) {
+          RawRecord raw{ids[i], {}};
+          if (!source(raw.id, raw.body)) {
+            fetch_failed++;
+            continue;
+          }
+          fetched++;
+          if (!raw_queue.push(std::move(raw))) {
+            return;
+          }
+        }
+      },
+      [&] { raw_queue.close(); });
+
+  StartStage(
+      options.decode_workers,
+      threads,
+      [&] {
+        while (auto raw = raw_queue.pop()) {
+          DecodedRecord decoded{raw->id, {}};
+          bool persisted = true;
+          if (DecodeRecord(*raw, options, decoded.script, persisted)) {
+            decoded_queue.push(std::move(decoded));
+          } else {
+            // Failures skip the simulators but still reach the sink, so
+            // every fetched record is accounted for.
+            decode_failed++;
+            AnalysedRecord failed{raw->id, {}};
+            failed.result.error_message = "failed to decode record";
+            analysed_queue.push(std::move(failed));
+          }
+          if (!persisted) {
+            persist_failed++;
+          }
+        }
+      },
+      [&] { decoded_queue.close(); });
+
+  StartStage(
+      options.simulate_workers,
+      threads,
+      [&] {
+        InterceptCollector collector;
+        while (auto decoded = decoded_queue.pop()) {
+          AnalysedRecord analysed{decoded->id, {}};
+          analysed.result = collector.Collect(decoded->id, decoded->script);
+          analysed_queue.push(std::move(analysed));
+        }
+      },
+      [&] { analysed_queue.close(); });
+
+  RecordPipelineStats stats;
+  while (auto analysed = analysed_queue.pop()) {
+    if (analysed->result.success) {
+      stats.simulated++;
+    }
+    sink(analysed->id, analysed->result);
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+  stats.fetched                         = fetched;
+  stats.fetch_failed                    = fetch_failed;
+  stats.decode_failed                   = decode_failed;
+  stats.persist_failed                  = persist_failed;
+  stats.elapsed_seconds                 = elapsed.count();
+  return stats;
+}
+
+} // namespace stats
+} // namespace tziakcha
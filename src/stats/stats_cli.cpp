@@ -1,5 +1,6 @@
 #include <filesystem>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <string>
 
@@ -7,22 +8,116 @@
 #include <glog/logging.h>
 
 #include "analyzer/simulator.h"
+#include "config/fetcher_config.h"
+#include "fetcher/fetch_pool.h"
+#include "fetcher/record_fetcher.h"
+#include "fetcher/session_fetcher.h"
 #include "stats/intercept_stats.h"
 #include "stats/player_stats.h"
+#include "stats/record_pipeline.h"
+#include "storage/storage_factory.h"
+#include "storage/write_behind_storage.h"
 
 namespace fs = std::filesystem;
 
 namespace {
-bool ReadFileToString(const fs::path& path, std::string& out) {
-  std::ifstream ifs(path);
-  if (!ifs.is_open()) {
-    return false;
+
+void PrintInterceptEvents(
+    const std::string& record_key,
+    const tziakcha::stats::RecordInterceptResult& result) {
+  std::cout << "\n[Record] " << record_key << "\n";
+  for (const auto& ev : result.stats.events) {
+    if (ev.is_intercept) {
+      std::cout << ev.ToString() << "\n";
+    }
+  }
+}
+
+// Fetches the records listed in a session file and computes the intercept
+// summary as they arrive, without reading them back from disk.
+int RunFetchPipeline(const cxxopts::ParseResult& result,
+                     const fs::path& dir,
+                     int limit,
+                     bool list_events) {
+  std::string config_file = result["config"].as<std::string>();
+  if (!tziakcha::config::FetcherConfig::instance().load(config_file)) {
+    std::cerr << "Failed to load configuration file: " << config_file
+              << std::endl;
+    return 1;
+  }
+
+  fs::path sessions_path = result["fetch-sessions"].as<std::string>();
+  json session_json;
+  try {
+    std::ifstream file(sessions_path);
+    session_json = json::parse(file);
+  } catch (const std::exception& e) {
+    std::cerr << "Failed to read session file " << sessions_path << ": "
+              << e.what() << std::endl;
+    return 1;
+  }
+
+  auto ids = tziakcha::fetcher::CollectRecordIds(session_json);
+  if (limit > 0 && limit < static_cast<int>(ids.size())) {
+    ids.resize(limit);
   }
-  std::ostringstream ss;
-  ss << ifs.rdbuf();
-  out = ss.str();
-  return true;
+
+  tziakcha::stats::RecordPipelineOptions pipeline_opts;
+  pipeline_opts.fetch_workers    = std::max(result["concurrency"].as<int>(), 1);
+  pipeline_opts.simulate_workers =
+      std::max(result["simulate-workers"].as<int>(), 1);
+
+  std::shared_ptr<tziakcha::storage::WriteBehindStorage> writer;
+  if (result["persist"].as<bool>()) {
+    if (!tziakcha::utils::ParseScriptMode(
+            result["script-mode"].as<std::string>(),
+            pipeline_opts.script_mode)) {
+      std::cerr << "Unknown script mode" << std::endl;
+      return 1;
+    }
+    writer = std::make_shared<tziakcha::storage::WriteBehindStorage>(
+        tziakcha::storage::OpenStorage(dir.string()));
+    pipeline_opts.persist = writer;
+  }
+
+  tziakcha::fetcher::RecordFetcher fetcher(writer);
+  tziakcha::fetcher::RateLimiter limiter(result["rate"].as<double>());
+  auto source = [&](const std::string& id, std::string& body) {
+    limiter.acquire();
+    return fetcher.download_record(id, body);
+  };
+
+  tziakcha::stats::InterceptSummary summary;
+  auto sink = [&](const std::string& id,
+                  const tziakcha::stats::RecordInterceptResult& record) {
+    summary.Add(record);
+    if (!record.success) {
+      LOG(WARNING) << "Simulation failed for " << id << ": "
+                   << record.error_message;
+    } else if (list_events && record.stats.intercept_count > 0) {
+      PrintInterceptEvents(id, record);
+    }
+  };
+
+  auto stats =
+      tziakcha::stats::RunRecordPipeline(ids, source, sink, pipeline_opts);
+
+  bool flushed = !writer || writer->flush();
+  summary.Print(std::cout);
+  std::cout << "\n=== Pipeline ===\n";
+  std::cout << "Records: " << ids.size() << ", fetched: " << stats.fetched
+            << ", fetch failed: " << stats.fetch_failed
+            << ", decode failed: " << stats.decode_failed << "\n";
+  if (writer) {
+    std::cout << "Persisted: " << writer->written_count() << " to " << dir
+              << " (failed: " << writer->failed_count() << ")\n";
+  }
+  std::cout << std::fixed << std::setprecision(1)
+            << "Elapsed: " << stats.elapsed_seconds << " s\n";
+
+  return (stats.fetch_failed > 0 || !flushed) ? 1 : 0;
 }
+
 } // namespace
 
 int main(int argc, char* argv[]) {
@@ -34,7 +129,7 @@ int main(int argc, char* argv[]) {
       "stats_cli", "Mahjong intercept (\u622a\u548c) statistics CLI");
   options.add_options()(
       "d,dir",
-      "Record directory",
+      "Record directory or packed archive",
       cxxopts::value<std::string>()->default_value("data/record"))(
       "l,limit",
       "Maximum files to process (0 = all)",
@@ -48,13 +143,41 @@ int main(int argc, char* argv[]) {
       "player-dir",
       "Output directory for player stats",
       cxxopts::value<std::string>()->default_value("data/player"))(
+      "player-encoding",
+      "Player stats document encoding (json, cbor, msgpack)",
+      cxxopts::value<std::string>()->default_value("json"))(
       "session-map",
       "Optional session map file (currently unused, reserved for future)",
       cxxopts::value<std::string>()->default_value(
           "data/sessions/all_record.json"))(
       "list-events",
       "Print intercept events",
-      cxxopts::value<bool>()->default_value("false"))("h,help", "Show help");
+      cxxopts::value<bool>()->default_value("false"))(
+      "fetch-sessions",
+      "Fetch the records listed in this session file and analyse them as "
+      "they arrive instead of reading --dir",
+      cxxopts::value<std::string>())(
+      "c,config",
+      "Fetcher configuration file (with --fetch-sessions)",
+      cxxopts::value<std::string>()->default_value(
+          "config/fetcher_config.json"))(
+      "concurrency",
+      "Records fetched in parallel (with --fetch-sessions)",
+      cxxopts::value<int>()->default_value("4"))(
+      "rate",
+      "Maximum record requests per second (0 = unlimited)",
+      cxxopts::value<double>()->default_value("2"))(
+      "simulate-workers",
+      "Records simulated in parallel (with --fetch-sessions); above 1 "
+      "assumes the fan calculator is thread-safe",
+      cxxopts::value<int>()->default_value("1"))(
+      "persist",
+      "Also save fetched records under --dir (with --fetch-sessions)",
+      cxxopts::value<bool>()->default_value("false"))(
+      "script-mode",
+      "Script form of persisted records (decoded, compressed)",
+      cxxopts::value<std::string>()->default_value("decoded"))(
+      "h,help", "Show help");
 
   auto result = options.parse(argc, argv);
   if (result.count("help")) {
@@ -78,6 +201,10 @@ int main(int argc, char* argv[]) {
   bool list_events = result["list-events"].as<bool>();
   bool player_mode = result["player-stats"].as<bool>();
 
+  if (result.count("fetch-sessions")) {
+    return RunFetchPipeline(result, dir, limit, list_events);
+  }
+
   if (!fs::exists(dir) || !fs::is_directory(dir)) {
     std::cerr << "Record directory not found: " << dir << std::endl;
     return 1;
@@ -88,6 +215,7 @@ int main(int argc, char* argv[]) {
     ps_opts.record_dir       = dir.string();
     ps_opts.output_dir       = result["player-dir"].as<std::string>();
     ps_opts.session_map_path = result["session-map"].as<std::string>();
+    ps_opts.encoding         = result["player-encoding"].as<std::string>();
     ps_opts.limit            = limit;
     ps_opts.verbose          = verbose;
 
@@ -102,198 +230,39 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
-  tziakcha::analyzer::RecordSimulator simulator;
-  tziakcha::stats::InterceptStats intercept_stats;
-
-  int last_discard_player = -1;
-  int last_discard_step   = -1;
-  int last_discard_tile   = -1;
-  int last_draw_player    = -1;
-  int last_draw_step      = -1;
-  bool file_has_win       = false;
-  bool file_has_tsumo     = false;
-  bool file_has_ron       = false;
-  enum class RoundResult { None, Draw, Tsumo, Ron };
-  RoundResult last_result = RoundResult::None;
-  bool has_ron_event      = false;
-  tziakcha::stats::InterceptEvent last_ron_event{};
-
-  simulator.ClearActionObservers();
-  simulator.AddActionObserver(
-      [&intercept_stats,
-       &simulator,
-       &last_discard_player,
-       &last_discard_step,
-       &last_discard_tile,
-       &last_draw_player,
-       &last_draw_step,
-       &file_has_win,
-       &file_has_tsumo,
-       &file_has_ron,
-       &last_result,
-       &has_ron_event,
-       &last_ron_event](const tziakcha::analyzer::Action& action,
-                        int step,
-                        const tziakcha::analyzer::GameState& state) {
-        switch (action.action_type) {
-        case 2:
-          last_discard_player = action.player_idx;
-          last_discard_step   = step;
-          last_discard_tile   = state.GetLastDiscardTile();
-          break;
-        case 1:
-        case 7:
-          last_draw_player = action.player_idx;
-          last_draw_step   = step;
-          break;
-        case 6: {
-          int fan = action.data >> 1;
-          if (fan <= 0) {
-            break;
-          }
-
-          file_has_win = true;
-
-          bool is_self_drawn = (last_draw_player == action.player_idx) &&
-                               (last_draw_step > last_discard_step);
-
-          if (is_self_drawn) {
-            file_has_tsumo = true;
-            last_result    = RoundResult::Tsumo;
-            break;
-          }
-
-          file_has_ron = true;
-          last_result  = RoundResult::Ron;
-
-          int discarder_idx = state.GetLastDiscardPlayer();
-          int discard_tile  = state.GetLastDiscardTile();
-
-          if (discarder_idx < 0 || discard_tile < 0) {
-            LOG(WARNING) << "Skip intercept check: missing discarder info";
-            break;
-          }
-
-          int round_wind_index = simulator.GetRoundWindIndex();
-          auto ev              = intercept_stats.CheckIntercept(
-              discarder_idx,
-              discard_tile,
-              state,
-              state.GetDealerIdx(),
-              round_wind_index,
-              step);
-          has_ron_event  = true;
-          last_ron_event = ev;
-          break;
-        }
-        default:
-          break;
+  tziakcha::stats::InterceptCollector collector;
+  tziakcha::stats::InterceptSummary summary;
+
+  auto storage = tziakcha::storage::OpenStorage(
+      dir.string(),
+      tziakcha::storage::StorageBackend::kAuto,
+      tziakcha::storage::Encoding::kJson,
+      tziakcha::storage::OpenMode::kReadOnly);
+
+  storage->for_each_record(
+      "",
+      [&](const std::string& record_key,
+          const tziakcha::storage::RecordView& content) {
+        if (limit > 0 && summary.files_seen >= limit) {
+          return false;
         }
-      });
-
-  int files_seen     = 0;
-  int files_success  = 0;
-  int total_ron_wins = 0;
-  int intercept_cnt  = 0;
-  int total_events   = 0;
-  int draw_rounds    = 0;
-  int tsumo_rounds   = 0;
-  int ron_rounds     = 0;
-  int ron_calc_ok    = 0;
-  int ron_calc_fail  = 0;
-
-  for (auto it = fs::recursive_directory_iterator(dir);
-       it != fs::recursive_directory_iterator();
-       ++it) {
-    if (!it->is_regular_file()) {
-      continue;
-    }
-    if (it->path().extension() != ".json") {
-      continue;
-    }
-    if (limit > 0 && files_seen >= limit) {
-      break;
-    }
-
-    ++files_seen;
-    const auto& path = it->path();
 
-    std::string content;
-    if (!ReadFileToString(path, content)) {
-      LOG(ERROR) << "Failed to read file: " << path;
-      continue;
-    }
-
-    intercept_stats.Reset();
-    intercept_stats.SetRoundId(path.filename().string());
-    last_discard_player = -1;
-    last_discard_step   = -1;
-    last_discard_tile   = -1;
-    last_draw_player    = -1;
-    last_draw_step      = -1;
-    file_has_win        = false;
-    file_has_tsumo      = false;
-    file_has_ron        = false;
-    last_result         = RoundResult::None;
-    has_ron_event       = false;
-
-    auto res = simulator.Simulate(content);
-    if (!res.success) {
-      LOG(WARNING) << "Simulation failed for " << path << ": "
-                   << res.error_message;
-      continue;
-    }
-
-    if (last_result == RoundResult::Ron && has_ron_event &&
-        !last_ron_event.potential_winners.empty()) {
-      intercept_stats.AddEvent(last_ron_event);
-    }
-
-    ++files_success;
-    const auto& stats = intercept_stats.GetResult();
-    total_ron_wins += stats.total_ron_wins;
-    intercept_cnt += stats.intercept_count;
-    total_events += static_cast<int>(stats.events.size());
-
-    if (!file_has_win || last_result == RoundResult::None) {
-      ++draw_rounds;
-    } else if (last_result == RoundResult::Tsumo) {
-      ++tsumo_rounds;
-    } else if (last_result == RoundResult::Ron) {
-      ++ron_rounds;
-      if (has_ron_event && !last_ron_event.potential_winners.empty()) {
-        ++ron_calc_ok;
-      } else {
-        ++ron_calc_fail;
-      }
-    }
-
-    if (list_events && stats.intercept_count > 0) {
-      std::cout << "\n[File] " << path << "\n";
-      for (const auto& ev : stats.events) {
-        if (ev.is_intercept) {
-          std::cout << ev.ToString() << "\n";
+        auto result = collector.Collect(
+            record_key.substr(record_key.find_last_of('/') + 1),
+            content.data());
+        summary.Add(result);
+        if (!result.success) {
+          LOG(WARNING) << "Simulation failed for " << record_key << ": "
+                       << result.error_message;
+          return true;
         }
-      }
-    }
-  }
-
-  double intercept_rate = 0.0;
-  if (total_ron_wins > 0) {
-    intercept_rate = static_cast<double>(intercept_cnt) / total_ron_wins;
-  }
 
-  std::cout << "\n=== Intercept Stats Summary ===\n";
-  std::cout << "Files scanned: " << files_seen << " (success: " << files_success
-            << ")\n";
-  std::cout << "Ron wins: " << total_ron_wins << "\n";
-  std::cout << "Intercepts: " << intercept_cnt << "\n";
-  std::cout << "Intercept rate: " << intercept_rate * 100.0 << "%\n";
-  std::cout << "Rounds - Draw: " << draw_rounds << ", Self-draw: "
-            << tsumo_rounds << ", Ron: " << ron_rounds << "\n";
-  std::cout << "Ron calc success: " << ron_calc_ok
-            << ", Ron calc failed/invalid: " << ron_calc_fail << "\n";
-  std::cout << "Events recorded: " << total_events << "\n";
+        if (list_events && result.stats.intercept_count > 0) {
+          PrintInterceptEvents(record_key, result);
+        }
+        return true;
+      });
 
+  summary.Print(std::cout);
   return 0;
 }
@@ -0,0 +1,204 @@
+#include "storage/caching_storage.h"
+#include <iostream>
+#include <glog/logging.h>
+
+namespace tziakcha {
+namespace storage {
+
+namespace {
+
+// Rough in-memory footprint of a parsed document: one node per value plus
+// the heap storage of strings and object keys.
+size_t EstimateBytes(const json& value) {
+  size_t bytes = sizeof(json);
+  switch (value.type()) {
+  case json::value_t::object:
+    for (const auto& [key, child] : value.items()) {
+      bytes += key.size() + sizeof(std::string) + EstimateBytes(child);
+    }
+    break;
+  case json::value_t::array:
+    for (const auto& child : value) {
+      bytes += EstimateBytes(child);
+    }
+    break;
+  case json::value_t::string:
+    bytes += value.get_ref<const std::string&>().size();
+    break;
+  case json::value_t::binary:
+    bytes += value.get_binary().size();
+    break;
+  default:
+    break;
+  }
+  return bytes;
+}
+
+} // namespace
+
+CachingStorage::CachingStorage(std::shared_ptr<Storage> inner,
+                               size_t capacity_bytes)
+    : inner_(std::move(inner)), capacity_bytes_(capacity_bytes) {}
+
+bool CachingStorage::lookup(const std::string& key, json& data) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    stats_.misses++;
+    return false;
+  }
+
+  lru_.splice(lru_.begin(), lru_, it->second);
+  data = it->second->data;
+  stats_.hits++;
+  return true;
+}
+
+void CachingStorage::insert(const std::string& key, const json& data) {
+  size_t bytes = EstimateBytes(data) + key.size();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(key);
+  if (it != entries_.end()) {
+    stats_.bytes -= it->second->bytes;
+    lru_.erase(it->second);
+    entries_.erase(it);
+  }
+
+  if (bytes > capacity_bytes_) {
+    stats_.entries = entries_.size();
+    return;
+  }
+
+  lru_.push_front(Entry{key, data, bytes});
+  entries_[key] = lru_.begin();
+  stats_.bytes += bytes;
+
+  while (stats_.bytes > capacity_bytes_) {
+    const Entry& victim = lru_.back();
+    stats_.bytes -= victim.bytes;
+    entries_.erase(victim.key);
+    lru_.pop_back();
+    stats_.evictions++;
+  }
+  stats_.entries = entries_.size();
+}
+
+void CachingStorage::erase(const std::string& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    return;
+  }
+  stats_.bytes -= it->second->bytes;
+  lru_.erase(it->second);
+  entries_.erase(it);
+  stats_.entries = entries_.size();
+}
+
+bool CachingStorage::save_json(const std::string& key, const json& data) {
+  if (!inner_->save_json(key, data)) {
+    erase(key);
+    return false;
+  }
+  insert(key, data);
+  return true;
+}
+
+bool CachingStorage::save_string(const std::string& key,
+                                 const std::string& content) {
+  // The text is not parsed here; the next load caches the document.
+  bool ok = inner_->save_string(key, content);
+  erase(key);
+  return ok;
+}
+
+bool CachingStorage::load_json(const std::string& key, json& data) {
+  if (lookup(key, data)) {
+    return true;
+  }
+  if (!inner_->load_json(key, data)) {
+    return false;
+  }
+  insert(key, data);
+  return true;
+}
+
+bool CachingStorage::load_string(const std::string& key, std::string& out) {
+  json data;
+  if (lookup(key, data)) {
+    out = data.dump();
+    return true;
+  }
+  return inner_->load_string(key, out);
+}
+
+bool CachingStorage::load_view(const std::string& key, RecordView& out) {
+  json data;
+  if (lookup(key, data)) {
+    out = RecordView::FromString(data.dump());
+    return true;
+  }
+  return inner_->load_view(key, out);
+}
+
+bool CachingStorage::save_many(
+    const std::vector<std::pair<std::string, json>>& items) {
+  if (!inner_->save_many(items)) {
+    for (const auto& item : items) {
+      erase(item.first);
+    }
+    return false;
+  }
+  for (const auto& [key, data] : items) {
+    insert(key, data);
+  }
+  return true;
+}
+
+bool CachingStorage::exists(const std::string& key) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (entries_.count(key) > 0) {
+      return true;
+    }
+  }
+  return inner_->exists(key);
+}
+
+bool CachingStorage::remove(const std::string& key) {
+  erase(key);
+  return inner_->remove(key);
+}
+
+std::vector<std::string>
+CachingStorage::list_keys(const std::string& prefix) {
+  return inner_->list_keys(prefix);
+}
+
+void CachingStorage::print_json(const std::string& key, int indent) {
+  json data;
+  if (load_json(key, data)) {
+    std::cout << data.dump(indent) << std::endl;
+  } else {
+    LOG(ERROR) << "Failed to load JSON for key: " << key;
+  }
+}
+
+bool CachingStorage::flush() { return inner_->flush(); }
+
+CachingStorage::CacheStats CachingStorage::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void CachingStorage::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  lru_.clear();
+  entries_.clear();
+  stats_.entries = 0;
+  stats_.bytes   = 0;
+}
+
+} // namespace storage
+} // namespace tziakcha
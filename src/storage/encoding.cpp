@@ -0,0 +1,103 @@
+#include "storage/encoding.h"
+#include <algorithm>
+#include <cstdint>
+#include <glog/logging.h>
+#include <vector>
+
+namespace tziakcha {
+namespace storage {
+
+namespace {
+constexpr uint8_t kCborSelfDescribe[] = {0xD9, 0xD9, 0xF7};
+constexpr uint8_t kUtf8Bom[]          = {0xEF, 0xBB, 0xBF};
+static_assert(sizeof(kCborSelfDescribe) == kCborPrefixSize);
+} // namespace
+
+bool ParseEncoding(const std::string& name, Encoding& encoding) {
+  if (name == "json") {
+    encoding = Encoding::kJson;
+  } else if (name == "cbor") {
+    encoding = Encoding::kCbor;
+  } else if (name == "msgpack") {
+    encoding = Encoding::kMsgpack;
+  } else {
+    LOG(ERROR) << "Unknown storage encoding: " << name;
+    return false;
+  }
+  return true;
+}
+
+const char* EncodingName(Encoding encoding) {
+  switch (encoding) {
+  case Encoding::kCbor:
+    return "cbor";
+  case Encoding::kMsgpack:
+    return "msgpack";
+  case Encoding::kJson:
+  default:
+    return "json";
+  }
+}
+
+Encoding DetectEncoding(std::string_view data) {
+  const auto* bytes = reinterpret_cast<const uint8_t*>(data.data());
+  if (data.size() >= kCborPrefixSize &&
+      std::equal(
+          kCborSelfDescribe, kCborSelfDescribe + kCborPrefixSize, bytes)) {
+    return Encoding::kCbor;
+  }
+  if (data.empty() || bytes[0] < 0x80) {
+    return Encoding::kJson;
+  }
+  if (data.size() >= sizeof(kUtf8Bom) &&
+      std::equal(kUtf8Bom, kUtf8Bom + sizeof(kUtf8Bom), bytes)) {
+    return Encoding::kJson;
+  }
+  return Encoding::kMsgpack;
+}
+
+std::string EncodeDocument(const json& data, Encoding encoding) {
+  switch (encoding) {
+  case Encoding::kCbor: {
+    std::string out(
+        reinterpret_cast<const char*>(kCborSelfDescribe), kCborPrefixSize);
+    json::to_cbor(data, out);
+    return out;
+  }
+  case Encoding::kMsgpack: {
+    std::string out;
+    json::to_msgpack(data, out);
+    return out;
+  }
+  case Encoding::kJson:
+  default:
+    return data.dump();
+  }
+}
+
+bool DecodeDocument(std::string_view data, json& out) {
+  const auto* begin = reinterpret_cast<const uint8_t*>(data.data());
+  const auto* end   = begin + data.size();
+
+  try {
+    switch (DetectEncoding(data)) {
+    case Encoding::kCbor:
+      out = json::from_cbor(begin + kCborPrefixSize, end);
+      break;
+    case Encoding::kMsgpack:
+      out = json::from_msgpack(begin, end);
+      break;
+    case Encoding::kJson:
+    default:
+      out = json::parse(data);
+      break;
+    }
+    return true;
+  } catch (const std::exception& e) {
+    LOG(ERROR) << "Failed to decode document: " << e.what();
+    return false;
+  }
+}
+
+} // namespace storage
+} // namespace tziakcha
@@ -1,23 +1,117 @@
 #include "storage/filesystem_storage.h"
+#include "storage/mapped_file.h"
+#include "storage/prefetch_reader.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <sstream>
+#include <set>
+#include <thread>
 #include <glog/logging.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace tziakcha {
 namespace storage {
 
-FileSystemStorage::FileSystemStorage(const std::string& base_dir)
-    : base_dir_(base_dir) {
+namespace {
+
+bool WriteAll(int fd, const char* buf, size_t len) {
+  while (len > 0) {
+    ssize_t n = ::write(fd, buf, len);
+    if (n <= 0) {
+      return false;
+    }
+    buf += n;
+    len -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+bool SyncDirectory(const fs::path& dir) {
+  int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = ::fsync(fd) == 0;
+  ::close(fd);
+  return ok;
+}
+
+// Starts writeback of a file's dirty pages without waiting for it, so the
+// fdatasync calls that follow overlap their I/O.
+void StartWriteback(int fd) {
+#ifdef __linux__
+  ::sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+#else
+  (void)fd;
+#endif
+}
+
+// Distinguishes temp files of concurrent writers of one key in a process.
+uint64_t NextTempId() {
+  static std::atomic<uint64_t> next{0};
+  return next++;
+}
+
+constexpr char kLayoutFile[]        = "layout.meta";
+constexpr size_t kKeysPerLoadWorker = 8;
+constexpr size_t kKeysPerReadBatch  = 1024;
+// Temp files save_many holds open to sync together.
+constexpr size_t kFilesPerSyncGroup = 64;
+
+uint32_t HashKey(const std::string& key) {
+  uint32_t hash = 2166136261u;
+  for (unsigned char c : key) {
+    hash ^= c;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+std::string StripJsonExtension(std::string name) {
+  const std::string json_ext = ".json";
+  if (name.length() >= json_ext.length() &&
+      name.compare(name.length() - json_ext.length(),
+                   json_ext.length(),
+                   json_ext) == 0) {
+    name.erase(name.length() - json_ext.length());
+  }
+  return name;
+}
+
+} // namespace
+
+FileSystemStorage::FileSystemStorage(const std::string& base_dir,
+                                     Encoding encoding)
+    : base_dir_(base_dir), encoding_(encoding) {
   if (!fs::exists(base_dir_)) {
     if (!fs::create_directories(base_dir_)) {
       LOG(ERROR) << "Failed to create base directory: " << base_dir;
     }
   }
+
+  load_layout();
+
+  if (KeyManifest::Exists(base_dir_)) {
+    auto manifest = std::make_unique<KeyManifest>(base_dir_);
+    if (manifest->load() && manifest->is_current()) {
+      manifest_ = std::move(manifest);
+    } else {
+      LOG(WARNING) << "Key manifest in " << base_dir_
+                   << " is older than the files it lists, rebuilding";
+      rebuild_manifest();
+    }
+  }
 }
 
-fs::path FileSystemStorage::key_to_path(const std::string& key) const {
+fs::path FileSystemStorage::key_to_path(const std::string& key,
+                                        int levels) const {
   fs::path path = base_dir_;
+  std::string logical_key;
 
   size_t last_pos = 0;
   size_t pos      = 0;
@@ -26,64 +120,350 @@ fs::path FileSystemStorage::key_to_path(const std::string& key) const {
     std::string part = key.substr(last_pos, pos - last_pos);
     if (!part.empty()) {
       path /= part;
+      logical_key += part + "/";
     }
     last_pos = pos + 1;
   }
 
   std::string filename = key.substr(last_pos);
-  if (!filename.empty()) {
-    path /= filename;
+  if (filename.empty()) {
+    path.replace_extension(".json");
+    return path;
   }
 
-  if (path.extension() != ".json") {
-    path.replace_extension(".json");
+  fs::path file = filename;
+  if (file.extension() != ".json") {
+    file.replace_extension(".json");
   }
 
-  return path;
+  if (levels > 0) {
+    logical_key += StripJsonExtension(file.string());
+    uint32_t hash = HashKey(logical_key);
+    for (int i = 0; i < levels; ++i) {
+      char shard[3];
+      std::snprintf(shard, sizeof(shard), "%02x", (hash >> (8 * i)) & 0xFF);
+      path /= shard;
+    }
+  }
+
+  return path / file;
 }
 
 std::string FileSystemStorage::path_to_key(const fs::path& path) const {
-  std::string rel = fs::relative(path, base_dir_).string();
+  std::string key;
+  locate_key(path, shard_levels_, key);
+  return key;
+}
 
-  const std::string json_ext = ".json";
-  if (rel.length() >= json_ext.length() &&
-      rel.compare(
-          rel.length() - json_ext.length(), json_ext.length(), json_ext) == 0) {
-    rel.erase(rel.length() - json_ext.length());
+bool FileSystemStorage::locate_key(const fs::path& path,
+                                   int levels,
+                                   std::string& key) const {
+  std::vector<std::string> parts;
+  for (const auto& part : path.lexically_relative(base_dir_)) {
+    parts.push_back(part.string());
+  }
+  if (parts.size() < static_cast<size_t>(levels) + 1) {
+    return false;
   }
 
-  for (auto& c : rel) {
-    if (c == '\\')
-      c = '/';
+  parts.erase(parts.end() - 1 - levels, parts.end() - 1);
+
+  key.clear();
+  for (size_t i = 0; i < parts.size(); ++i) {
+    if (i > 0) {
+      key += '/';
+    }
+    key += parts[i];
   }
+  key = StripJsonExtension(std::move(key));
 
-  return rel;
+  return levels == 0 || key_to_path(key, levels) == path;
 }
 
-bool FileSystemStorage::save_json(const std::string& key, const json& data) {
-  fs::path path = key_to_path(key);
+bool FileSystemStorage::load_layout() {
+  fs::path layout_path = base_dir_ / kLayoutFile;
+  if (!fs::exists(layout_path)) {
+    return true;
+  }
 
-  if (!fs::exists(path.parent_path())) {
-    if (!fs::create_directories(path.parent_path())) {
+  std::ifstream file(layout_path);
+  json layout = json::parse(file, nullptr, false);
+  int levels  = layout.is_object() ? layout.value("shard_levels", -1) : -1;
+  if (levels < 0 || levels > kMaxShardLevels) {
+    LOG(ERROR) << "Invalid storage layout file: " << layout_path;
+    return false;
+  }
+
+  shard_levels_ = levels;
+  return true;
+}
+
+bool FileSystemStorage::save_layout(int levels) const {
+  fs::path layout_path = base_dir_ / kLayoutFile;
+  fs::path temp_path   = layout_path;
+  temp_path += ".tmp";
+
+  {
+    std::ofstream file(temp_path, std::ios::trunc);
+    file << json{{"shard_levels", levels}}.dump() << "\n";
+    if (!file.good()) {
+      LOG(ERROR) << "Failed to write storage layout: " << temp_path;
+      return false;
+    }
+  }
+
+  std::error_code ec;
+  fs::rename(temp_path, layout_path, ec);
+  if (ec) {
+    LOG(ERROR) << "Failed to replace storage layout " << layout_path << ": "
+               << ec.message();
+    return false;
+  }
+  return true;
+}
+
+bool FileSystemStorage::reshard(int levels, size_t* moved) {
+  if (levels < 0 || levels > kMaxShardLevels) {
+    LOG(ERROR) << "Shard levels must be between 0 and " << kMaxShardLevels;
+    return false;
+  }
+
+  // After an interrupted run files may sit in either layout, so each one is
+  // matched against the deepest layout whose hash prefix it satisfies.
+  std::vector<std::pair<fs::path, std::string>> files;
+  std::vector<fs::path> directories;
+  try {
+    for (const auto& entry : fs::recursive_directory_iterator(base_dir_)) {
+      if (entry.is_directory()) {
+        directories.push_back(entry.path());
+        continue;
+      }
+      if (!entry.is_regular_file() || entry.path().extension() != ".json") {
+        continue;
+      }
+      std::string key;
+      for (int l = kMaxShardLevels; l >= 0; --l) {
+        if (locate_key(entry.path(), l, key)) {
+          files.emplace_back(entry.path(), key);
+          break;
+        }
+      }
+    }
+  } catch (const std::exception& e) {
+    LOG(ERROR) << "Failed to scan " << base_dir_ << ": " << e.what();
+    return false;
+  }
+
+  size_t moved_count = 0;
+  bool ok            = true;
+  for (const auto& [path, key] : files) {
+    fs::path target = key_to_path(key, levels);
+    if (target == path) {
+      continue;
+    }
+
+    std::error_code ec;
+    fs::create_directories(target.parent_path(), ec);
+    fs::rename(path, target, ec);
+    if (ec) {
+      LOG(ERROR) << "Failed to move " << path << " to " << target << ": "
+                 << ec.message();
+      ok = false;
+      continue;
+    }
+    moved_count++;
+  }
+
+  std::sort(directories.begin(),
+            directories.end(),
+            [](const fs::path& a, const fs::path& b) {
+              return a.native().size() > b.native().size();
+            });
+  for (const auto& dir : directories) {
+    std::error_code ec;
+    if (fs::is_empty(dir, ec) && !ec) {
+      fs::remove(dir, ec);
+    }
+  }
+
+  if (moved) {
+    *moved = moved_count;
+  }
+
+  if (!ok || !save_layout(levels)) {
+    return false;
+  }
+
+  shard_levels_ = levels;
+  if (manifest_ && !rebuild_manifest()) {
+    return false;
+  }
+  LOG(INFO) << "Resharded " << base_dir_ << " to " << levels
+            << " levels, moved " << moved_count << " files";
+  return true;
+}
+
+bool FileSystemStorage::write_temp(const fs::path& path,
+                                   const json& data,
+                                   fs::path& temp_path,
+                                   int* open_fd) const {
+  return write_temp_bytes(
+      path, EncodeDocument(data, encoding_), temp_path, open_fd);
+}
+
+bool FileSystemStorage::write_temp_bytes(const fs::path& path,
+                                         std::string_view bytes,
+                                         fs::path& temp_path,
+                                         int* open_fd) const {
+  std::error_code ec;
+  if (!fs::exists(path.parent_path(), ec)) {
+    if (!fs::create_directories(path.parent_path(), ec)) {
       LOG(ERROR) << "Failed to create directory: " << path.parent_path();
       return false;
     }
   }
 
-  std::ofstream file(path);
-  if (!file.is_open()) {
-    LOG(ERROR) << "Failed to open file for writing: " << path;
+  temp_path = path;
+  temp_path += ".tmp." + std::to_string(::getpid()) + "." +
+               std::to_string(NextTempId());
+
+  int fd = ::open(
+      temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    LOG(ERROR) << "Failed to open file for writing: " << temp_path;
     return false;
   }
 
-  file << data.dump();
-  file.close();
+  bool ok = WriteAll(fd, bytes.data(), bytes.size());
+  if (ok && open_fd) {
+    *open_fd = fd;
+    return true;
+  }
+  ok = ::close(fd) == 0 && ok;
+  if (!ok) {
+    LOG(ERROR) << "Failed to write file: " << temp_path;
+    ::unlink(temp_path.c_str());
+  }
+  return ok;
+}
+
+bool FileSystemStorage::commit_temp(const fs::path& temp_path,
+                                    const fs::path& path) {
+  if (::rename(temp_path.c_str(), path.c_str()) != 0) {
+    LOG(ERROR) << "Failed to rename " << temp_path << " to " << path;
+    ::unlink(temp_path.c_str());
+    return false;
+  }
+
+  if (manifest_) {
+    manifest_->add_dir(
+        path.parent_path().lexically_relative(base_dir_).generic_string());
+    manifest_->add(path_to_key(path));
+  }
+  return true;
+}
+
+bool FileSystemStorage::save_json(const std::string& key, const json& data) {
+  fs::path path = key_to_path(key);
+  fs::path temp_path;
+
+  if (!write_temp(path, data, temp_path) || !commit_temp(temp_path, path)) {
+    return false;
+  }
+
+  LOG(INFO) << "Saved JSON to: " << path;
+  return true;
+}
+
+bool FileSystemStorage::save_string(const std::string& key,
+                                    const std::string& content) {
+  if (encoding_ != Encoding::kJson) {
+    return Storage::save_string(key, content);
+  }
+
+  fs::path path = key_to_path(key);
+  fs::path temp_path;
+
+  if (!write_temp_bytes(path, content, temp_path) ||
+      !commit_temp(temp_path, path)) {
+    return false;
+  }
 
   LOG(INFO) << "Saved JSON to: " << path;
   return true;
 }
 
+bool FileSystemStorage::save_many(
+    const std::vector<std::pair<std::string, json>>& items) {
+  struct Written {
+    fs::path temp_path;
+    fs::path path;
+    int fd;
+  };
+
+  bool ok            = true;
+  size_t saved_count = 0;
+  std::set<fs::path> directories;
+  std::vector<Written> group;
+  group.reserve(std::min(items.size(), kFilesPerSyncGroup));
+
+  // Each temp file is synced before it is renamed into place, and each
+  // touched directory once at the end. Writeback of a whole group is
+  // started before the first sync waits, so the group's I/O overlaps.
+  for (size_t begin = 0; begin < items.size(); begin += kFilesPerSyncGroup) {
+    size_t end = std::min(items.size(), begin + kFilesPerSyncGroup);
+    group.clear();
+    for (size_t i = begin; i < end; ++i) {
+      Written file{{}, key_to_path(items[i].first), -1};
+      if (write_temp(file.path, items[i].second, file.temp_path, &file.fd)) {
+        StartWriteback(file.fd);
+        group.push_back(std::move(file));
+      } else {
+        ok = false;
+      }
+    }
+
+    for (auto& file : group) {
+      bool synced = ::fdatasync(file.fd) == 0;
+      synced      = ::close(file.fd) == 0 && synced;
+      if (!synced) {
+        LOG(ERROR) << "Failed to sync file: " << file.temp_path;
+        ::unlink(file.temp_path.c_str());
+        ok = false;
+      } else if (commit_temp(file.temp_path, file.path)) {
+        directories.insert(file.path.parent_path());
+        saved_count++;
+      } else {
+        ok = false;
+      }
+    }
+  }
+
+  for (const auto& dir : directories) {
+    if (!SyncDirectory(dir)) {
+      LOG(ERROR) << "Failed to sync directory: " << dir;
+      ok = false;
+    }
+  }
+
+  LOG(INFO) << "Saved " << saved_count << " JSON files in one batch";
+  return ok;
+}
+
 bool FileSystemStorage::load_json(const std::string& key, json& data) {
+  RecordView view;
+  if (!load_view(key, view)) {
+    return false;
+  }
+
+  if (!DecodeDocument(view.data(), data)) {
+    LOG(ERROR) << "Failed to parse JSON from " << key_to_path(key);
+    return false;
+  }
+  return true;
+}
+
+bool FileSystemStorage::load_view(const std::string& key, RecordView& out) {
   fs::path path = key_to_path(key);
 
   if (!fs::exists(path)) {
@@ -91,19 +471,33 @@ bool FileSystemStorage::load_json(const std::string& key, json& data) {
     return false;
   }
 
-  std::ifstream file(path);
-  if (!file.is_open()) {
+  auto mapped = MappedFile::Open(path.string());
+  if (!mapped) {
     LOG(ERROR) << "Failed to open file for reading: " << path;
     return false;
   }
 
-  try {
-    file >> data;
-    return true;
-  } catch (const std::exception& e) {
-    LOG(ERROR) << "Failed to parse JSON from " << path << ": " << e.what();
+  std::string_view data = mapped->view();
+  out                   = RecordView(std::move(mapped), data);
+  return true;
+}
+
+bool FileSystemStorage::load_string(const std::string& key, std::string& out) {
+  RecordView view;
+  if (!load_view(key, view)) {
     return false;
   }
+  if (DetectEncoding(view.data()) != Encoding::kJson) {
+    json doc;
+    if (!DecodeDocument(view.data(), doc)) {
+      LOG(ERROR) << "Failed to decode binary document: " << key_to_path(key);
+      return false;
+    }
+    out = doc.dump();
+    return true;
+  }
+  out.assign(view.data());
+  return true;
 }
 
 bool FileSystemStorage::exists(const std::string& key) {
@@ -121,6 +515,9 @@ bool FileSystemStorage::remove(const std::string& key) {
 
   try {
     fs::remove(path);
+    if (manifest_) {
+      manifest_->remove(path_to_key(path));
+    }
     LOG(INFO) << "Removed file: " << path;
     return true;
   } catch (const std::exception& e) {
@@ -131,29 +528,195 @@ bool FileSystemStorage::remove(const std::string& key) {
 
 std::vector<std::string>
 FileSystemStorage::list_keys(const std::string& prefix) {
+  if (manifest_) {
+    return manifest_->list(prefix);
+  }
+  return scan_keys(prefix);
+}
+
+bool FileSystemStorage::rebuild_manifest(size_t* key_count) {
+  std::vector<std::string> keys;
+  std::vector<std::string> dirs;
+  scan(
+      "",
+      [&keys](const std::string& key) {
+        keys.push_back(key);
+        return true;
+      },
+      &dirs);
+
+  auto manifest = std::make_unique<KeyManifest>(base_dir_);
+  if (!manifest->rebuild(keys, dirs)) {
+    return false;
+  }
+  manifest_ = std::move(manifest);
+
+  if (key_count) {
+    *key_count = keys.size();
+  }
+  LOG(INFO) << "Rebuilt key manifest with " << keys.size() << " keys";
+  return true;
+}
+
+bool FileSystemStorage::verify_manifest(std::vector<std::string>* missing,
+                                        std::vector<std::string>* stale) {
+  if (!manifest_) {
+    LOG(ERROR) << "No key manifest in: " << base_dir_;
+    return false;
+  }
+
+  auto on_disk = scan_keys("");
+  auto indexed = manifest_->list("");
+  std::sort(on_disk.begin(), on_disk.end());
+
+  std::vector<std::string> not_indexed;
+  std::vector<std::string> not_on_disk;
+  std::set_difference(on_disk.begin(),
+                      on_disk.end(),
+                      indexed.begin(),
+                      indexed.end(),
+                      std::back_inserter(not_indexed));
+  std::set_difference(indexed.begin(),
+                      indexed.end(),
+                      on_disk.begin(),
+                      on_disk.end(),
+                      std::back_inserter(not_on_disk));
+
+  bool consistent = not_indexed.empty() && not_on_disk.empty();
+  if (missing) {
+    *missing = std::move(not_indexed);
+  }
+  if (stale) {
+    *stale = std::move(not_on_disk);
+  }
+  return consistent;
+}
+
+std::vector<std::string>
+FileSystemStorage::scan_keys(const std::string& prefix) const {
   std::vector<std::string> keys;
-  fs::path prefix_path = key_to_path(prefix);
+  scan(prefix, [&keys](const std::string& key) {
+    keys.push_back(key);
+    return true;
+  });
+  return keys;
+}
 
-  if (!fs::exists(prefix_path.parent_path())) {
-    return keys;
+void FileSystemStorage::scan(const std::string& prefix,
+                             const KeyVisitor& visit,
+                             std::vector<std::string>* dirs) const {
+  fs::path search_dir =
+      prefix.empty() ? base_dir_ : key_to_path(prefix, 0).parent_path();
+
+  if (!fs::exists(search_dir)) {
+    return;
   }
 
   try {
-    for (const auto& entry :
-         fs::recursive_directory_iterator(prefix_path.parent_path())) {
-      if (entry.is_regular_file() && entry.path().extension() == ".json") {
-        std::string key = path_to_key(entry.path());
-        if (key.find(prefix) == 0) {
-          keys.push_back(key);
-        }
+    std::string key;
+    for (const auto& entry : fs::recursive_directory_iterator(search_dir)) {
+      if (dirs && entry.is_directory()) {
+        dirs->push_back(
+            entry.path().lexically_relative(base_dir_).generic_string());
+        continue;
+      }
+      if (entry.is_regular_file() && entry.path().extension() == ".json" &&
+          locate_key(entry.path(), shard_levels_, key) &&
+          key.find(prefix) == 0 && !visit(key)) {
+        return;
       }
     }
   } catch (const std::exception& e) {
     LOG(ERROR) << "Failed to list keys with prefix " << prefix << ": "
                << e.what();
   }
+}
 
-  return keys;
+void FileSystemStorage::for_each_key(const std::string& prefix,
+                                     const KeyVisitor& visit) {
+  if (manifest_) {
+    Storage::for_each_key(prefix, visit);
+    return;
+  }
+  scan(prefix, visit);
+}
+
+void FileSystemStorage::for_each_record(const std::string& prefix,
+                                        const RecordVisitor& visit,
+                                        size_t read_ahead) {
+  if (read_ahead == 0) {
+    Storage::for_each_record(prefix, visit, read_ahead);
+    return;
+  }
+
+  // Keys are handed to the reader in batches so the walk never has to hold
+  // the whole key list.
+  std::vector<std::string> batch;
+  bool keep_going = true;
+  for_each_key(prefix, [&](const std::string& key) {
+    batch.push_back(key);
+    if (batch.size() < kKeysPerReadBatch) {
+      return true;
+    }
+    keep_going = stream_records(batch, visit, read_ahead);
+    batch.clear();
+    return keep_going;
+  });
+
+  if (keep_going && !batch.empty()) {
+    stream_records(batch, visit, read_ahead);
+  }
+}
+
+bool FileSystemStorage::stream_records(const std::vector<std::string>& keys,
+                                       const RecordVisitor& visit,
+                                       size_t read_ahead) {
+  if (read_ahead == 0) {
+    return Storage::stream_records(keys, visit, read_ahead);
+  }
+
+  std::vector<std::string> paths;
+  paths.reserve(keys.size());
+  for (const auto& key : keys) {
+    paths.push_back(key_to_path(key).string());
+  }
+
+  PrefetchReader reader(read_ahead);
+  return reader.read(
+      paths, [&](size_t index, bool ok, const RecordView& view) {
+        return !ok || visit(keys[index], view);
+      });
+}
+
+bool FileSystemStorage::load_many(const std::vector<std::string>& keys,
+                                  std::vector<json>& out) {
+  out.assign(keys.size(), json());
+
+  size_t workers = std::min<size_t>(std::thread::hardware_concurrency(),
+                                    keys.size() / kKeysPerLoadWorker);
+  if (workers <= 1) {
+    return Storage::load_many(keys, out);
+  }
+
+  std::atomic<size_t> next{0};
+  std::atomic<bool> ok{true};
+  auto worker = [&] {
+    for (size_t i = next++; i < keys.size(); i = next++) {
+      if (!load_json(keys[i], out[i])) {
+        ok = false;
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < workers; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  return ok;
 }
 
 void FileSystemStorage::print_json(const std::string& key, int indent) {
@@ -0,0 +1,230 @@
+#include "storage/key_manifest.h"
+#include <fstream>
+#include <glog/logging.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+namespace tziakcha {
+namespace storage {
+
+namespace {
+
+constexpr size_t kCompactSlack = 1024;
+// First line of snapshots that track directories.
+constexpr char kFormatLine[] = "#2";
+
+} // namespace
+
+KeyManifest::KeyManifest(const fs::path& base_dir)
+    : path_(base_dir / kFileName) {}
+
+bool KeyManifest::Exists(const fs::path& base_dir) {
+  return fs::exists(base_dir / kFileName);
+}
+
+bool KeyManifest::load() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  std::ifstream file(path_);
+  if (!file.is_open()) {
+    LOG(ERROR) << "Failed to open key manifest: " << path_;
+    return false;
+  }
+
+  keys_.clear();
+  dirs_.clear();
+  journal_lines_ = 0;
+  tracks_dirs_   = false;
+
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line == kFormatLine) {
+      tracks_dirs_ = true;
+      continue;
+    }
+    if (line.size() < 2) {
+      continue;
+    }
+    if (line[0] == '+') {
+      keys_.insert(line.substr(1));
+    } else if (line[0] == '-') {
+      keys_.erase(line.substr(1));
+    } else if (line[0] == '/') {
+      dirs_.insert(line.substr(1));
+    } else {
+      continue;
+    }
+    journal_lines_++;
+  }
+
+  // Rewriting would stamp the manifest current, so only a manifest that
+  // is still valid gets compacted.
+  if (journal_lines_ > 2 * (keys_.size() + dirs_.size()) + kCompactSlack &&
+      is_current_locked()) {
+    write_snapshot();
+  }
+
+  LOG(INFO) << "Loaded key manifest with " << keys_.size() << " keys";
+  return true;
+}
+
+bool KeyManifest::rebuild(const std::vector<std::string>& keys,
+                          const std::vector<std::string>& dirs) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  keys_        = std::set<std::string>(keys.begin(), keys.end());
+  dirs_        = std::set<std::string>(dirs.begin(), dirs.end());
+  tracks_dirs_ = true;
+  return write_snapshot();
+}
+
+bool KeyManifest::add(const std::string& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!keys_.insert(key).second) {
+    // Overwriting renamed a file into the key's directory; keep the
+    // manifest at least as new as that directory.
+    touch();
+    return true;
+  }
+  return append_line('+', key);
+}
+
+bool KeyManifest::add_dir(const std::string& dir) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (dir.empty() || dir == "." || dirs_.count(dir)) {
+    return true;
+  }
+
+  bool ok    = true;
+  size_t pos = dir.find('/');
+  while (ok && pos != std::string::npos) {
+    std::string parent = dir.substr(0, pos);
+    if (dirs_.insert(parent).second) {
+      ok = append_line('/', parent);
+    }
+    pos = dir.find('/', pos + 1);
+  }
+  dirs_.insert(dir);
+  return ok && append_line('/', dir);
+}
+
+bool KeyManifest::is_current() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return is_current_locked();
+}
+
+bool KeyManifest::is_current_locked() const {
+  if (!tracks_dirs_) {
+    return false;
+  }
+
+  std::error_code ec;
+  auto written = fs::last_write_time(path_, ec);
+  if (ec) {
+    return false;
+  }
+
+  fs::path base_dir = path_.parent_path();
+  auto newer        = [&](const fs::path& dir) {
+    auto modified = fs::last_write_time(dir, ec);
+    return ec || modified > written;
+  };
+  if (newer(base_dir)) {
+    return false;
+  }
+  for (const auto& dir : dirs_) {
+    if (newer(base_dir / dir)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool KeyManifest::remove(const std::string& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (keys_.erase(key) == 0) {
+    return true;
+  }
+  return append_line('-', key);
+}
+
+std::vector<std::string> KeyManifest::list(const std::string& prefix) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  std::vector<std::string> keys;
+  for (auto it = keys_.lower_bound(prefix); it != keys_.end(); ++it) {
+    if (it->compare(0, prefix.size(), prefix) != 0) {
+      break;
+    }
+    keys.push_back(*it);
+  }
+  return keys;
+}
+
+size_t KeyManifest::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return keys_.size();
+}
+
+bool KeyManifest::append_line(char op, const std::string& key) {
+  if (key.find('\n') != std::string::npos) {
+    LOG(ERROR) << "Key cannot be stored in manifest: " << key;
+    return false;
+  }
+
+  std::ofstream file(path_, std::ios::app);
+  if (!file.is_open()) {
+    LOG(ERROR) << "Failed to open key manifest for append: " << path_;
+    return false;
+  }
+
+  file << op << key << '\n';
+  journal_lines_++;
+  return file.good();
+}
+
+bool KeyManifest::write_snapshot() {
+  fs::path tmp_path = path_;
+  tmp_path += ".tmp";
+
+  {
+    std::ofstream file(tmp_path, std::ios::trunc);
+    if (!file.is_open()) {
+      LOG(ERROR) << "Failed to write key manifest: " << tmp_path;
+      return false;
+    }
+    file << kFormatLine << '\n';
+    for (const auto& dir : dirs_) {
+      file << '/' << dir << '\n';
+    }
+    for (const auto& key : keys_) {
+      file << '+' << key << '\n';
+    }
+    if (!file.good()) {
+      LOG(ERROR) << "Failed to write key manifest: " << tmp_path;
+      return false;
+    }
+  }
+
+  std::error_code ec;
+  fs::rename(tmp_path, path_, ec);
+  if (ec) {
+    LOG(ERROR) << "Failed to replace key manifest " << path_ << ": "
+               << ec.message();
+    return false;
+  }
+
+  // The rename changed base_dir after the snapshot's contents were
+  // written.
+  touch();
+  journal_lines_ = keys_.size() + dirs_.size();
+  return true;
+}
+
+void KeyManifest::touch() const {
+  if (::utimensat(AT_FDCWD, path_.c_str(), nullptr, 0) != 0) {
+    LOG(WARNING) << "Failed to update key manifest time: " << path_;
+  }
+}
+
+} // namespace storage
+} // namespace tziakcha
@@ -0,0 +1,53 @@
+#include "storage/mapped_file.h"
+#include <cerrno>
+#include <cstring>
+#include <glog/logging.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace tziakcha {
+namespace storage {
+
+std::shared_ptr<MappedFile> MappedFile::Open(const std::string& path) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    LOG(WARNING) << "Failed to open file for mapping: " << path << ": "
+                 << std::strerror(errno);
+    return nullptr;
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    LOG(ERROR) << "Failed to stat file: " << path << ": "
+               << std::strerror(errno);
+    ::close(fd);
+    return nullptr;
+  }
+
+  size_t size = static_cast<size_t>(st.st_size);
+  void* data  = nullptr;
+  if (size > 0) {
+    data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      LOG(ERROR) << "Failed to mmap file: " << path << ": "
+                 << std::strerror(errno);
+      ::close(fd);
+      return nullptr;
+    }
+    ::madvise(data, size, MADV_SEQUENTIAL);
+  }
+  ::close(fd);
+
+  return std::shared_ptr<MappedFile>(new MappedFile(data, size));
+}
+
+MappedFile::~MappedFile() {
+  if (data_ && size_ > 0) {
+    ::munmap(data_, size_);
+  }
+}
+
+} // namespace storage
+} // namespace tziakcha
@@ -0,0 +1,661 @@
+#include "storage/packed_storage.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <glog/logging.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+namespace tziakcha {
+namespace storage {
+
+namespace {
+
+constexpr char kMetaFile[]        = "archive.meta";
+constexpr char kSegmentPrefix[]   = "segment-";
+constexpr char kSegmentExt[]      = ".pack";
+constexpr uint32_t kEntryMagic    = 0x4B505A54; // "TZPK"
+constexpr size_t kEntryHeaderSize = 13;
+constexpr uint8_t kEntryPut       = 0;
+constexpr uint8_t kEntryTombstone = 1;
+
+void PutU32(char* dst, uint32_t v) {
+  for (int i = 0; i < 4; ++i) {
+    dst[i] = static_cast<char>((v >> (8 * i)) & 0xFF);
+  }
+}
+
+uint32_t GetU32(const char* src) {
+  uint32_t v = 0;
+  for (int i = 0; i < 4; ++i) {
+    v |= static_cast<uint32_t>(static_cast<uint8_t>(src[i])) << (8 * i);
+  }
+  return v;
+}
+
+bool PreadAll(int fd, char* buf, size_t len, uint64_t offset) {
+  while (len > 0) {
+    ssize_t n = ::pread(fd, buf, len, static_cast<off_t>(offset));
+    if (n <= 0) {
+      return false;
+    }
+    buf += n;
+    len -= static_cast<size_t>(n);
+    offset += static_cast<uint64_t>(n);
+  }
+  return true;
+}
+
+bool WriteAll(int fd, const char* buf, size_t len) {
+  while (len > 0) {
+    ssize_t n = ::write(fd, buf, len);
+    if (n <= 0) {
+      return false;
+    }
+    buf += n;
+    len -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+bool SyncDirectory(const fs::path& dir) {
+  int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = ::fsync(fd) == 0;
+  ::close(fd);
+  return ok;
+}
+
+bool ParseSegmentId(const fs::path& path, uint32_t& id) {
+  std::string name = path.filename().string();
+  size_t prefix    = std::strlen(kSegmentPrefix);
+  size_t ext       = std::strlen(kSegmentExt);
+  if (name.size() <= prefix + ext || name.compare(0, prefix, kSegmentPrefix) ||
+      name.compare(name.size() - ext, ext, kSegmentExt)) {
+    return false;
+  }
+  std::string digits = name.substr(prefix, name.size() - prefix - ext);
+  for (char c : digits) {
+    if (c < '0' || c > '9') {
+      return false;
+    }
+  }
+  id = static_cast<uint32_t>(std::stoul(digits));
+  return true;
+}
+
+} // namespace
+
+struct PackedStorage::SegmentFile {
+  explicit SegmentFile(int fd) : fd(fd) {}
+  ~SegmentFile() { ::close(fd); }
+
+  SegmentFile(const SegmentFile&)            = delete;
+  SegmentFile& operator=(const SegmentFile&) = delete;
+
+  const int fd;
+};
+
+PackedStorage::PackedStorage(const std::string& base_dir,
+                             uint64_t segment_bytes,
+                             Encoding encoding,
+                             OpenMode mode)
+    : base_dir_(base_dir), segment_bytes_(segment_bytes), encoding_(encoding) {
+  std::error_code ec;
+  if (mode == OpenMode::kReadWrite) {
+    fs::create_directories(base_dir_, ec);
+    if (ec) {
+      LOG(ERROR) << "Failed to create base directory " << base_dir << ": "
+                 << ec.message();
+    }
+
+    fs::path meta = base_dir_ / kMetaFile;
+    if (!fs::exists(meta, ec)) {
+      std::ofstream file(meta);
+      json info;
+      info["format"]        = "tziakcha-packed";
+      info["version"]       = 1;
+      info["segment_bytes"] = segment_bytes_;
+      file << info.dump(2);
+    }
+
+    if (!lock_archive()) {
+      mode = OpenMode::kReadOnly;
+    }
+  }
+
+  if (!open_archive(mode)) {
+    LOG(ERROR) << "Failed to open packed archive: " << base_dir_;
+  }
+}
+
+PackedStorage::~PackedStorage() {
+  if (lock_fd_ >= 0) {
+    ::close(lock_fd_);
+  }
+}
+
+bool PackedStorage::IsArchive(const std::string& base_dir) {
+  return fs::exists(fs::path(base_dir) / kMetaFile);
+}
+
+fs::path PackedStorage::segment_path(uint32_t id) const {
+  char name[32];
+  std::snprintf(
+      name, sizeof(name), "%s%06u%s", kSegmentPrefix, id, kSegmentExt);
+  return base_dir_ / name;
+}
+
+// The lock lives on the meta file and is held until destruction; a second
+// writer is refused rather than left waiting.
+bool PackedStorage::lock_archive() {
+  fs::path meta = base_dir_ / kMetaFile;
+  lock_fd_      = ::open(meta.c_str(), O_RDONLY | O_CLOEXEC);
+  if (lock_fd_ < 0) {
+    LOG(ERROR) << "Failed to open " << meta << ": " << std::strerror(errno);
+    return false;
+  }
+  if (::flock(lock_fd_, LOCK_EX | LOCK_NB) != 0) {
+    LOG(ERROR) << "Packed archive " << base_dir_
+               << " is locked by another writer; opening it read-only";
+    ::close(lock_fd_);
+    lock_fd_ = -1;
+    return false;
+  }
+  return true;
+}
+
+bool PackedStorage::open_archive(OpenMode mode) {
+  std::vector<uint32_t> ids;
+  std::error_code ec;
+  for (fs::directory_iterator it(base_dir_, ec), end; !ec && it != end;
+       it.increment(ec)) {
+    uint32_t id = 0;
+    if (it->is_regular_file(ec) && ParseSegmentId(it->path(), id)) {
+      ids.push_back(id);
+    }
+  }
+  if (ec) {
+    LOG(ERROR) << "Failed to list segments of " << base_dir_ << ": "
+               << ec.message();
+    return false;
+  }
+  std::sort(ids.begin(), ids.end());
+
+  for (uint32_t id : ids) {
+    int fd = ::open(segment_path(id).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      LOG(ERROR) << "Failed to open segment: " << segment_path(id);
+      return false;
+    }
+    Segment& segment = segments_[id];
+    segment.file     = std::make_shared<SegmentFile>(fd);
+    if (!scan_segment(id, segment, id == ids.back(), mode)) {
+      return false;
+    }
+  }
+
+  uint32_t active = ids.empty() ? 0 : ids.back();
+  if (mode == OpenMode::kReadOnly) {
+    active_segment_ = active;
+  } else if (!open_segment_for_append(active)) {
+    return false;
+  } else {
+    writable_ = true;
+  }
+
+  LOG(INFO) << "Opened packed archive " << base_dir_ << " with "
+            << index_.size() << " records in " << segments_.size()
+            << " segments";
+  return true;
+}
+
+// Only the writer repairs the tail of the last segment. Anywhere else an
+// incomplete entry is either a writer's append in progress or corruption,
+// and neither is cut off.
+bool PackedStorage::scan_segment(uint32_t id,
+                                 Segment& segment,
+                                 bool last,
+                                 OpenMode mode) {
+  bool repair_tail = last && mode == OpenMode::kReadWrite;
+  std::error_code ec;
+  uint64_t file_size = fs::file_size(segment_path(id), ec);
+  if (ec) {
+    LOG(ERROR) << "Failed to stat segment " << segment_path(id) << ": "
+               << ec.message();
+    return false;
+  }
+  uint64_t offset = 0;
+  char header[kEntryHeaderSize];
+
+  while (offset + kEntryHeaderSize <= file_size) {
+    if (!PreadAll(segment.file->fd, header, kEntryHeaderSize, offset) ||
+        GetU32(header) != kEntryMagic) {
+      break;
+    }
+    uint8_t kind       = static_cast<uint8_t>(header[4]);
+    uint32_t key_len   = GetU32(header + 5);
+    uint32_t value_len = GetU32(header + 9);
+    uint64_t end       = offset + kEntryHeaderSize + key_len + value_len;
+    if (end > file_size) {
+      break;
+    }
+
+    std::string key(key_len, '\0');
+    if (!PreadAll(segment.file->fd,
+                  key.data(),
+                  key_len,
+                  offset + kEntryHeaderSize)) {
+      break;
+    }
+
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      dead_bytes_ += kEntryHeaderSize + key.size() + it->second.length;
+    }
+    if (kind == kEntryPut) {
+      index_[key] =
+          Location{id, offset + kEntryHeaderSize + key_len, value_len};
+    } else {
+      dead_bytes_ += end - offset;
+      if (it != index_.end()) {
+        index_.erase(it);
+      }
+    }
+    offset = end;
+  }
+
+  if (offset != file_size && repair_tail) {
+    LOG(WARNING) << "Truncating torn tail of " << segment_path(id) << " at "
+                 << offset << " (file size " << file_size << ")";
+    fs::resize_file(segment_path(id), offset, ec);
+    if (ec) {
+      LOG(ERROR) << "Failed to truncate " << segment_path(id) << ": "
+                 << ec.message();
+      return false;
+    }
+  } else if (offset != file_size && !last) {
+    LOG(ERROR) << "Corrupt entry in " << segment_path(id) << " at " << offset
+               << "; the " << file_size - offset
+               << " bytes after it are not indexed";
+  }
+  segment.size = offset;
+  return true;
+}
+
+bool PackedStorage::open_segment_for_append(uint32_t id) {
+  int fd = ::open(segment_path(id).c_str(),
+                  O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC,
+                  0644);
+  if (fd < 0) {
+    LOG(ERROR) << "Failed to open segment for append: " << segment_path(id);
+    return false;
+  }
+
+  segments_[id].file = std::make_shared<SegmentFile>(fd);
+  active_segment_     = id;
+  return true;
+}
+
+bool PackedStorage::append_entry(uint8_t kind,
+                                 const std::string& key,
+                                 const std::string& value,
+                                 Location* location) {
+  if (!writable_) {
+    LOG(ERROR) << "Packed archive is not open for writing: " << base_dir_;
+    return false;
+  }
+
+  uint64_t entry_size = kEntryHeaderSize + key.size() + value.size();
+  if (segments_[active_segment_].size > 0 &&
+      segments_[active_segment_].size + entry_size > segment_bytes_) {
+    if (!open_segment_for_append(active_segment_ + 1)) {
+      return false;
+    }
+  }
+
+  std::string buf(kEntryHeaderSize, '\0');
+  PutU32(buf.data(), kEntryMagic);
+  buf[4] = static_cast<char>(kind);
+  PutU32(buf.data() + 5, static_cast<uint32_t>(key.size()));
+  PutU32(buf.data() + 9, static_cast<uint32_t>(value.size()));
+  buf.reserve(entry_size);
+  buf += key;
+  buf += value;
+
+  Segment& segment = segments_[active_segment_];
+  if (!WriteAll(segment.file->fd, buf.data(), buf.size())) {
+    LOG(ERROR) << "Failed to append to " << segment_path(active_segment_)
+               << ": " << std::strerror(errno);
+    std::error_code ec;
+    fs::resize_file(segment_path(active_segment_), segment.size, ec);
+    return false;
+  }
+
+  if (location) {
+    *location = Location{active_segment_,
+                         segment.size + kEntryHeaderSize + key.size(),
+                         static_cast<uint32_t>(value.size())};
+  }
+  segment.size += entry_size;
+  return true;
+}
+
+bool PackedStorage::read_value(const Location& location,
+                               std::string& out) const {
+  auto it = segments_.find(location.segment);
+  if (it == segments_.end()) {
+    return false;
+  }
+  out.resize(location.length);
+  return PreadAll(
+      it->second.file->fd, out.data(), location.length, location.offset);
+}
+
+bool PackedStorage::save_json(const std::string& key, const json& data) {
+  return put_value(key, EncodeDocument(data, encoding_));
+}
+
+bool PackedStorage::save_string(const std::string& key,
+                                const std::string& content) {
+  if (encoding_ != Encoding::kJson) {
+    return Storage::save_string(key, content);
+  }
+  return put_value(key, content);
+}
+
+bool PackedStorage::put_value(const std::string& key,
+                              const std::string& value) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Location location;
+  if (!append_entry(kEntryPut, key, value, &location)) {
+    LOG(ERROR) << "Failed to append record: " << key;
+    return false;
+  }
+  put_location(key, location);
+
+  LOG(INFO) << "Saved JSON to archive: " << key;
+  return true;
+}
+
+bool PackedStorage::save_many(
+    const std::vector<std::pair<std::string, json>>& items) {
+  std::vector<std::string> values;
+  values.reserve(items.size());
+  for (const auto& item : items) {
+    values.push_back(EncodeDocument(item.second, encoding_));
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  bool ok = true;
+  std::set<uint32_t> touched;
+  for (size_t i = 0; i < items.size(); ++i) {
+    Location location;
+    if (!append_entry(kEntryPut, items[i].first, values[i], &location)) {
+      LOG(ERROR) << "Failed to append record: " << items[i].first;
+      ok = false;
+      continue;
+    }
+    put_location(items[i].first, location);
+    touched.insert(location.segment);
+  }
+
+  for (uint32_t id : touched) {
+    auto it = segments_.find(id);
+    if (it != segments_.end() && ::fdatasync(it->second.file->fd) != 0) {
+      LOG(ERROR) << "Failed to sync segment: " << segment_path(id);
+      ok = false;
+    }
+  }
+
+  LOG(INFO) << "Saved " << items.size() << " records to archive in one batch";
+  return ok;
+}
+
+void PackedStorage::put_location(const std::string& key,
+                                 const Location& location) {
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    dead_bytes_ += kEntryHeaderSize + key.size() + it->second.length;
+    it->second = location;
+  } else {
+    index_.emplace(key, location);
+  }
+}
+
+bool PackedStorage::load_string(const std::string& key, std::string& out) {
+  // Only the lookup holds mutex_; the descriptor reference keeps the
+  // segment readable even if compaction drops it meanwhile.
+  Location location;
+  std::shared_ptr<SegmentFile> file;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+      LOG(WARNING) << "Key does not exist in archive: " << key;
+      return false;
+    }
+    location = it->second;
+    file     = segments_.at(location.segment).file;
+  }
+
+  out.resize(location.length);
+  if (!PreadAll(file->fd, out.data(), location.length, location.offset)) {
+    LOG(ERROR) << "Failed to read record from archive: " << key;
+    return false;
+  }
+  if (DetectEncoding(out) != Encoding::kJson) {
+    json doc;
+    if (!DecodeDocument(out, doc)) {
+      return false;
+    }
+    out = doc.dump();
+  }
+  return true;
+}
+
+bool PackedStorage::map_value(const std::string& key, RecordView& out) {
+  // Segments are remapped outside mutex_. If compaction moved the record
+  // meanwhile, its old segment is gone and the second lookup finds the copy.
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    Location location;
+    std::shared_ptr<MappedFile> mapping;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = index_.find(key);
+      if (it == index_.end()) {
+        LOG(WARNING) << "Key does not exist in archive: " << key;
+        return false;
+      }
+      location   = it->second;
+      auto found = mappings_.find(location.segment);
+      if (found != mappings_.end()) {
+        mapping = found->second;
+      }
+    }
+
+    uint64_t end = location.offset + location.length;
+    if (!mapping || mapping->size() < end) {
+      mapping = MappedFile::Open(segment_path(location.segment).string());
+      if (!mapping || mapping->size() < end) {
+        continue;
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (segments_.count(location.segment)) {
+        auto& cached = mappings_[location.segment];
+        if (!cached || cached->size() < mapping->size()) {
+          cached = mapping;
+        }
+      }
+    }
+
+    out = RecordView(mapping,
+                     mapping->view().substr(location.offset, location.length));
+    return true;
+  }
+
+  LOG(ERROR) << "Failed to map record from archive: " << key;
+  return false;
+}
+
+bool PackedStorage::load_view(const std::string& key, RecordView& out) {
+  return map_value(key, out);
+}
+
+bool PackedStorage::load_json(const std::string& key, json& data) {
+  RecordView raw;
+  if (!map_value(key, raw)) {
+    return false;
+  }
+
+  if (!DecodeDocument(raw.data(), data)) {
+    LOG(ERROR) << "Failed to parse JSON for key " << key;
+    return false;
+  }
+  return true;
+}
+
+bool PackedStorage::exists(const std::string& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return index_.count(key) > 0;
+}
+
+bool PackedStorage::remove(const std::string& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(key);
+  if (it == index_.end()) {
+    LOG(WARNING) << "Key does not exist in archive: " << key;
+    return false;
+  }
+
+  if (!append_entry(kEntryTombstone, key, "", nullptr)) {
+    LOG(ERROR) << "Failed to append tombstone for key: " << key;
+    return false;
+  }
+
+  dead_bytes_ += 2 * kEntryHeaderSize + 2 * key.size() + it->second.length;
+  index_.erase(it);
+  LOG(INFO) << "Removed key from archive: " << key;
+  return true;
+}
+
+std::vector<std::string> PackedStorage::list_keys(const std::string& prefix) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<std::string> keys;
+  for (auto it = index_.lower_bound(prefix);
+       it != index_.end() && it->first.compare(0, prefix.size(), prefix) == 0;
+       ++it) {
+    keys.push_back(it->first);
+  }
+  return keys;
+}
+
+void PackedStorage::print_json(const std::string& key, int indent) {
+  json data;
+  if (load_json(key, data)) {
+    std::cout << data.dump(indent) << std::endl;
+  } else {
+    LOG(ERROR) << "Failed to load JSON for key: " << key;
+  }
+}
+
+bool PackedStorage::compact(CompactionStats* stats) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!writable_) {
+    LOG(ERROR) << "Packed archive is not open for writing: " << base_dir_;
+    return false;
+  }
+
+  CompactionStats local;
+  local.live_records    = index_.size();
+  local.segments_before = segments_.size();
+  for (const auto& [id, segment] : segments_) {
+    local.bytes_before += segment.size;
+  }
+
+  std::vector<uint32_t> old_ids;
+  for (const auto& [id, segment] : segments_) {
+    old_ids.push_back(id);
+  }
+
+  uint32_t first_new = active_segment_ + 1;
+  if (!open_segment_for_append(first_new)) {
+    return false;
+  }
+
+  std::map<std::string, Location> new_index;
+  std::string value;
+  for (const auto& [key, location] : index_) {
+    Location moved;
+    if (!read_value(location, value) ||
+        !append_entry(kEntryPut, key, value, &moved)) {
+      LOG(ERROR) << "Compaction failed while copying key: " << key;
+      return false;
+    }
+    new_index.emplace(key, moved);
+  }
+
+  // The copies must be durable before the old segments, until now the only
+  // durable copy, are unlinked.
+  for (auto it = segments_.lower_bound(first_new); it != segments_.end();
+       ++it) {
+    if (::fdatasync(it->second.file->fd) != 0) {
+      LOG(ERROR) << "Failed to sync compacted segment: "
+                 << segment_path(it->first);
+      return false;
+    }
+  }
+  if (!SyncDirectory(base_dir_)) {
+    LOG(ERROR) << "Failed to sync archive directory: " << base_dir_;
+    return false;
+  }
+
+  for (uint32_t id : old_ids) {
+    segments_.erase(id);
+    mappings_.erase(id);
+    std::error_code ec;
+    fs::remove(segment_path(id), ec);
+    if (ec) {
+      LOG(WARNING) << "Failed to remove old segment " << segment_path(id)
+                   << ": " << ec.message();
+    }
+  }
+
+  index_      = std::move(new_index);
+  dead_bytes_ = 0;
+
+  local.segments_after = segments_.size();
+  for (const auto& [id, segment] : segments_) {
+    local.bytes_after += segment.size;
+  }
+
+  LOG(INFO) << "Compacted archive " << base_dir_ << ": "
+            << local.bytes_before << " -> " << local.bytes_after << " bytes, "
+            << local.segments_before << " -> " << local.segments_after
+            << " segments";
+
+  if (stats) {
+    *stats = local;
+  }
+  return true;
+}
+
+size_t PackedStorage::record_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return index_.size();
+}
+
+uint64_t PackedStorage::dead_bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return dead_bytes_;
+}
+
+} // namespace storage
+} // namespace tziakcha
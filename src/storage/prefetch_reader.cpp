@@ -0,0 +1,520 @@
+#include "storage/prefetch_reader.h"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <glog/logging.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define TZIAKCHA_HAVE_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace tziakcha {
+namespace storage {
+
+namespace {
+
+// Reads never ask for more than this in one request; the rest of a larger
+// file is read by follow-up requests.
+constexpr size_t kMaxReadChunk = 1u << 30;
+
+bool OpenForRead(const std::string& path, int& fd, size_t& size) {
+  fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    LOG(WARNING) << "Failed to open file for reading: " << path << ": "
+                 << std::strerror(errno);
+    return false;
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    LOG(ERROR) << "Failed to stat file: " << path << ": "
+               << std::strerror(errno);
+    ::close(fd);
+    fd = -1;
+    return false;
+  }
+  size = static_cast<size_t>(st.st_size);
+  return true;
+}
+
+// Reads buffer[done, size) with pread, stopping early at end of file.
+bool ReadRest(int fd, std::string& buffer, size_t done) {
+  while (done < buffer.size()) {
+    ssize_t n = ::pread(fd, &buffer[done],
+                        std::min(buffer.size() - done, kMaxReadChunk),
+                        static_cast<off_t>(done));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      return false;
+    }
+    if (n == 0) {
+      break;
+    }
+    done += static_cast<size_t>(n);
+  }
+  buffer.resize(done);
+  return true;
+}
+
+bool ReadWholeFile(const std::string& path, RecordView& view) {
+  int fd      = -1;
+  size_t size = 0;
+  if (!OpenForRead(path, fd, size)) {
+    return false;
+  }
+
+  std::string buffer(size, '\0');
+  bool ok = ReadRest(fd, buffer, 0);
+  ::close(fd);
+  if (!ok) {
+    LOG(ERROR) << "Failed to read file: " << path;
+    return false;
+  }
+  view = RecordView::FromString(std::move(buffer));
+  return true;
+}
+
+} // namespace
+
+#ifdef TZIAKCHA_HAVE_IO_URING
+
+// Minimal io_uring wrapper over the raw system calls: one submission and
+// one completion ring, no polling threads and no registered buffers.
+class IoUring {
+public:
+  static std::unique_ptr<IoUring> Create(unsigned entries) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    int fd =
+        static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (fd < 0) {
+      LOG(INFO) << "io_uring unavailable, reading with threads: "
+                << std::strerror(errno);
+      return nullptr;
+    }
+
+    std::unique_ptr<IoUring> ring(new IoUring(fd));
+    if (!ring->map(params)) {
+      LOG(WARNING) << "Failed to map io_uring rings: " << std::strerror(errno);
+      return nullptr;
+    }
+    return ring;
+  }
+
+  ~IoUring() {
+    if (sqes_) {
+      ::munmap(sqes_, sqes_len_);
+    }
+    if (cq_ptr_ && cq_ptr_ != sq_ptr_) {
+      ::munmap(cq_ptr_, cq_len_);
+    }
+    if (sq_ptr_) {
+      ::munmap(sq_ptr_, sq_len_);
+    }
+    ::close(fd_);
+  }
+
+  IoUring(const IoUring&)            = delete;
+  IoUring& operator=(const IoUring&) = delete;
+
+  // Queues a read of len bytes at offset into buf. The request reaches the
+  // kernel on the next submit().
+  bool queue_read(int fd, char* buf, size_t len, size_t offset,
+                  uint64_t user_data) {
+    unsigned tail = *sq_tail_;
+    if (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+      return false;
+    }
+
+    unsigned index   = tail & *sq_mask_;
+    io_uring_sqe* sq = &sqes_[index];
+    std::memset(sq, 0, sizeof(*sq));
+    sq->opcode    = IORING_OP_READ;
+    sq->fd        = fd;
+    sq->addr      = reinterpret_cast<uint64_t>(buf);
+    sq->len       = static_cast<uint32_t>(std::min(len, kMaxReadChunk));
+    sq->off       = offset;
+    sq->user_data = user_data;
+
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    queued_++;
+    return true;
+  }
+
+  // Hands queued requests to the kernel and waits for at least wait_nr
+  // completions.
+  bool submit(unsigned wait_nr) {
+    while (true) {
+      unsigned flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+      long n = ::syscall(__NR_io_uring_enter, fd_, queued_, wait_nr, flags,
+                         nullptr, 0);
+      if (n >= 0) {
+        queued_ -= std::min<unsigned>(queued_, static_cast<unsigned>(n));
+        return true;
+      }
+      if (errno != EINTR) {
+        LOG(ERROR) << "io_uring_enter failed: " << std::strerror(errno);
+        return false;
+      }
+    }
+  }
+
+  bool next_completion(uint64_t& user_data, int& result) {
+    unsigned head = *cq_head_;
+    if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+      return false;
+    }
+    const io_uring_cqe& cqe = cqes_[head & *cq_mask_];
+    user_data               = cqe.user_data;
+    result                  = cqe.res;
+    __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+private:
+  explicit IoUring(int fd) : fd_(fd) {}
+
+  bool map(const io_uring_params& params) {
+    sq_len_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_len_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+      sq_len_ = cq_len_ = std::max(sq_len_, cq_len_);
+    }
+
+    void* sq = ::mmap(nullptr, sq_len_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) {
+      return false;
+    }
+    sq_ptr_ = sq;
+
+    if (single_mmap) {
+      cq_ptr_ = sq_ptr_;
+    } else {
+      void* cq = ::mmap(nullptr, cq_len_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+      if (cq == MAP_FAILED) {
+        return false;
+      }
+      cq_ptr_ = cq;
+    }
+
+    sqes_len_  = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, sqes_len_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+      return false;
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    sq_head_  = RingField<unsigned>(sq_ptr_, params.sq_off.head);
+    sq_tail_  = RingField<unsigned>(sq_ptr_, params.sq_off.tail);
+    sq_mask_  = RingField<unsigned>(sq_ptr_, params.sq_off.ring_mask);
+    sq_array_ = RingField<unsigned>(sq_ptr_, params.sq_off.array);
+    cq_head_  = RingField<unsigned>(cq_ptr_, params.cq_off.head);
+    cq_tail_  = RingField<unsigned>(cq_ptr_, params.cq_off.tail);
+    cq_mask_  = RingField<unsigned>(cq_ptr_, params.cq_off.ring_mask);
+    cqes_     = RingField<io_uring_cqe>(cq_ptr_, params.cq_off.cqes);
+    sq_entries_ = params.sq_entries;
+    return true;
+  }
+
+  template <typename T>
+  static T* RingField(void* base, uint32_t offset) {
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+  }
+
+  int fd_;
+  void* sq_ptr_        = nullptr;
+  void* cq_ptr_        = nullptr;
+  size_t sq_len_       = 0;
+  size_t cq_len_       = 0;
+  io_uring_sqe* sqes_  = nullptr;
+  size_t sqes_len_     = 0;
+  unsigned* sq_head_   = nullptr;
+  unsigned* sq_tail_   = nullptr;
+  unsigned* sq_mask_   = nullptr;
+  unsigned* sq_array_  = nullptr;
+  unsigned* cq_head_   = nullptr;
+  unsigned* cq_tail_   = nullptr;
+  unsigned* cq_mask_   = nullptr;
+  io_uring_cqe* cqes_  = nullptr;
+  unsigned sq_entries_ = 0;
+  unsigned queued_     = 0;
+};
+
+#else
+
+class IoUring {
+public:
+  static std::unique_ptr<IoUring> Create(unsigned) { return nullptr; }
+};
+
+#endif
+
+PrefetchReader::PrefetchReader(size_t queue_depth, Backend backend)
+    : queue_depth_(queue_depth > 0 ? queue_depth : 1) {
+  if (backend == Backend::kIoUring) {
+    ring_ = IoUring::Create(static_cast<unsigned>(queue_depth_));
+  }
+}
+
+PrefetchReader::~PrefetchReader() = default;
+
+bool PrefetchReader::read(const std::vector<std::string>& paths,
+                          const Visitor& visit) {
+  if (paths.empty()) {
+    return true;
+  }
+  return ring_ ? read_with_ring(paths, visit) : read_with_threads(paths, visit);
+}
+
+#ifdef TZIAKCHA_HAVE_IO_URING
+
+bool PrefetchReader::read_with_ring(const std::vector<std::string>& paths,
+                                    const Visitor& visit) {
+  struct Slot {
+    int fd = -1;
+    std::string buffer;
+    size_t done = 0;
+    bool ready  = false;
+    bool ok     = false;
+  };
+
+  std::vector<Slot> slots(queue_depth_);
+  size_t next_issue = 0;
+  size_t delivered  = 0;
+  size_t in_flight  = 0;
+  bool stopped      = false;
+  bool ring_ok      = true;
+
+  auto finish = [](Slot& slot, bool ok) {
+    if (slot.fd >= 0) {
+      ::close(slot.fd);
+      slot.fd = -1;
+    }
+    slot.ready = true;
+    slot.ok    = ok;
+  };
+
+  auto queue_rest = [&](size_t index) {
+    Slot& slot = slots[index % queue_depth_];
+    if (ring_->queue_read(slot.fd, &slot.buffer[slot.done],
+                          slot.buffer.size() - slot.done, slot.done, index)) {
+      in_flight++;
+      return;
+    }
+    finish(slot, ReadRest(slot.fd, slot.buffer, slot.done));
+  };
+
+  auto complete = [&](size_t index, int result) {
+    in_flight--;
+    Slot& slot = slots[index % queue_depth_];
+    if (result == -EINVAL || result == -EOPNOTSUPP) {
+      // Kernels without IORING_OP_READ reject the request; read it here.
+      finish(slot, ReadRest(slot.fd, slot.buffer, slot.done));
+    } else if (result < 0) {
+      LOG(ERROR) << "Failed to read file: " << paths[index] << ": "
+                 << std::strerror(-result);
+      finish(slot, false);
+    } else if (result == 0) {
+      slot.buffer.resize(slot.done);
+      finish(slot, true);
+    } else {
+      slot.done += static_cast<size_t>(result);
+      if (slot.done < slot.buffer.size()) {
+        queue_rest(index);
+      } else {
+        finish(slot, true);
+      }
+    }
+    if (slot.ready && !slot.ok) {
+      slot.buffer.clear();
+    }
+  };
+
+  auto reap = [&] {
+    uint64_t index;
+    int result;
+    while (ring_->next_completion(index, result)) {
+      complete(static_cast<size_t>(index), result);
+    }
+  };
+
+  while (delivered < paths.size() && !stopped && ring_ok) {
+    while (next_issue < paths.size() && next_issue < delivered + queue_depth_) {
+      Slot& slot = slots[next_issue % queue_depth_];
+      slot       = Slot();
+      size_t size;
+      if (!OpenForRead(paths[next_issue], slot.fd, size)) {
+        finish(slot, false);
+      } else if (size == 0) {
+        finish(slot, true);
+      } else {
+        slot.buffer.resize(size);
+        queue_rest(next_issue);
+      }
+      next_issue++;
+    }
+
+    Slot& head = slots[delivered % queue_depth_];
+    if (!head.ready) {
+      ring_ok = ring_->submit(1);
+      reap();
+      continue;
+    }
+
+    // Keep the device busy with the queued reads while the visitor runs.
+    ring_ok = ring_->submit(0);
+    reap();
+
+    RecordView view;
+    if (head.ok) {
+      view = RecordView::FromString(std::move(head.buffer));
+    }
+    bool ok    = head.ok;
+    head.ready = false;
+    stopped    = !visit(delivered, ok, view);
+    delivered++;
+  }
+
+  // Buffers of requests still in flight must outlive them.
+  while (in_flight > 0 && ring_ok) {
+    ring_ok = ring_->submit(1);
+    reap();
+  }
+  for (auto& slot : slots) {
+    if (slot.fd >= 0) {
+      ::close(slot.fd);
+    }
+  }
+  if (ring_ok) {
+    return !stopped;
+  }
+
+  // The kernel may still write into the buffers of the reads in flight, so
+  // they are leaked rather than freed, and the ring is not used again.
+  LOG(ERROR) << "io_uring failed after " << delivered << " of "
+             << paths.size() << " files with " << in_flight
+             << " reads in flight; reading the rest with pread";
+  if (in_flight > 0) {
+    new std::vector<Slot>(std::move(slots));
+  }
+  ring_.reset();
+
+  for (; delivered < paths.size() && !stopped; ++delivered) {
+    RecordView view;
+    bool ok = ReadWholeFile(paths[delivered], view);
+    stopped = !visit(delivered, ok, view);
+  }
+  return !stopped;
+}
+
+#else
+
+bool PrefetchReader::read_with_ring(const std::vector<std::string>& paths,
+                                    const Visitor& visit) {
+  return read_with_threads(paths, visit);
+}
+
+#endif
+
+bool PrefetchReader::read_with_threads(const std::vector<std::string>& paths,
+                                       const Visitor& visit) {
+  struct Slot {
+    RecordView view;
+    bool ready = false;
+    bool ok    = false;
+  };
+
+  std::vector<Slot> slots(queue_depth_);
+  std::mutex mutex;
+  std::condition_variable ready_cv;
+  std::condition_variable space_cv;
+  size_t next_issue = 0;
+  size_t delivered  = 0;
+  bool stopped      = false;
+
+  auto worker = [&] {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      space_cv.wait(lock, [&] {
+        return stopped || next_issue >= paths.size() ||
+               next_issue < delivered + queue_depth_;
+      });
+      if (stopped || next_issue >= paths.size()) {
+        return;
+      }
+
+      size_t index = next_issue++;
+      lock.unlock();
+      RecordView view;
+      bool ok = ReadWholeFile(paths[index], view);
+      lock.lock();
+
+      Slot& slot = slots[index % queue_depth_];
+      slot.view  = std::move(view);
+      slot.ok    = ok;
+      slot.ready = true;
+      ready_cv.notify_all();
+    }
+  };
+
+  size_t thread_count = std::min(queue_depth_, paths.size());
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < thread_count; ++i) {
+    threads.emplace_back(worker);
+  }
+
+  while (delivered < paths.size()) {
+    std::unique_lock<std::mutex> lock(mutex);
+    Slot& slot = slots[delivered % queue_depth_];
+    ready_cv.wait(lock, [&] { return slot.ready; });
+
+    RecordView view = std::move(slot.view);
+    bool ok         = slot.ok;
+    size_t index    = delivered++;
+    slot            = Slot();
+    space_cv.notify_all();
+    lock.unlock();
+
+    if (!visit(index, ok, view)) {
+      lock.lock();
+      stopped = true;
+      space_cv.notify_all();
+      break;
+    }
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  return !stopped;
+}
+
+const char* PrefetchBackendName(PrefetchReader::Backend backend) {
+  switch (backend) {
+  case PrefetchReader::Backend::kIoUring:
+    return "io_uring";
+  case PrefetchReader::Backend::kThreadPool:
+  default:
+    return "threads";
+  }
+}
+
+} // namespace storage
+} // namespace tziakcha
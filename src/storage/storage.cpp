@@ -0,0 +1,146 @@
+#include "storage/storage.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <glog/logging.h>
+
+namespace tziakcha {
+namespace storage {
+
+namespace {
+
+// Produces keys by calling visit until it returns false.
+using KeySource = std::function<void(const KeyVisitor& visit)>;
+
+bool StreamRecords(Storage& storage,
+                   const KeySource& source,
+                   const RecordVisitor& visit,
+                   size_t read_ahead) {
+  if (read_ahead == 0) {
+    bool stopped = false;
+    source([&](const std::string& key) {
+      RecordView view;
+      stopped = storage.load_view(key, view) && !visit(key, view);
+      return !stopped;
+    });
+    return !stopped;
+  }
+
+  std::mutex mutex;
+  std::condition_variable ready_cv;
+  std::condition_variable space_cv;
+  std::deque<std::pair<std::string, RecordView>> loaded;
+  bool producer_done = false;
+  bool cancelled     = false;
+
+  std::exception_ptr producer_error;
+
+  std::thread producer([&] {
+    try {
+      source([&](const std::string& key) {
+        RecordView view;
+        if (!storage.load_view(key, view)) {
+          LOG(WARNING) << "Failed to load record: " << key;
+          return true;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        space_cv.wait(
+            lock, [&] { return cancelled || loaded.size() < read_ahead; });
+        if (cancelled) {
+          return false;
+        }
+        loaded.emplace_back(key, std::move(view));
+        ready_cv.notify_one();
+        return true;
+      });
+    } catch (...) {
+      producer_error = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    producer_done = true;
+    ready_cv.notify_one();
+  });
+
+  // A throwing visitor must still stop and join the producer; an unjoined
+  // std::thread would terminate the process.
+  auto stop_producer = [&] {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      cancelled = true;
+    }
+    space_cv.notify_one();
+    producer.join();
+  };
+
+  try {
+    while (true) {
+      std::unique_lock<std::mutex> lock(mutex);
+      ready_cv.wait(lock, [&] { return producer_done || !loaded.empty(); });
+      if (loaded.empty()) {
+        break;
+      }
+
+      auto item = std::move(loaded.front());
+      loaded.pop_front();
+      space_cv.notify_one();
+      lock.unlock();
+
+      if (!visit(item.first, item.second)) {
+        lock.lock();
+        cancelled = true;
+        space_cv.notify_one();
+        break;
+      }
+    }
+  } catch (...) {
+    stop_producer();
+    throw;
+  }
+
+  producer.join();
+  if (producer_error) {
+    std::rethrow_exception(producer_error);
+  }
+  return !cancelled;
+}
+
+} // namespace
+
+bool Storage::save_string(const std::string& key,
+                          const std::string& content) {
+  json data = json::parse(content, nullptr, false);
+  if (data.is_discarded()) {
+    LOG(ERROR) << "Refusing to save invalid JSON for " << key;
+    return false;
+  }
+  return save_json(key, data);
+}
+
+void Storage::for_each_record(const std::string& prefix,
+                              const RecordVisitor& visit,
+                              size_t read_ahead) {
+  auto source = [&](const KeyVisitor& key_visit) {
+    for_each_key(prefix, key_visit);
+  };
+  StreamRecords(*this, source, visit, read_ahead);
+}
+
+bool Storage::stream_records(const std::vector<std::string>& keys,
+                             const RecordVisitor& visit,
+                             size_t read_ahead) {
+  auto source = [&](const KeyVisitor& key_visit) {
+    for (const auto& key : keys) {
+      if (!key_visit(key)) {
+        return;
+      }
+    }
+  };
+  return StreamRecords(*this, source, visit, read_ahead);
+}
+
+} // namespace storage
+} // namespace tziakcha
@@ -0,0 +1,566 @@
+#include "storage/filesystem_storage.h"
+#include "storage/packed_storage.h"
+#include "storage/storage_factory.h"
+#include "utils/script_decoder.h"
+#include <chrono>
+#include <cxxopts.hpp>
+#include <iomanip>
+#include <iostream>
+#include <filesystem>
+#include <glog/logging.h>
+
+namespace fs = std::filesystem;
+
+void print_usage() {
+  std::cout << "Tziakcha Record Miner - Storage CLI\n\n";
+  std::cout << "Usage:\n";
+  std::cout << "  storage_cli <command> [options]\n\n";
+  std::cout << "Commands:\n";
+  std::cout << "  import      Copy every key from one storage into another\n";
+  std::cout << "  compact     Drop dead entries from a packed archive\n";
+  std::cout << "  migrate     Rewrite documents in another encoding\n";
+  std::cout << "  manifest    Rebuild or verify the key manifest\n";
+  std::cout << "  reshard     Move files into a hash-sharded layout\n";
+  std::cout << "  script-report  Compare script storage modes\n";
+  std::cout << "  help        Show this help message\n\n";
+  std::cout << "Run 'storage_cli <command> --help' for more information on a "
+               "command.\n";
+}
+
+int cmd_import(int argc, char* argv[]) {
+  cxxopts::Options options(
+      "storage_cli import", "Copy every key from one storage into another");
+  options.add_options()(
+      "s,source", "Source storage directory", cxxopts::value<std::string>())(
+      "t,target", "Target storage directory", cxxopts::value<std::string>())(
+      "p,prefix",
+      "Only copy keys with this prefix",
+      cxxopts::value<std::string>()->default_value(""))(
+      "target-storage",
+      "Target backend (auto, fs, packed)",
+      cxxopts::value<std::string>()->default_value("packed"))(
+      "e,encoding",
+      "Target document encoding (json, cbor, msgpack)",
+      cxxopts::value<std::string>()->default_value("json"))(
+      "h,help", "Print help");
+
+  auto result = options.parse(argc, argv);
+
+  if (result.count("help")) {
+    std::cout << options.help() << std::endl;
+    return 0;
+  }
+
+  if (!result.count("source") || !result.count("target")) {
+    std::cerr << "Error: --source and --target are required" << std::endl;
+    std::cout << options.help() << std::endl;
+    return 1;
+  }
+
+  std::string source_dir = result["source"].as<std::string>();
+  std::string target_dir = result["target"].as<std::string>();
+  std::string prefix     = result["prefix"].as<std::string>();
+
+  tziakcha::storage::StorageBackend backend;
+  if (!tziakcha::storage::ParseStorageBackend(
+          result["target-storage"].as<std::string>(), backend)) {
+    return 1;
+  }
+
+  tziakcha::storage::Encoding encoding;
+  if (!tziakcha::storage::ParseEncoding(
+          result["encoding"].as<std::string>(), encoding)) {
+    return 1;
+  }
+
+  if (!fs::is_directory(source_dir)) {
+    std::cerr << "Error: Not a directory: " << source_dir << std::endl;
+    return 1;
+  }
+
+  auto source = tziakcha::storage::OpenStorage(
+      source_dir,
+      tziakcha::storage::StorageBackend::kAuto,
+      tziakcha::storage::Encoding::kJson,
+      tziakcha::storage::OpenMode::kReadOnly);
+  auto target =
+      tziakcha::storage::OpenStorage(target_dir, backend, encoding);
+
+  auto keys        = source->list_keys(prefix);
+  int copied_count = 0;
+  int failed_count = 0;
+
+  for (size_t i = 0; i < keys.size(); ++i) {
+    json data;
+    if (source->load_json(keys[i], data) && target->save_json(keys[i], data)) {
+      copied_count++;
+    } else {
+      LOG(ERROR) << "Failed to copy key: " << keys[i];
+      failed_count++;
+    }
+  }
+
+  std::cout << "\n=== Import Summary ===\n";
+  std::cout << "Total keys: " << keys.size() << "\n";
+  std::cout << "Copied: " << copied_count << "\n";
+  std::cout << "Failed: " << failed_count << "\n";
+
+  return (failed_count > 0) ? 1 : 0;
+}
+
+int cmd_compact(int argc, char* argv[]) {
+  cxxopts::Options options(
+      "storage_cli compact", "Drop dead entries from a packed archive");
+  options.add_options()(
+      "d,data-dir", "Packed archive directory", cxxopts::value<std::string>())(
+      "h,help", "Print help");
+
+  auto result = options.parse(argc, argv);
+
+  if (result.count("help")) {
+    std::cout << options.help() << std::endl;
+    return 0;
+  }
+
+  if (!result.count("data-dir")) {
+    std::cerr << "Error: --data-dir is required" << std::endl;
+    std::cout << options.help() << std::endl;
+    return 1;
+  }
+
+  std::string data_dir = result["data-dir"].as<std::string>();
+  if (!tziakcha::storage::PackedStorage::IsArchive(data_dir)) {
+    std::cerr << "Error: Not a packed archive: " << data_dir << std::endl;
+    return 1;
+  }
+
+  tziakcha::storage::PackedStorage archive(data_dir);
+  tziakcha::storage::PackedStorage::CompactionStats stats;
+  if (!archive.compact(&stats)) {
+    LOG(ERROR) << "Failed to compact archive: " << data_dir;
+    return 1;
+  }
+
+  std::cout << "\n=== Compaction Summary ===\n";
+  std::cout << "Live records: " << stats.live_records << "\n";
+  std::cout << "Segments: " << stats.segments_before << " -> "
+            << stats.segments_after << "\n";
+  std::cout << "Bytes: " << stats.bytes_before << " -> " << stats.bytes_after
+            << "\n";
+
+  return 0;
+}
+
+int cmd_migrate(int argc, char* argv[]) {
+  cxxopts::Options options(
+      "storage_cli migrate", "Rewrite documents in another encoding");
+  options.add_options()(
+      "d,data-dir", "Storage directory", cxxopts::value<std::string>())(
+      "e,encoding",
+      "Target document encoding (json, cbor, msgpack)",
+      cxxopts::value<std::string>())(
+      "p,prefix",
+      "Only migrate keys with this prefix",
+      cxxopts::value<std::string>()->default_value(""))(
+      "script-mode",
+      "Also convert record scripts (decoded, compressed)",
+      cxxopts::value<std::string>())(
+      "h,help", "Print help");
+
+  auto result = options.parse(argc, argv);
+
+  if (result.count("help")) {
+    std::cout << options.help() << std::endl;
+    return 0;
+  }
+
+  if (!result.count("data-dir") || !result.count("encoding")) {
+    std::cerr << "Error: --data-dir and --encoding are required" << std::endl;
+    std::cout << options.help() << std::endl;
+    return 1;
+  }
+
+  std::string data_dir = result["data-dir"].as<std::string>();
+  std::string prefix   = result["prefix"].as<std::string>();
+
+  tziakcha::storage::Encoding encoding;
+  if (!tziakcha::storage::ParseEncoding(
+          result["encoding"].as<std::string>(), encoding)) {
+    return 1;
+  }
+
+  bool convert_scripts = result.count("script-mode") > 0;
+  tziakcha::utils::ScriptMode script_mode;
+  if (convert_scripts &&
+      !tziakcha::utils::ParseScriptMode(
+          result["script-mode"].as<std::string>(), script_mode)) {
+    return 1;
+  }
+
+  if (!fs::is_directory(data_dir)) {
+    std::cerr << "Error: Not a directory: " << data_dir << std::endl;
+    return 1;
+  }
+
+  auto storage = tziakcha::storage::OpenStorage(
+      data_dir, tziakcha::storage::StorageBackend::kAuto, encoding);
+
+  auto keys          = storage->list_keys(prefix);
+  int migrated_count = 0;
+  int failed_count   = 0;
+
+  for (const auto& key : keys) {
+    json data;
+    if (!storage->load_json(key, data)) {
+      LOG(ERROR) << "Failed to load key: " << key;
+      failed_count++;
+      continue;
+    }
+
+    if (convert_scripts && data.contains("script") &&
+        !tziakcha::utils::ApplyScriptMode(data, script_mode)) {
+      LOG(WARNING) << "Failed to convert script of key: " << key;
+    }
+
+    if (storage->save_json(key, data)) {
+      migrated_count++;
+    } else {
+      LOG(ERROR) << "Failed to migrate key: " << key;
+      failed_count++;
+    }
+  }
+
+  std::cout << "\n=== Migration Summary ===\n";
+  std::cout << "Target encoding: "
+            << tziakcha::storage::EncodingName(encoding) << "\n";
+  std::cout << "Total keys: " << keys.size() << "\n";
+  std::cout << "Migrated: " << migrated_count << "\n";
+  std::cout << "Failed: " << failed_count << "\n";
+
+  return (failed_count > 0) ? 1 : 0;
+}
+
+int cmd_manifest(int argc, char* argv[]) {
+  cxxopts::Options options("storage_cli manifest",
+                           "Rebuild or verify the key manifest");
+  options.add_options()(
+      "d,data-dir", "Storage directory", cxxopts::value<std::string>())(
+      "rebuild",
+      "Rescan the directory and rewrite the manifest",
+      cxxopts::value<bool>()->default_value("false"))(
+      "verify",
+      "Compare the manifest against the files on disk",
+      cxxopts::value<bool>()->default_value("false"))(
+      "h,help", "Print help");
+
+  auto result = options.parse(argc, argv);
+
+  if (result.count("help")) {
+    std::cout << options.help() << std::endl;
+    return 0;
+  }
+
+  bool rebuild = result["rebuild"].as<bool>();
+  bool verify  = result["verify"].as<bool>();
+
+  if (!result.count("data-dir") || rebuild == verify) {
+    std::cerr << "Error: --data-dir and one of --rebuild or --verify are "
+                 "required"
+              << std::endl;
+    std::cout << options.help() << std::endl;
+    return 1;
+  }
+
+  std::string data_dir = result["data-dir"].as<std::string>();
+  if (!fs::is_directory(data_dir)) {
+    std::cerr << "Error: Not a directory: " << data_dir << std::endl;
+    return 1;
+  }
+  if (tziakcha::storage::PackedStorage::IsArchive(data_dir)) {
+    std::cerr << "Error: Packed archives keep their own index: " << data_dir
+              << std::endl;
+    return 1;
+  }
+
+  tziakcha::storage::FileSystemStorage storage(data_dir);
+
+  if (rebuild) {
+    size_t key_count = 0;
+    if (!storage.rebuild_manifest(&key_count)) {
+      LOG(ERROR) << "Failed to rebuild key manifest: " << data_dir;
+      return 1;
+    }
+    std::cout << "Manifest rebuilt with " << key_count << " keys\n";
+    return 0;
+  }
+
+  if (!storage.has_manifest()) {
+    std::cerr << "Error: No key manifest in " << data_dir
+              << " (run with --rebuild)" << std::endl;
+    return 1;
+  }
+
+  std::vector<std::string> missing;
+  std::vector<std::string> stale;
+  bool consistent = storage.verify_manifest(&missing, &stale);
+
+  for (const auto& key : missing) {
+    std::cout << "  not indexed: " << key << "\n";
+  }
+  for (const auto& key : stale) {
+    std::cout << "  stale entry: " << key << "\n";
+  }
+
+  std::cout << "\n=== Manifest Verification ===\n";
+  std::cout << "Not indexed: " << missing.size() << "\n";
+  std::cout << "Stale entries: " << stale.size() << "\n";
+  std::cout << (consistent ? "Manifest is consistent\n"
+                           : "Manifest is out of date; run --rebuild\n");
+
+  return consistent ? 0 : 1;
+}
+
+int cmd_reshard(int argc, char* argv[]) {
+  cxxopts::Options options("storage_cli reshard",
+                           "Move files into a hash-sharded directory layout");
+  options.add_options()(
+      "d,data-dir", "Storage directory", cxxopts::value<std::string>())(
+      "l,levels",
+      "Hash-prefix directory levels (0 = flat)",
+      cxxopts::value<int>()->default_value("2"))("h,help", "Print help");
+
+  auto result = options.parse(argc, argv);
+
+  if (result.count("help")) {
+    std::cout << options.help() << std::endl;
+    return 0;
+  }
+
+  if (!result.count("data-dir")) {
+    std::cerr << "Error: --data-dir is required" << std::endl;
+    std::cout << options.help() << std::endl;
+    return 1;
+  }
+
+  std::string data_dir = result["data-dir"].as<std::string>();
+  int levels           = result["levels"].as<int>();
+
+  if (!fs::is_directory(data_dir)) {
+    std::cerr << "Error: Not a directory: " << data_dir << std::endl;
+    return 1;
+  }
+  if (tziakcha::storage::PackedStorage::IsArchive(data_dir)) {
+    std::cerr << "Error: Packed archives have no directory layout: "
+              << data_dir << std::endl;
+    return 1;
+  }
+
+  tziakcha::storage::FileSystemStorage storage(data_dir);
+  int previous_levels = storage.get_shard_levels();
+
+  size_t moved = 0;
+  if (!storage.reshard(levels, &moved)) {
+    LOG(ERROR) << "Failed to reshard storage: " << data_dir;
+    std::cerr << "Moved " << moved << " files before failing; re-run to "
+              << "finish" << std::endl;
+    return 1;
+  }
+
+  std::cout << "\n=== Reshard Summary ===\n";
+  std::cout << "Levels: " << previous_levels << " -> " << levels << "\n";
+  std::cout << "Files moved: " << moved << "\n";
+
+  return 0;
+}
+
+bool time_script_read(const std::string& bytes,
+                      tziakcha::utils::ScriptMode mode,
+                      double& seconds) {
+  auto start = std::chrono::steady_clock::now();
+
+  json record;
+  if (!tziakcha::storage::DecodeDocument(bytes, record)) {
+    return false;
+  }
+
+  json script;
+  if (mode == tziakcha::utils::ScriptMode::kCompressed) {
+    if (!tziakcha::utils::DecodeScriptToJson(
+            record["script"].get<std::string>(), script)) {
+      return false;
+    }
+  } else {
+    script = std::move(record["step"]);
+  }
+
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  seconds += std::chrono::duration<double>(elapsed).count();
+  return script.contains("a");
+}
+
+void print_script_mode_report(const std::string& name,
+                              uint64_t bytes,
+                              double seconds,
+                              int records) {
+  double mb = static_cast<double>(bytes) / (1024.0 * 1024.0);
+  std::cout << name << ":\n";
+  std::cout << "  Bytes: " << bytes << " (" << std::fixed
+            << std::setprecision(2) << mb << " MiB)\n";
+  if (records > 0) {
+    std::cout << "  Avg bytes/record: " << bytes / records << "\n";
+  }
+  if (seconds > 0) {
+    std::cout << "  Read throughput: " << records / seconds << " records/s, "
+              << mb / seconds << " MiB/s\n";
+  }
+}
+
+int cmd_script_report(int argc, char* argv[]) {
+  cxxopts::Options options(
+      "storage_cli script-report",
+      "Compare on-disk size and read speed of decoded vs compressed scripts");
+  options.add_options()(
+      "d,data-dir", "Record storage directory", cxxopts::value<std::string>())(
+      "p,prefix",
+      "Only sample keys with this prefix",
+      cxxopts::value<std::string>()->default_value(""))(
+      "l,limit",
+      "Maximum records to sample (0 = all)",
+      cxxopts::value<int>()->default_value("0"))(
+      "e,encoding",
+      "Document encoding to measure (json, cbor, msgpack)",
+      cxxopts::value<std::string>()->default_value("json"))(
+      "h,help", "Print help");
+
+  auto result = options.parse(argc, argv);
+
+  if (result.count("help")) {
+    std::cout << options.help() << std::endl;
+    return 0;
+  }
+
+  if (!result.count("data-dir")) {
+    std::cerr << "Error: --data-dir is required" << std::endl;
+    std::cout << options.help() << std::endl;
+    return 1;
+  }
+
+  std::string data_dir = result["data-dir"].as<std::string>();
+  std::string prefix   = result["prefix"].as<std::string>();
+  int limit            = result["limit"].as<int>();
+
+  tziakcha::storage::Encoding encoding;
+  if (!tziakcha::storage::ParseEncoding(
+          result["encoding"].as<std::string>(), encoding)) {
+    return 1;
+  }
+
+  if (!fs::is_directory(data_dir)) {
+    std::cerr << "Error: Not a directory: " << data_dir << std::endl;
+    return 1;
+  }
+
+  auto storage = tziakcha::storage::OpenStorage(
+      data_dir,
+      tziakcha::storage::StorageBackend::kAuto,
+      tziakcha::storage::Encoding::kJson,
+      tziakcha::storage::OpenMode::kReadOnly);
+
+  auto keys = storage->list_keys(prefix);
+
+  int sampled_count      = 0;
+  int skipped_count      = 0;
+  uint64_t decoded_bytes = 0;
+  uint64_t packed_bytes  = 0;
+  double decoded_seconds = 0.0;
+  double packed_seconds  = 0.0;
+
+  for (const auto& key : keys) {
+    if (limit > 0 && sampled_count >= limit) {
+      break;
+    }
+
+    json decoded;
+    if (!storage->load_json(key, decoded)) {
+      skipped_count++;
+      continue;
+    }
+
+    json compressed = decoded;
+    if (!tziakcha::utils::ExpandRecordScript(decoded) ||
+        !tziakcha::utils::CompressRecordScript(compressed)) {
+      skipped_count++;
+      continue;
+    }
+
+    std::string decoded_doc =
+        tziakcha::storage::EncodeDocument(decoded, encoding);
+    std::string packed_doc =
+        tziakcha::storage::EncodeDocument(compressed, encoding);
+
+    if (!time_script_read(decoded_doc,
+                          tziakcha::utils::ScriptMode::kDecoded,
+                          decoded_seconds) ||
+        !time_script_read(packed_doc,
+                          tziakcha::utils::ScriptMode::kCompressed,
+                          packed_seconds)) {
+      skipped_count++;
+      continue;
+    }
+
+    decoded_bytes += decoded_doc.size();
+    packed_bytes += packed_doc.size();
+    sampled_count++;
+  }
+
+  std::cout << "\n=== Script Storage Report ===\n";
+  std::cout << "Encoding: " << tziakcha::storage::EncodingName(encoding)
+            << "\n";
+  std::cout << "Records sampled: " << sampled_count << "\n";
+  std::cout << "Records skipped: " << skipped_count << "\n";
+  print_script_mode_report(
+      "decoded", decoded_bytes, decoded_seconds, sampled_count);
+  print_script_mode_report(
+      "compressed", packed_bytes, packed_seconds, sampled_count);
+  if (packed_bytes > 0) {
+    std::cout << "Size ratio (decoded/compressed): " << std::fixed
+              << std::setprecision(2)
+              << static_cast<double>(decoded_bytes) / packed_bytes << "\n";
+  }
+
+  return sampled_count > 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+  google::InitGoogleLogging(argv[0]);
+  FLAGS_logtostderr = true;
+  FLAGS_minloglevel = 1;
+
+  if (argc < 2) {
+    print_usage();
+    return 1;
+  }
+
+  std::string command = argv[1];
+
+  if (command == "help" || command == "--help" || command == "-h") {
+    print_usage();
+    return 0;
+  } else if (command == "import") {
+    return cmd_import(argc - 1, argv + 1);
+  } else if (command == "compact") {
+    return cmd_compact(argc - 1, argv + 1);
+  } else if (command == "migrate") {
+    return cmd_migrate(argc - 1, argv + 1);
+  } else if (command == "reshard") {
+    return cmd_reshard(argc - 1, argv + 1);
+  } else if (command == "manifest") {
+    return cmd_manifest(argc - 1, argv + 1);
+  } else if (command == "script-report") {
+    return cmd_script_report(argc - 1, argv + 1);
+  } else {
+    std::cerr << "Unknown command: " << command << std::endl;
+    std::cerr << "Run 'storage_cli help' for usage." << std::endl;
+    return 1;
+  }
+}
@@ -0,0 +1,40 @@
+#include "storage/storage_factory.h"
+#include "storage/filesystem_storage.h"
+#include "storage/packed_storage.h"
+#include <glog/logging.h>
+
+namespace tziakcha {
+namespace storage {
+
+bool ParseStorageBackend(const std::string& name, StorageBackend& backend) {
+  if (name == "auto") {
+    backend = StorageBackend::kAuto;
+  } else if (name == "fs" || name == "filesystem") {
+    backend = StorageBackend::kFileSystem;
+  } else if (name == "packed") {
+    backend = StorageBackend::kPacked;
+  } else {
+    LOG(ERROR) << "Unknown storage backend: " << name;
+    return false;
+  }
+  return true;
+}
+
+std::shared_ptr<Storage> OpenStorage(const std::string& base_dir,
+                                     StorageBackend backend,
+                                     Encoding encoding,
+                                     OpenMode mode) {
+  if (backend == StorageBackend::kAuto) {
+    backend = PackedStorage::IsArchive(base_dir) ? StorageBackend::kPacked
+                                                 : StorageBackend::kFileSystem;
+  }
+
+  if (backend == StorageBackend::kPacked) {
+    return std::make_shared<PackedStorage>(
+        base_dir, PackedStorage::kDefaultSegmentBytes, encoding, mode);
+  }
+  return std::make_shared<FileSystemStorage>(base_dir, encoding);
+}
+
+} // namespace storage
+} // namespace tziakcha
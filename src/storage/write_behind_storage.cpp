@@ -0,0 +1,254 @@
+#include "storage/write_behind_storage.h"
+#include <iostream>
+#include <glog/logging.h>
+
+namespace tziakcha {
+namespace storage {
+
+WriteBehindStorage::WriteBehindStorage(std::shared_ptr<Storage> inner,
+                                       size_t batch_size,
+                                       size_t max_pending)
+    : inner_(std::move(inner)),
+      batch_size_(batch_size > 0 ? batch_size : 1),
+      max_pending_(max_pending > 0 ? max_pending : 1) {
+  worker_ = std::thread(&WriteBehindStorage::run, this);
+}
+
+WriteBehindStorage::~WriteBehindStorage() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_cv_.notify_all();
+  worker_.join();
+
+  if (failed_count_ > 0) {
+    LOG(ERROR) << "Write-behind storage dropped " << failed_count_
+               << " failed writes";
+  }
+}
+
+bool WriteBehindStorage::save_json(const std::string& key, const json& data) {
+  Document document;
+  document.data = data;
+  return enqueue(key, std::move(document));
+}
+
+bool WriteBehindStorage::save_string(const std::string& key,
+                                     const std::string& content) {
+  Document document;
+  document.text    = content;
+  document.is_text = true;
+  return enqueue(key, std::move(document));
+}
+
+bool WriteBehindStorage::enqueue(const std::string& key, Document document) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_cv_.wait(lock, [this] { return pending_.size() < max_pending_; });
+  if (failed_since_flush_ > 0) {
+    LOG(ERROR) << "Refusing to queue " << key << " after "
+               << failed_since_flush_ << " failed background writes";
+    return false;
+  }
+
+  auto it = pending_.find(key);
+  if (it != pending_.end()) {
+    it->second = std::move(document);
+  } else {
+    pending_.emplace(key, std::move(document));
+    order_.push_back(key);
+  }
+
+  lock.unlock();
+  work_cv_.notify_one();
+  return true;
+}
+
+bool WriteBehindStorage::find_queued(const std::string& key,
+                                     Document& document) const {
+  auto it = pending_.find(key);
+  if (it != pending_.end()) {
+    document = it->second;
+    return true;
+  }
+
+  for (const auto& item : in_flight_) {
+    if (item.first == key) {
+      document.data = item.second;
+      return true;
+    }
+  }
+  for (const auto& item : in_flight_text_) {
+    if (item.first == key) {
+      document.text    = item.second;
+      document.is_text = true;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool WriteBehindStorage::idle() const {
+  return order_.empty() && in_flight_.empty() && in_flight_text_.empty();
+}
+
+bool WriteBehindStorage::load_json(const std::string& key, json& data) {
+  Document document;
+  bool queued;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queued = find_queued(key, document);
+  }
+  if (!queued) {
+    return inner_->load_json(key, data);
+  }
+  if (!document.is_text) {
+    data = std::move(document.data);
+    return true;
+  }
+  data = json::parse(document.text, nullptr, false);
+  return !data.is_discarded();
+}
+
+bool WriteBehindStorage::load_string(const std::string& key,
+                                     std::string& out) {
+  Document document;
+  bool queued;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queued = find_queued(key, document);
+  }
+  if (!queued) {
+    return inner_->load_string(key, out);
+  }
+  out = document.is_text ? std::move(document.text) : document.data.dump();
+  return true;
+}
+
+bool WriteBehindStorage::load_view(const std::string& key, RecordView& out) {
+  std::string content;
+  if (!load_string(key, content)) {
+    return false;
+  }
+  out = RecordView::FromString(std::move(content));
+  return true;
+}
+
+bool WriteBehindStorage::exists(const std::string& key) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pending_.count(key) > 0) {
+      return true;
+    }
+    for (const auto& item : in_flight_) {
+      if (item.first == key) {
+        return true;
+      }
+    }
+    for (const auto& item : in_flight_text_) {
+      if (item.first == key) {
+        return true;
+      }
+    }
+  }
+  return inner_->exists(key);
+}
+
+bool WriteBehindStorage::remove(const std::string& key) {
+  drain();
+  return inner_->remove(key);
+}
+
+std::vector<std::string>
+WriteBehindStorage::list_keys(const std::string& prefix) {
+  drain();
+  return inner_->list_keys(prefix);
+}
+
+void WriteBehindStorage::print_json(const std::string& key, int indent) {
+  json data;
+  if (load_json(key, data)) {
+    std::cout << data.dump(indent) << std::endl;
+  } else {
+    LOG(ERROR) << "Failed to load JSON for key: " << key;
+  }
+}
+
+void WriteBehindStorage::drain() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  work_cv_.notify_one();
+  idle_cv_.wait(lock, [this] { return idle(); });
+}
+
+bool WriteBehindStorage::flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  work_cv_.notify_one();
+  idle_cv_.wait(lock, [this] { return idle(); });
+
+  bool ok             = failed_since_flush_ == 0;
+  failed_since_flush_ = 0;
+  lock.unlock();
+
+  return inner_->flush() && ok;
+}
+
+size_t WriteBehindStorage::written_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return written_count_;
+}
+
+size_t WriteBehindStorage::failed_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return failed_count_;
+}
+
+void WriteBehindStorage::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    work_cv_.wait(lock, [this] { return stopping_ || !order_.empty(); });
+    if (order_.empty()) {
+      break;
+    }
+
+    while (!order_.empty() &&
+           in_flight_.size() + in_flight_text_.size() < batch_size_) {
+      auto it = pending_.find(order_.front());
+      if (it->second.is_text) {
+        in_flight_text_.emplace_back(it->first, std::move(it->second.text));
+      } else {
+        in_flight_.emplace_back(it->first, std::move(it->second.data));
+      }
+      pending_.erase(it);
+      order_.pop_front();
+    }
+
+    // The in-flight lists are only read by other threads while the batch
+    // is written.
+    lock.unlock();
+    size_t failed = 0;
+    if (!in_flight_.empty() && !inner_->save_many(in_flight_)) {
+      failed += in_flight_.size();
+    }
+    for (const auto& [key, text] : in_flight_text_) {
+      if (!inner_->save_string(key, text)) {
+        failed++;
+      }
+    }
+    lock.lock();
+
+    size_t batch_size = in_flight_.size() + in_flight_text_.size();
+    written_count_ += batch_size - failed;
+    if (failed > 0) {
+      LOG(ERROR) << "Failed to write " << failed << " of a batch of "
+                 << batch_size << " documents";
+      failed_count_ += failed;
+      failed_since_flush_ += failed;
+    }
+    in_flight_.clear();
+    in_flight_text_.clear();
+    idle_cv_.notify_all();
+  }
+}
+
+} // namespace storage
+} // namespace tziakcha
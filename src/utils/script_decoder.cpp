@@ -2,57 +2,247 @@
 #include <base64.h>
 #include <glog/logging.h>
 #include <zlib.h>
-#include <array>
-#include <vector>
+#include <algorithm>
+#include <cstdint>
 
 namespace tziakcha {
 namespace utils {
 
-bool DecodeScriptToJson(const std::string& encoded, json& out) {
-  if (encoded == "<Decoded>") {
+namespace {
+
+// Maps a base64 character of either alphabet (cpp-base64 accepts both
+// "+/" and "-_") to its 6-bit value, and anything else to kBase64Invalid.
+constexpr uint8_t kBase64Invalid = 0x80;
+
+struct Base64Table {
+  uint8_t values[256];
+
+  constexpr Base64Table() : values() {
+    for (auto& value : values) {
+      value = kBase64Invalid;
+    }
+    const char* alphabet =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+    for (uint8_t i = 0; i < 62; ++i) {
+      values[static_cast<uint8_t>(alphabet[i])] = i;
+    }
+    values['+'] = values['-'] = 62;
+    values['/'] = values['_'] = 63;
+  }
+};
+
+constexpr Base64Table kBase64;
+
+// Decodes four characters per step with no data-dependent branch: the
+// table values are OR-ed together and checked for kBase64Invalid once at
+// the end. This is plain scalar code; the table lookups keep compilers from
+// vectorizing it, and the gain over cpp-base64 comes from the branch-free
+// loop and from writing into a reused buffer.
+bool DecodeBase64(std::string_view in, std::string& out) {
+  while (!in.empty() && in.back() == '=') {
+    in.remove_suffix(1);
+  }
+  size_t groups = in.size() / 4;
+  size_t rest   = in.size() % 4;
+  if (rest == 1) {
     return false;
   }
 
-  try {
-    std::string decoded = base64_decode(encoded, true);
-    if (decoded.empty()) {
-      LOG(ERROR) << "Base64 decoded script is empty";
-      return false;
+  out.resize(groups * 3 + (rest > 0 ? rest - 1 : 0));
+  const auto* src = reinterpret_cast<const uint8_t*>(in.data());
+  auto* dst       = reinterpret_cast<uint8_t*>(out.data());
+  const auto& t   = kBase64.values;
+
+  uint32_t invalid = 0;
+  for (size_t i = 0; i < groups; ++i, src += 4, dst += 3) {
+    uint32_t a = t[src[0]], b = t[src[1]], c = t[src[2]], d = t[src[3]];
+    invalid |= a | b | c | d;
+    uint32_t bits = a << 18 | b << 12 | c << 6 | d;
+    dst[0]        = static_cast<uint8_t>(bits >> 16);
+    dst[1]        = static_cast<uint8_t>(bits >> 8);
+    dst[2]        = static_cast<uint8_t>(bits);
+  }
+
+  if (rest > 0) {
+    uint32_t a = t[src[0]], b = t[src[1]];
+    uint32_t c = rest == 3 ? t[src[2]] : 0;
+    invalid |= a | b | c;
+    uint32_t bits = a << 18 | b << 12 | c << 6;
+    dst[0]        = static_cast<uint8_t>(bits >> 16);
+    if (rest == 3) {
+      dst[1] = static_cast<uint8_t>(bits >> 8);
     }
+  }
+  return (invalid & kBase64Invalid) == 0;
+}
+
+// Byte positions of the parts of a record's JSON text that a script mode
+// change touches.
+struct RecordLayout {
+  size_t script_begin = std::string_view::npos; // first byte of the value
+  size_t script_end   = std::string_view::npos; // its closing quote
+  bool script_escaped = false;
+  bool has_step       = false;
+  size_t close        = std::string_view::npos; // the top-level '}'
+};
 
-    z_stream stream{};
-    stream.next_in  = reinterpret_cast<Bytef*>(decoded.data());
-    stream.avail_in = static_cast<uInt>(decoded.size());
+// Walks already validated JSON text, tracking only strings and nesting
+// depth.
+bool ScanRecordText(std::string_view text, RecordLayout& layout) {
+  size_t i = text.find_first_not_of(" \t\r\n");
+  if (i == std::string_view::npos || text[i] != '{') {
+    return false;
+  }
+
+  int depth       = 0;
+  bool expect_key = false;
+  std::string_view key;
+  for (; i < text.size(); ++i) {
+    char c = text[i];
+    if (c == '"') {
+      size_t end   = i + 1;
+      bool escaped = false;
+      while (text[end] != '"') {
+        if (text[end] == '\\') {
+          escaped = true;
+          ++end;
+        }
+        ++end;
+      }
 
-    if (inflateInit(&stream) != Z_OK) {
+      std::string_view value = text.substr(i + 1, end - i - 1);
+      if (depth == 1 && expect_key) {
+        key             = value;
+        expect_key      = false;
+        layout.has_step = layout.has_step || key == "step";
+      } else if (depth == 1 && key == "script") {
+        layout.script_begin   = i + 1;
+        layout.script_end     = end;
+        layout.script_escaped = escaped;
+      }
+      i = end;
+      continue;
+    }
+
+    switch (c) {
+    case '{':
+    case '[':
+      expect_key = ++depth == 1;
+      break;
+    case '}':
+    case ']':
+      if (--depth == 0) {
+        layout.close = i;
+        return true;
+      }
+      break;
+    case ',':
+      expect_key = depth == 1;
+      break;
+    default:
+      break;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+ScriptDecoder::ScriptDecoder() = default;
+
+ScriptDecoder::~ScriptDecoder() {
+  if (stream_) {
+    inflateEnd(stream_.get());
+  }
+}
+
+bool ScriptDecoder::Inflate(std::string_view encoded,
+                            std::string& out,
+                            size_t size_hint) {
+  std::string_view text;
+  if (!Inflate(encoded, text, size_hint)) {
+    return false;
+  }
+  out.assign(text.data(), text.size());
+  return true;
+}
+
+bool ScriptDecoder::Inflate(std::string_view encoded,
+                            std::string_view& out,
+                            size_t size_hint) {
+  if (!DecodeBase64(encoded, compressed_)) {
+    // Line breaks are the only characters cpp-base64 skips; retry without.
+    std::string stripped;
+    for (char c : encoded) {
+      if (c != '\n' && c != '\r') {
+        stripped += c;
+      }
+    }
+    if (stripped.size() == encoded.size() ||
+        !DecodeBase64(stripped, compressed_)) {
+      LOG(ERROR) << "Script is not valid base64";
+      return false;
+    }
+  }
+  if (compressed_.empty()) {
+    LOG(ERROR) << "Base64 decoded script is empty";
+    return false;
+  }
+
+  if (!stream_) {
+    stream_ = std::make_unique<z_stream>();
+    if (inflateInit(stream_.get()) != Z_OK) {
       LOG(ERROR) << "Failed to initialize zlib";
+      stream_.reset();
       return false;
     }
+  } else if (inflateReset(stream_.get()) != Z_OK) {
+    LOG(ERROR) << "Failed to reset zlib";
+    return false;
+  }
 
-    std::vector<uint8_t> decompressed;
-    std::array<uint8_t, 32768> buffer{};
+  // Inflate into text_, doubling it whenever it fills up. text_ is never
+  // shrunk to the inflated size, so growing it again (and zero-filling the
+  // new part) only happens when a script is larger than any before it.
+  z_stream& stream = *stream_;
+  stream.next_in   = reinterpret_cast<Bytef*>(compressed_.data());
+  stream.avail_in  = static_cast<uInt>(compressed_.size());
+  size_t target = std::max({size_hint, compressed_.size() * 4, kMinOutputSize});
+  if (text_.size() < target) {
+    text_.resize(target);
+  }
 
-    int ret;
-    do {
-      stream.next_out  = buffer.data();
-      stream.avail_out = static_cast<uInt>(buffer.size());
+  size_t produced = 0;
+  int ret;
+  do {
+    if (produced == text_.size()) {
+      text_.resize(text_.size() * 2);
+    }
+    stream.next_out  = reinterpret_cast<Bytef*>(text_.data() + produced);
+    stream.avail_out = static_cast<uInt>(text_.size() - produced);
 
-      ret = inflate(&stream, Z_NO_FLUSH);
-      if (ret != Z_OK && ret != Z_STREAM_END) {
-        LOG(ERROR) << "zlib decompression error: " << ret;
-        inflateEnd(&stream);
-        return false;
-      }
+    ret      = inflate(&stream, Z_NO_FLUSH);
+    produced = text_.size() - stream.avail_out;
+    if (ret != Z_OK && ret != Z_STREAM_END) {
+      LOG(ERROR) << "zlib decompression error: " << ret;
+      return false;
+    }
+  } while (ret != Z_STREAM_END);
 
-      size_t produced = buffer.size() - stream.avail_out;
-      decompressed.insert(
-          decompressed.end(), buffer.begin(), buffer.begin() + produced);
-    } while (ret != Z_STREAM_END);
+  out = std::string_view(text_.data(), produced);
+  return true;
+}
 
-    inflateEnd(&stream);
+bool ScriptDecoder::Decode(std::string_view encoded,
+                           json& out,
+                           size_t size_hint) {
+  std::string_view text;
+  if (!Inflate(encoded, text, size_hint)) {
+    return false;
+  }
 
-    std::string decompressed_str(decompressed.begin(), decompressed.end());
-    out = json::parse(decompressed_str);
+  try {
+    out = json::parse(text);
     return true;
   } catch (const std::exception& e) {
     LOG(ERROR) << "Failed to decode script: " << e.what();
@@ -60,5 +250,138 @@ bool DecodeScriptToJson(const std::string& encoded, json& out) {
   }
 }
 
+bool DecodeScriptToJson(const std::string& encoded, json& out) {
+  if (encoded == "<Decoded>") {
+    return false;
+  }
+
+  thread_local ScriptDecoder decoder;
+  return decoder.Decode(encoded, out);
+}
+
+bool EncodeScriptFromJson(const json& script, std::string& encoded) {
+  std::string plain = script.dump();
+
+  uLongf compressed_size = compressBound(static_cast<uLong>(plain.size()));
+  std::string compressed(compressed_size, '\0');
+
+  int ret = compress2(reinterpret_cast<Bytef*>(compressed.data()),
+                      &compressed_size,
+                      reinterpret_cast<const Bytef*>(plain.data()),
+                      static_cast<uLong>(plain.size()),
+                      Z_BEST_COMPRESSION);
+  if (ret != Z_OK) {
+    LOG(ERROR) << "zlib compression error: " << ret;
+    return false;
+  }
+
+  compressed.resize(compressed_size);
+  encoded = base64_encode(compressed);
+  return true;
+}
+
+bool ParseScriptMode(const std::string& name, ScriptMode& mode) {
+  if (name == "decoded") {
+    mode = ScriptMode::kDecoded;
+  } else if (name == "compressed") {
+    mode = ScriptMode::kCompressed;
+  } else {
+    LOG(ERROR) << "Unknown script mode: " << name;
+    return false;
+  }
+  return true;
+}
+
+bool ExpandRecordScript(json& record) {
+  if (!record.contains("script") || !record["script"].is_string()) {
+    return false;
+  }
+
+  const std::string& script = record["script"].get_ref<const std::string&>();
+  if (script == "<Decoded>") {
+    return record.contains("step");
+  }
+
+  json script_json;
+  if (!DecodeScriptToJson(script, script_json)) {
+    return false;
+  }
+
+  record["step"]   = std::move(script_json);
+  record["script"] = "<Decoded>";
+  return true;
+}
+
+bool CompressRecordScript(json& record) {
+  if (!record.contains("script") || !record["script"].is_string()) {
+    return false;
+  }
+
+  if (record["script"].get_ref<const std::string&>() != "<Decoded>") {
+    return true;
+  }
+
+  if (!record.contains("step")) {
+    return false;
+  }
+
+  std::string encoded;
+  if (!EncodeScriptFromJson(record["step"], encoded)) {
+    return false;
+  }
+
+  record["script"] = encoded;
+  record.erase("step");
+  return true;
+}
+
+bool ApplyScriptMode(json& record, ScriptMode mode) {
+  return mode == ScriptMode::kCompressed ? CompressRecordScript(record)
+                                         : ExpandRecordScript(record);
+}
+
+bool ApplyScriptModeToText(std::string& record, ScriptMode mode) {
+  // accept() validates without building anything, so a malformed body is
+  // still rejected as it would be by parsing it.
+  RecordLayout layout;
+  if (!json::accept(record) || !ScanRecordText(record, layout) ||
+      layout.script_begin == std::string_view::npos ||
+      layout.script_escaped) {
+    return false;
+  }
+
+  std::string_view script(record);
+  script = script.substr(layout.script_begin,
+                         layout.script_end - layout.script_begin);
+  if (script == "<Decoded>") {
+    return mode == ScriptMode::kDecoded && layout.has_step;
+  }
+  if (mode == ScriptMode::kCompressed) {
+    return true;
+  }
+  if (layout.has_step) {
+    return false;
+  }
+
+  thread_local ScriptDecoder decoder;
+  thread_local std::string step;
+  if (!decoder.Inflate(script, step) || !json::accept(step)) {
+    return false;
+  }
+
+  // The object's other members are copied through untouched; "step" is
+  // appended as the last member.
+  std::string out;
+  out.reserve(record.size() + step.size() + 24);
+  out.append(record, 0, layout.script_begin);
+  out += "<Decoded>";
+  out.append(record, layout.script_end, layout.close - layout.script_end);
+  out += ",\"step\":";
+  out += step;
+  out += '}';
+  record.swap(out);
+  return true;
+}
+
 } // namespace utils
 } // namespace tziakcha
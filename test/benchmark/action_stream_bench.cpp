@@ -0,0 +1,144 @@
+#include "analyzer/action_stream.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cxxopts.hpp>
+#include <functional>
+#include <glog/logging.h>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using tziakcha::analyzer::Action;
+using tziakcha::analyzer::ActionColumns;
+
+namespace {
+
+// Action lists shaped like the served ones: mostly draws and discards of
+// one tile every few seconds.
+std::vector<std::vector<Action>> SyntheticRecords(size_t count,
+                                                  size_t actions) {
+  std::mt19937 engine(42);
+  std::uniform_int_distribution<int> tile(0, 143);
+  std::uniform_int_distribution<int> kind(0, 9);
+  std::uniform_int_distribution<int> seat(0, 3);
+  std::uniform_int_distribution<int> step(200, 12000);
+
+  std::vector<std::vector<Action>> records(count);
+  for (auto& record : records) {
+    int time = 0;
+    for (size_t j = 0; j < actions; ++j) {
+      time += step(engine);
+      record.push_back({seat(engine), kind(engine), tile(engine), time});
+    }
+  }
+  return records;
+}
+
+double Measure(int iterations, const std::function<void()>& pass) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    pass();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  google::InitGoogleLogging(argv[0]);
+  FLAGS_logtostderr = true;
+
+  cxxopts::Options options("action_stream_bench",
+                           "Compare packed action decoding and scans");
+  options.add_options()(
+      "n,records",
+      "Number of records",
+      cxxopts::value<size_t>()->default_value("2000"))(
+      "actions",
+      "Actions per record",
+      cxxopts::value<size_t>()->default_value("400"))(
+      "i,iterations",
+      "Passes over the records per variant",
+      cxxopts::value<int>()->default_value("20"))("h,help", "Print help");
+
+  auto result = options.parse(argc, argv);
+  if (result.count("help")) {
+    std::cout << options.help() << std::endl;
+    return 0;
+  }
+
+  int iterations = std::max(result["iterations"].as<int>(), 1);
+  auto records   = SyntheticRecords(result["records"].as<size_t>(),
+                                  result["actions"].as<size_t>());
+
+  std::vector<std::string> packed(records.size());
+  size_t total_actions = 0;
+  size_t packed_bytes  = 0;
+  for (size_t i = 0; i < records.size(); ++i) {
+    tziakcha::analyzer::PackActions(records[i], packed[i]);
+    total_actions += records[i].size();
+    packed_bytes += packed[i].size();
+  }
+  if (total_actions == 0) {
+    std::cerr << "Error: No actions to decode" << std::endl;
+    return 1;
+  }
+
+  // Per-seat thinking time, the scan player stats runs over every record.
+  std::array<int64_t, 4> seat_ms{};
+  std::vector<Action> rows;
+  ActionColumns columns;
+
+  std::vector<std::pair<std::string, double>> results;
+  results.emplace_back("unpack to Action rows", Measure(iterations, [&] {
+    for (const auto& stream : packed) {
+      tziakcha::analyzer::UnpackActions(stream, rows);
+    }
+  }));
+  results.emplace_back("unpack to columns", Measure(iterations, [&] {
+    for (const auto& stream : packed) {
+      tziakcha::analyzer::UnpackActions(stream, columns);
+    }
+  }));
+  results.emplace_back("unpack + scan rows", Measure(iterations, [&] {
+    for (const auto& stream : packed) {
+      tziakcha::analyzer::UnpackActions(stream, rows);
+      int prev = 0;
+      for (const auto& action : rows) {
+        seat_ms[action.player_idx] += action.time_ms - prev;
+        prev = action.time_ms;
+      }
+    }
+  }));
+  results.emplace_back("unpack + scan columns", Measure(iterations, [&] {
+    for (const auto& stream : packed) {
+      tziakcha::analyzer::UnpackActions(stream, columns);
+      int prev = 0;
+      for (size_t i = 0; i < columns.size(); ++i) {
+        seat_ms[columns.player[i]] += columns.time_ms[i] - prev;
+        prev = columns.time_ms[i];
+      }
+    }
+  }));
+
+  double actions_run = static_cast<double>(total_actions) * iterations;
+  std::cout << "Records: " << records.size() << ", actions: " << total_actions
+            << ", packed " << packed_bytes / 1024 << " KiB ("
+            << std::fixed << std::setprecision(2)
+            << static_cast<double>(packed_bytes) / total_actions
+            << " bytes/action vs " << sizeof(Action) << " as Action)\n\n";
+  std::cout << std::setprecision(1);
+  std::cout << std::left << std::setw(28) << "Variant" << std::right
+            << std::setw(16) << "M actions/s" << "\n";
+  for (const auto& [name, seconds] : results) {
+    std::cout << std::left << std::setw(28) << name << std::right
+              << std::setw(16) << actions_run / seconds / 1e6 << "\n";
+  }
+  // Keeps the scans from being optimized away.
+  LOG(INFO) << "Seat 0 total: " << seat_ms[0];
+  return 0;
+}
@@ -0,0 +1,225 @@
+#include "storage/storage_factory.h"
+#include "utils/script_decoder.h"
+#include <algorithm>
+#include <array>
+#include <base64.h>
+#include <chrono>
+#include <cxxopts.hpp>
+#include <functional>
+#include <glog/logging.h>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <zlib.h>
+
+using json = nlohmann::json;
+
+namespace {
+
+// The decoder as it was before ScriptDecoder: a fresh base64 string and
+// zlib stream per call, a bounce buffer and two copies of the output.
+bool LegacyDecodeScriptToJson(const std::string& encoded, json& out) {
+  try {
+    std::string decoded = base64_decode(encoded, true);
+    if (decoded.empty()) {
+      return false;
+    }
+
+    z_stream stream{};
+    stream.next_in  = reinterpret_cast<Bytef*>(decoded.data());
+    stream.avail_in = static_cast<uInt>(decoded.size());
+    if (inflateInit(&stream) != Z_OK) {
+      return false;
+    }
+
+    std::vector<uint8_t> decompressed;
+    std::array<uint8_t, 32768> buffer{};
+    int ret;
+    do {
+      stream.next_out  = buffer.data();
+      stream.avail_out = static_cast<uInt>(buffer.size());
+      ret              = inflate(&stream, Z_NO_FLUSH);
+      if (ret != Z_OK && ret != Z_STREAM_END) {
+        inflateEnd(&stream);
+        return false;
+      }
+      size_t produced = buffer.size() - stream.avail_out;
+      decompressed.insert(
+          decompressed.end(), buffer.begin(), buffer.begin() + produced);
+    } while (ret != Z_STREAM_END);
+    inflateEnd(&stream);
+
+    std::string decompressed_str(decompressed.begin(), decompressed.end());
+    out = json::parse(decompressed_str);
+    return true;
+  } catch (const std::exception&) {
+    return false;
+  }
+}
+
+// Scripts shaped like the served ones: an action list of small integer
+// tuples plus some metadata, which compresses at a similar ratio.
+std::vector<std::string> SyntheticScripts(size_t count, size_t actions) {
+  std::mt19937 engine(42);
+  std::uniform_int_distribution<int> tile(0, 143);
+  std::uniform_int_distribution<int> kind(0, 12);
+  std::uniform_int_distribution<int> seat(0, 3);
+
+  std::vector<std::string> scripts;
+  scripts.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    json script;
+    script["g"] = {{"w", seat(engine)}, {"r", static_cast<int>(i % 16)}};
+    script["a"] = json::array();
+    for (size_t j = 0; j < actions; ++j) {
+      script["a"].push_back(
+          {seat(engine), kind(engine), tile(engine), static_cast<int>(j)});
+    }
+
+    std::string encoded;
+    if (tziakcha::utils::EncodeScriptFromJson(script, encoded)) {
+      scripts.push_back(std::move(encoded));
+    }
+  }
+  return scripts;
+}
+
+std::vector<std::string> StoredScripts(const std::string& dir, size_t limit) {
+  std::vector<std::string> scripts;
+  auto storage = tziakcha::storage::OpenStorage(
+      dir,
+      tziakcha::storage::StorageBackend::kAuto,
+      tziakcha::storage::Encoding::kJson,
+      tziakcha::storage::OpenMode::kReadOnly);
+  storage->for_each_record(
+      "",
+      [&](const std::string&, const tziakcha::storage::RecordView& view) {
+        json record;
+        if (tziakcha::storage::DecodeDocument(view.data(), record) &&
+            record.is_object() && record.contains("script") &&
+            record["script"].is_string() && record["script"] != "<Decoded>") {
+          scripts.push_back(record["script"].get<std::string>());
+        }
+        return scripts.size() < limit;
+      });
+  return scripts;
+}
+
+struct Result {
+  double seconds  = 0;
+  size_t failures = 0;
+};
+
+Result Measure(const std::vector<std::string>& scripts,
+               int iterations,
+               const std::function<bool(const std::string&)>& decode) {
+  Result result;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    for (const auto& script : scripts) {
+      if (!decode(script)) {
+        result.failures++;
+      }
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  result.seconds = elapsed.count();
+  return result;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  google::InitGoogleLogging(argv[0]);
+  FLAGS_logtostderr = true;
+
+  cxxopts::Options options("script_decoder_bench",
+                           "Compare script decoding throughput");
+  options.add_options()(
+      "d,data-dir",
+      "Read scripts from stored records in this directory instead of "
+      "generating them",
+      cxxopts::value<std::string>()->default_value(""))(
+      "n,records",
+      "Number of scripts",
+      cxxopts::value<size_t>()->default_value("2000"))(
+      "actions",
+      "Actions per generated script",
+      cxxopts::value<size_t>()->default_value("400"))(
+      "i,iterations",
+      "Passes over the scripts per decoder",
+      cxxopts::value<int>()->default_value("5"))("h,help", "Print help");
+
+  auto result = options.parse(argc, argv);
+  if (result.count("help")) {
+    std::cout << options.help() << std::endl;
+    return 0;
+  }
+
+  std::string data_dir = result["data-dir"].as<std::string>();
+  size_t count         = result["records"].as<size_t>();
+  int iterations       = std::max(result["iterations"].as<int>(), 1);
+
+  std::vector<std::string> scripts =
+      data_dir.empty()
+          ? SyntheticScripts(count, result["actions"].as<size_t>())
+          : StoredScripts(data_dir, count);
+  if (scripts.empty()) {
+    std::cerr << "Error: No scripts to decode" << std::endl;
+    return 1;
+  }
+
+  size_t encoded_bytes  = 0;
+  size_t inflated_bytes = 0;
+  tziakcha::utils::ScriptDecoder decoder;
+  std::string text;
+  for (const auto& script : scripts) {
+    encoded_bytes += script.size();
+    if (decoder.Inflate(script, text)) {
+      inflated_bytes += text.size();
+    }
+  }
+
+  json out;
+  std::vector<std::pair<std::string, Result>> results;
+  results.emplace_back(
+      "legacy DecodeScriptToJson",
+      Measure(scripts, iterations, [&](const std::string& script) {
+        return LegacyDecodeScriptToJson(script, out);
+      }));
+  results.emplace_back(
+      "ScriptDecoder::Decode",
+      Measure(scripts, iterations, [&](const std::string& script) {
+        return decoder.Decode(script, out);
+      }));
+  results.emplace_back(
+      "ScriptDecoder::Inflate (no parse)",
+      Measure(scripts, iterations, [&](const std::string& script) {
+        std::string_view inflated;
+        return decoder.Inflate(script, inflated);
+      }));
+
+  double input_mb  = static_cast<double>(encoded_bytes) * iterations / 1e6;
+  double output_mb = static_cast<double>(inflated_bytes) * iterations / 1e6;
+  std::cout << "Scripts: " << scripts.size() << ", encoded "
+            << encoded_bytes / 1024 << " KiB, inflated "
+            << inflated_bytes / 1024 << " KiB, " << iterations
+            << " iterations\n\n";
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << std::left << std::setw(36) << "Decoder" << std::right
+            << std::setw(12) << "in MB/s" << std::setw(12) << "out MB/s"
+            << std::setw(10) << "speedup" << "\n";
+  for (const auto& [name, measured] : results) {
+    std::cout << std::left << std::setw(36) << name << std::right
+              << std::setw(12) << input_mb / measured.seconds << std::setw(12)
+              << output_mb / measured.seconds << std::setw(9)
+              << results.front().second.seconds / measured.seconds << "x";
+    if (measured.failures > 0) {
+      std::cout << "  (" << measured.failures << " failures)";
+    }
+    std::cout << "\n";
+  }
+  return 0;
+}
@@ -0,0 +1,125 @@
+#include "config/fetcher_config.h"
+#include "replay_server.h"
+#include <algorithm>
+#include <csignal>
+#include <cxxopts.hpp>
+#include <filesystem>
+#include <glog/logging.h>
+#include <httplib.h>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+using tziakcha::mock::ReplayOptions;
+using tziakcha::mock::ReplayServer;
+
+namespace {
+
+httplib::Server* g_server = nullptr;
+
+void HandleSignal(int) {
+  if (g_server) {
+    g_server->stop();
+  }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  google::InitGoogleLogging(argv[0]);
+  FLAGS_logtostderr = true;
+
+  cxxopts::Options options(
+      "mock_server", "Replay captured tziakcha responses for fetcher tests");
+  options.add_options()(
+      "c,config",
+      "Fetcher configuration file providing the endpoint paths",
+      cxxopts::value<std::string>()->default_value(
+          "config/fetcher_config.json"))(
+      "d,dir",
+      "Directory of captured responses (history/, game/, record/)",
+      cxxopts::value<std::string>()->default_value("data/mock"))(
+      "host",
+      "Address to listen on",
+      cxxopts::value<std::string>()->default_value("127.0.0.1"))(
+      "p,port",
+      "Port to listen on",
+      cxxopts::value<int>()->default_value("8080"))(
+      "threads",
+      "Request handler threads",
+      cxxopts::value<int>()->default_value("16"))(
+      "latency-ms",
+      "Delay added to every response",
+      cxxopts::value<int>()->default_value("0"))(
+      "jitter-ms",
+      "Random extra delay of up to this many milliseconds",
+      cxxopts::value<int>()->default_value("0"))(
+      "error-rate",
+      "Fraction of requests answered with --error-status",
+      cxxopts::value<double>()->default_value("0"))(
+      "error-status",
+      "HTTP status of injected errors",
+      cxxopts::value<int>()->default_value("503"))(
+      "max-rps",
+      "Requests per second served before answering 429 (0 = unlimited)",
+      cxxopts::value<double>()->default_value("0"))(
+      "seed",
+      "Seed for latency jitter and error injection",
+      cxxopts::value<unsigned int>()->default_value("1"))(
+      "h,help", "Print help");
+
+  auto result = options.parse(argc, argv);
+  if (result.count("help")) {
+    std::cout << options.help() << std::endl;
+    return 0;
+  }
+
+  auto& config            = tziakcha::config::FetcherConfig::instance();
+  std::string config_file = result["config"].as<std::string>();
+  if (!config.load(config_file)) {
+    std::cerr << "Error: Failed to load configuration file: " << config_file
+              << std::endl;
+    return 1;
+  }
+
+  ReplayOptions replay;
+  replay.dir          = result["dir"].as<std::string>();
+  replay.latency_ms   = result["latency-ms"].as<int>();
+  replay.jitter_ms    = result["jitter-ms"].as<int>();
+  replay.error_rate   = result["error-rate"].as<double>();
+  replay.error_status = result["error-status"].as<int>();
+  replay.max_rps      = result["max-rps"].as<double>();
+  replay.seed         = result["seed"].as<unsigned int>();
+
+  if (!fs::is_directory(replay.dir)) {
+    std::cerr << "Error: Response directory not found: " << replay.dir
+              << std::endl;
+    return 1;
+  }
+
+  ReplayServer replay_server(replay);
+  httplib::Server server;
+
+  size_t threads = std::max(result["threads"].as<int>(), 1);
+  server.new_task_queue = [threads] {
+    return new httplib::ThreadPool(threads);
+  };
+
+  replay_server.AddRoutes(server);
+
+  g_server = &server;
+  std::signal(SIGINT, HandleSignal);
+  std::signal(SIGTERM, HandleSignal);
+
+  std::string host = result["host"].as<std::string>();
+  int port         = result["port"].as<int>();
+  LOG(INFO) << "Serving " << replay.dir << " on " << host << ":" << port;
+  if (!server.listen(host, port)) {
+    std::cerr << "Error: Failed to listen on " << host << ":" << port
+              << std::endl;
+    return 1;
+  }
+
+  replay_server.PrintStats();
+  return 0;
+}
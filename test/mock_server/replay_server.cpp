@@ -0,0 +1,140 @@
+#include "replay_server.h"
+#include "config/fetcher_config.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <httplib.h>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace tziakcha {
+namespace mock {
+
+namespace {
+
+// Value of name in a "name=value" request body.
+std::string FormValue(const std::string& body, const std::string& name) {
+  std::string prefix = name + "=";
+  if (body.compare(0, prefix.size(), prefix) != 0) {
+    return "";
+  }
+  return body.substr(prefix.size(), body.find('&') - prefix.size());
+}
+
+} // namespace
+
+ReplayServer::ReplayServer(const ReplayOptions& options)
+    : options_(options),
+      limiter_(options.max_rps, std::max(options.max_rps, 1.0)),
+      engine_(options.seed) {}
+
+void ReplayServer::Serve(const std::string& kind,
+                         const std::string& name,
+                         httplib::Response& res) {
+  requests_++;
+
+  if (!limiter_.try_acquire()) {
+    throttled_++;
+    res.status = 429;
+    return;
+  }
+
+  int delay_ms = 0;
+  bool inject  = false;
+  {
+    std::lock_guard<std::mutex> lock(engine_mutex_);
+    delay_ms = options_.latency_ms;
+    if (options_.jitter_ms > 0) {
+      delay_ms +=
+          std::uniform_int_distribution<int>(0, options_.jitter_ms)(engine_);
+    }
+    inject = std::uniform_real_distribution<double>(0, 1)(engine_) <
+             options_.error_rate;
+  }
+  if (delay_ms > 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+  }
+
+  if (inject) {
+    injected_errors_++;
+    res.status = options_.error_status;
+    return;
+  }
+
+  std::string body;
+  if (!Load(kind, name, body)) {
+    if (kind == "history") {
+      res.set_content(R"({"games":[]})", "application/json");
+      return;
+    }
+    not_found_++;
+    res.status = 404;
+    return;
+  }
+  served_++;
+  res.set_content(body, "application/json");
+}
+
+void ReplayServer::AddRoutes(httplib::Server& server) {
+  auto& config = config::FetcherConfig::instance();
+
+  server.Post(config.get_history_endpoint(),
+              [this](const httplib::Request& req, httplib::Response& res) {
+                std::string page = FormValue(req.body, "p");
+                Serve("history", page.empty() ? "0" : page, res);
+              });
+  // The session fetcher appends "/?id=<session>" to the game endpoint.
+  server.Post(config.get_game_endpoint() + "/",
+              [this](const httplib::Request& req, httplib::Response& res) {
+                Serve("game", req.get_param_value("id"), res);
+              });
+  server.Post(config.get_record_endpoint(),
+              [this](const httplib::Request& req, httplib::Response& res) {
+                Serve("record", FormValue(req.body, "id"), res);
+              });
+}
+
+void ReplayServer::PrintStats() const {
+  std::cout << "\n=== Mock Server Stats ===\n";
+  std::cout << "Requests: " << requests_ << "\n";
+  std::cout << "Served: " << served_ << "\n";
+  std::cout << "Not found: " << not_found_ << "\n";
+  std::cout << "Throttled (429): " << throttled_ << "\n";
+  std::cout << "Injected errors: " << injected_errors_ << "\n";
+}
+
+bool ReplayServer::Load(const std::string& kind,
+                        const std::string& name,
+                        std::string& body) {
+  if (name.empty() || name.find('/') != std::string::npos ||
+      name.find("..") != std::string::npos) {
+    return false;
+  }
+
+  std::filesystem::path path = options_.dir / kind / (name + ".json");
+  std::string key            = path.string();
+  {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    auto it = cache_.find(key);
+    if (it != cache_.end()) {
+      body = it->second;
+      return true;
+    }
+  }
+
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+  std::ostringstream content;
+  content << file.rdbuf();
+  body = content.str();
+
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  cache_.emplace(key, body);
+  return true;
+}
+
+} // namespace mock
+} // namespace tziakcha
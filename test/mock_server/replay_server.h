@@ -0,0 +1,74 @@
+#pragma once
+
+#include "fetcher/fetch_pool.h"
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+namespace httplib {
+struct Response;
+class Server;
+} // namespace httplib
+
+namespace tziakcha {
+namespace mock {
+
+// Serves captured responses for the history, game and record endpoints:
+//   <dir>/history/<page>.json   body of the history request "p=<page>"
+//   <dir>/game/<session>.json   game request for "?id=<session>"
+//   <dir>/record/<record>.json  body of the record request "id=<record>"
+// History pages past the last file return an empty game list, as the real
+// server does; other missing files return 404.
+struct ReplayOptions {
+  std::filesystem::path dir;
+  int latency_ms    = 0;
+  int jitter_ms     = 0;
+  double error_rate = 0;
+  int error_status  = 503;
+  double max_rps    = 0;
+  unsigned int seed = 1;
+};
+
+class ReplayServer {
+public:
+  explicit ReplayServer(const ReplayOptions& options);
+
+  void Serve(const std::string& kind,
+             const std::string& name,
+             httplib::Response& res);
+
+  // Routes the endpoints of the loaded FetcherConfig to Serve.
+  void AddRoutes(httplib::Server& server);
+
+  uint64_t requests() const { return requests_; }
+  void PrintStats() const;
+
+private:
+  ReplayOptions options_;
+  fetcher::RateLimiter limiter_;
+
+  std::mutex engine_mutex_;
+  std::mt19937 engine_;
+
+  // Responses are read once and then served from memory, so disk speed
+  // does not show up in the measurements.
+  std::mutex cache_mutex_;
+  std::unordered_map<std::string, std::string> cache_;
+
+  std::atomic<uint64_t> requests_{0};
+  std::atomic<uint64_t> served_{0};
+  std::atomic<uint64_t> not_found_{0};
+  std::atomic<uint64_t> throttled_{0};
+  std::atomic<uint64_t> injected_errors_{0};
+
+  bool Load(const std::string& kind,
+            const std::string& name,
+            std::string& body);
+};
+
+} // namespace mock
+} // namespace tziakcha
@@ -1,6 +1,7 @@
 #include "analyzer/core.h"
 #include "analyzer/record_parser.h"
 #include "base/mahjong_constants.h"
+#include "storage/prefetch_reader.h"
 #include <nlohmann/json.hpp>
 #include <glog/logging.h>
 #include <fstream>
@@ -81,28 +82,37 @@ private:
   }
 
   void ProcessAllRecords() {
-    for (size_t i = 0; i < record_files_.size(); ++i) {
-      const auto& filepath  = record_files_[i];
-      std::string record_id = fs::path(filepath).stem().string();
-
-      std::cout << "[" << std::setw(4) << (i + 1) << "/" << std::setw(4)
-                << record_files_.size() << "] " << record_id << " ... ";
-      std::cout.flush();
-
-      TestResult result = ProcessSingleRecord(filepath, record_id);
-      results_.push_back(result);
+    tziakcha::storage::PrefetchReader reader;
+    reader.read(
+        record_files_,
+        [this](size_t i, bool ok, const tziakcha::storage::RecordView& view) {
+          ProcessLoadedRecord(i, ok, view.data());
+          return true;
+        });
+  }
 
-      if (result.IsDraw()) {
-        std::cout << "○ DRAW (荒庄)\n";
-      } else if (result.IsMatch()) {
-        std::cout << "✓ PASS\n";
-        PrintFanComparison(result);
-      } else if (result.success) {
-        std::cout << "✗ MISMATCH\n";
-        PrintFanComparison(result);
-      } else {
-        std::cout << "✗ ERROR: " << result.error_message << "\n";
-      }
+  void ProcessLoadedRecord(size_t i, bool readable, std::string_view content) {
+    const auto& filepath  = record_files_[i];
+    std::string record_id = fs::path(filepath).stem().string();
+
+    std::cout << "[" << std::setw(4) << (i + 1) << "/" << std::setw(4)
+              << record_files_.size() << "] " << record_id << " ... ";
+    std::cout.flush();
+
+    TestResult result =
+        ProcessSingleRecord(filepath, record_id, readable, content);
+    results_.push_back(result);
+
+    if (result.IsDraw()) {
+      std::cout << "○ DRAW (荒庄)\n";
+    } else if (result.IsMatch()) {
+      std::cout << "✓ PASS\n";
+      PrintFanComparison(result);
+    } else if (result.success) {
+      std::cout << "✗ MISMATCH\n";
+      PrintFanComparison(result);
+    } else {
+      std::cout << "✗ ERROR: " << result.error_message << "\n";
     }
   }
 
@@ -127,7 +137,9 @@ private:
   }
 
   TestResult ProcessSingleRecord(const std::string& filepath,
-                                 const std::string& record_id) {
+                                 const std::string& record_id,
+                                 bool readable,
+                                 std::string_view content) {
     TestResult result;
     result.record_id      = record_id;
     result.filepath       = filepath;
@@ -137,14 +149,12 @@ private:
     result.is_draw        = false;
 
     try {
-      std::ifstream file(filepath);
-      if (!file.is_open()) {
+      if (!readable) {
         result.error_message = "Cannot open file";
         return result;
       }
 
-      std::string record_json_str((std::istreambuf_iterator<char>(file)),
-                                  std::istreambuf_iterator<char>());
+      std::string record_json_str(content);
 
       if (record_json_str.empty()) {
         result.error_message = "Empty file";
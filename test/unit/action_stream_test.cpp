@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+#include <random>
+#include "analyzer/action_stream.h"
+
+using tziakcha::analyzer::Action;
+using tziakcha::analyzer::ActionColumns;
+using tziakcha::analyzer::PackActions;
+using tziakcha::analyzer::UnpackActions;
+
+namespace {
+
+std::vector<Action> RandomActions(size_t count, unsigned int seed) {
+  std::mt19937 engine(seed);
+  std::uniform_int_distribution<int> seat(0, 3);
+  std::uniform_int_distribution<int> kind(0, 15);
+  std::uniform_int_distribution<int> data(0, 0xFFFF);
+  std::uniform_int_distribution<int> step(0, 30000);
+
+  std::vector<Action> actions;
+  int time = 0;
+  for (size_t i = 0; i < count; ++i) {
+    time += step(engine);
+    actions.push_back({seat(engine), kind(engine), data(engine), time});
+  }
+  return actions;
+}
+
+void ExpectSameActions(const std::vector<Action>& expected,
+                       const ActionColumns& columns) {
+  ASSERT_EQ(columns.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(columns.player[i], expected[i].player_idx) << i;
+    EXPECT_EQ(columns.type[i], expected[i].action_type) << i;
+    EXPECT_EQ(columns.data[i], expected[i].data) << i;
+    EXPECT_EQ(columns.time_ms[i], expected[i].time_ms) << i;
+  }
+}
+
+} // namespace
+
+TEST(ActionStreamTest, RoundTripsIntoColumnsAndRows) {
+  auto actions = RandomActions(500, 7);
+  std::string packed;
+  PackActions(actions, packed);
+  EXPECT_LE(packed.size(), 2 + actions.size() * 8);
+
+  ActionColumns columns;
+  ASSERT_TRUE(UnpackActions(packed, columns));
+  ExpectSameActions(actions, columns);
+
+  std::vector<Action> rows;
+  ASSERT_TRUE(UnpackActions(packed, rows));
+  ASSERT_EQ(rows.size(), actions.size());
+  for (size_t i = 0; i < rows.size(); ++i) {
+    Action column_row = columns[i];
+    EXPECT_EQ(rows[i].player_idx, actions[i].player_idx) << i;
+    EXPECT_EQ(rows[i].action_type, actions[i].action_type) << i;
+    EXPECT_EQ(rows[i].data, actions[i].data) << i;
+    EXPECT_EQ(rows[i].time_ms, actions[i].time_ms) << i;
+    EXPECT_EQ(column_row.player_idx, actions[i].player_idx) << i;
+    EXPECT_EQ(column_row.action_type, actions[i].action_type) << i;
+    EXPECT_EQ(column_row.data, actions[i].data) << i;
+    EXPECT_EQ(column_row.time_ms, actions[i].time_ms) << i;
+  }
+}
+
+TEST(ActionStreamTest, KeepsOutOfOrderAndLargeValues) {
+  std::vector<Action> actions = {{0, 0, 0, 0},
+                                 {1, 2, 0x1234, 5000},
+                                 {2, 7, 0, 4000},
+                                 {3, 15, -1, -20},
+                                 {0, 6, 0x7FFFFFFF, 0x7FFFFFFF}};
+  std::string packed;
+  PackActions(actions, packed);
+
+  ActionColumns columns;
+  ASSERT_TRUE(UnpackActions(packed, columns));
+  ExpectSameActions(actions, columns);
+
+  // Typical small values pack into a few bytes each.
+  PackActions({{1, 2, 17, 800}}, packed);
+  EXPECT_EQ(packed.size(), 1u + 4u);
+}
+
+TEST(ActionStreamTest, RejectsDamagedStreams) {
+  auto actions = RandomActions(20, 3);
+  std::string packed;
+  PackActions(actions, packed);
+
+  ActionColumns columns;
+  EXPECT_FALSE(UnpackActions(packed.substr(0, packed.size() - 1), columns));
+  EXPECT_EQ(columns.size(), 0u);
+  EXPECT_FALSE(UnpackActions(packed + '\0', columns));
+  EXPECT_FALSE(UnpackActions("\xff\xff\xff\xff\x0f", columns));
+
+  // A fifth varint byte may only carry the top four of 32 bits.
+  std::string prefix = "\x01\x12";
+  EXPECT_TRUE(
+      UnpackActions(prefix + "\xff\xff\xff\xff\x0f" + '\0', columns));
+  EXPECT_EQ(columns.data[0], -1);
+  EXPECT_FALSE(
+      UnpackActions(prefix + "\xff\xff\xff\xff\x1f" + '\0', columns));
+  EXPECT_EQ(columns.size(), 0u);
+
+  std::vector<Action> rows;
+  EXPECT_TRUE(UnpackActions(std::string(1, '\0'), rows));
+  EXPECT_TRUE(rows.empty());
+  EXPECT_FALSE(UnpackActions("", rows));
+}
@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <nlohmann/json.hpp>
+#include "storage/caching_storage.h"
+#include "storage/filesystem_storage.h"
+
+using json   = nlohmann::json;
+namespace fs = std::filesystem;
+
+class CachingStorageTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    test_dir_ = fs::temp_directory_path() / "tziakcha_caching_test";
+    if (fs::exists(test_dir_)) {
+      fs::remove_all(test_dir_);
+    }
+    fs::create_directories(test_dir_);
+
+    inner_ = std::make_shared<tziakcha::storage::FileSystemStorage>(
+        test_dir_.string());
+  }
+
+  void TearDown() override {
+    if (fs::exists(test_dir_)) {
+      fs::remove_all(test_dir_);
+    }
+  }
+
+  fs::path test_dir_;
+  std::shared_ptr<tziakcha::storage::FileSystemStorage> inner_;
+};
+
+TEST_F(CachingStorageTest, RepeatedLoadsHitCache) {
+  EXPECT_TRUE(inner_->save_json("a", json{{"v", 1}}));
+  tziakcha::storage::CachingStorage storage(inner_);
+
+  json loaded;
+  EXPECT_TRUE(storage.load_json("a", loaded));
+  fs::remove(test_dir_ / "a.json");
+  EXPECT_TRUE(storage.load_json("a", loaded));
+  EXPECT_EQ(loaded["v"], 1);
+
+  auto stats = storage.stats();
+  EXPECT_EQ(stats.hits, 1u);
+  EXPECT_EQ(stats.misses, 1u);
+  EXPECT_EQ(stats.entries, 1u);
+}
+
+TEST_F(CachingStorageTest, WritesGoThroughAndRefreshCache) {
+  tziakcha::storage::CachingStorage storage(inner_);
+  EXPECT_TRUE(storage.save_json("a", json{{"v", 1}}));
+  EXPECT_TRUE(storage.save_json("a", json{{"v", 2}}));
+
+  json loaded;
+  EXPECT_TRUE(inner_->load_json("a", loaded));
+  EXPECT_EQ(loaded["v"], 2);
+  EXPECT_TRUE(storage.load_json("a", loaded));
+  EXPECT_EQ(loaded["v"], 2);
+  EXPECT_EQ(storage.stats().hits, 1u);
+
+  EXPECT_TRUE(storage.remove("a"));
+  EXPECT_FALSE(storage.exists("a"));
+  EXPECT_FALSE(storage.load_json("a", loaded));
+}
+
+TEST_F(CachingStorageTest, EvictsLeastRecentlyUsedPastCapacity) {
+  json doc;
+  doc["payload"] = std::string(1000, 'x');
+
+  tziakcha::storage::CachingStorage storage(inner_, 2500);
+  EXPECT_TRUE(storage.save_json("a", doc));
+  EXPECT_TRUE(storage.save_json("b", doc));
+
+  json loaded;
+  EXPECT_TRUE(storage.load_json("a", loaded));
+  EXPECT_TRUE(storage.save_json("c", doc));
+
+  auto stats = storage.stats();
+  EXPECT_EQ(stats.entries, 2u);
+  EXPECT_EQ(stats.evictions, 1u);
+  EXPECT_LE(stats.bytes, 2500u);
+
+  uint64_t hits = stats.hits;
+  EXPECT_TRUE(storage.load_json("a", loaded));
+  EXPECT_EQ(storage.stats().hits, hits + 1);
+  EXPECT_TRUE(storage.load_json("b", loaded));
+  EXPECT_EQ(storage.stats().hits, hits + 1);
+}
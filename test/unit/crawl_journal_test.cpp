@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include "fetcher/crawl_journal.h"
+
+namespace fs = std::filesystem;
+
+using tziakcha::fetcher::CrawlJournal;
+
+class CrawlJournalTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    test_dir_ = fs::temp_directory_path() / "tziakcha_journal_test";
+    if (fs::exists(test_dir_)) {
+      fs::remove_all(test_dir_);
+    }
+    path_ = (test_dir_ / "records.journal").string();
+  }
+
+  void TearDown() override {
+    if (fs::exists(test_dir_)) {
+      fs::remove_all(test_dir_);
+    }
+  }
+
+  size_t CountLines() const {
+    std::ifstream file(path_);
+    size_t lines = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+      lines++;
+    }
+    return lines;
+  }
+
+  fs::path test_dir_;
+  std::string path_;
+};
+
+TEST_F(CrawlJournalTest, ReplaysLastStateOfEachId) {
+  {
+    CrawlJournal journal(path_);
+    ASSERT_TRUE(journal.open());
+    journal.mark_attempted("a");
+    journal.mark_succeeded("a");
+    journal.mark_attempted("b");
+    journal.mark_failed("b", "HTTP status 503\nretry later");
+    journal.mark_attempted("c");
+    journal.mark_attempted("d");
+    journal.mark_failed("d", "timeout");
+    journal.mark_succeeded("d");
+  }
+
+  CrawlJournal journal(path_);
+  ASSERT_TRUE(journal.open());
+  EXPECT_EQ(journal.state("a"), CrawlJournal::State::kSucceeded);
+  EXPECT_EQ(journal.state("b"), CrawlJournal::State::kFailed);
+  EXPECT_EQ(journal.failure_reason("b"), "HTTP status 503 retry later");
+  EXPECT_EQ(journal.state("c"), CrawlJournal::State::kAttempted);
+  EXPECT_EQ(journal.state("d"), CrawlJournal::State::kSucceeded);
+  EXPECT_EQ(journal.state("e"), CrawlJournal::State::kUnknown);
+  EXPECT_EQ(journal.failed_ids(), std::vector<std::string>{"b"});
+
+  auto counts = journal.counts();
+  EXPECT_EQ(counts.attempted, 1u);
+  EXPECT_EQ(counts.succeeded, 2u);
+  EXPECT_EQ(counts.failed, 1u);
+}
+
+TEST_F(CrawlJournalTest, CompactsOnOpenWhenMostlyHistory) {
+  {
+    CrawlJournal journal(path_);
+    ASSERT_TRUE(journal.open());
+    for (int round = 0; round < 5000; ++round) {
+      journal.mark_failed("x", "round " + std::to_string(round));
+    }
+    journal.mark_succeeded("y");
+  }
+  EXPECT_EQ(CountLines(), 5001u);
+
+  CrawlJournal journal(path_);
+  ASSERT_TRUE(journal.open());
+  EXPECT_EQ(CountLines(), 2u);
+  EXPECT_EQ(journal.failure_reason("x"), "round 4999");
+  EXPECT_EQ(journal.state("y"), CrawlJournal::State::kSucceeded);
+
+  journal.mark_succeeded("x");
+  journal.close();
+  EXPECT_EQ(CountLines(), 3u);
+}
+
+TEST_F(CrawlJournalTest, DropsTornLastLine) {
+  {
+    CrawlJournal journal(path_);
+    ASSERT_TRUE(journal.open());
+    journal.mark_succeeded("a");
+  }
+  std::ofstream(path_, std::ios::app) << "S abc";
+
+  {
+    CrawlJournal journal(path_);
+    ASSERT_TRUE(journal.open());
+    EXPECT_EQ(journal.state("abc"), CrawlJournal::State::kUnknown);
+    journal.mark_succeeded("b");
+  }
+
+  CrawlJournal journal(path_);
+  ASSERT_TRUE(journal.open());
+  EXPECT_EQ(CountLines(), 2u);
+  EXPECT_EQ(journal.state("a"), CrawlJournal::State::kSucceeded);
+  EXPECT_EQ(journal.state("b"), CrawlJournal::State::kSucceeded);
+  EXPECT_EQ(journal.state("abc"), CrawlJournal::State::kUnknown);
+}
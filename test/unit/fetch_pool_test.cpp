@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "fetcher/fetch_pool.h"
+
+using tziakcha::fetcher::FetchPool;
+using tziakcha::fetcher::FetchStats;
+using tziakcha::fetcher::RateLimiter;
+
+TEST(FetchPoolTest, RunsEveryIdAndCountsFailures) {
+  std::vector<std::string> ids;
+  for (int i = 0; i < 40; ++i) {
+    ids.push_back(std::to_string(i));
+  }
+
+  std::atomic<int> active{0};
+  std::atomic<int> peak{0};
+  std::vector<std::atomic<int>> calls(ids.size());
+
+  FetchPool pool(4, 0);
+  FetchStats stats = pool.run(ids, [&](size_t index, const std::string& id) {
+    int now  = ++active;
+    int seen = peak.load();
+    while (now > seen && !peak.compare_exchange_weak(seen, now)) {
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    --active;
+    calls[index]++;
+    return std::stoi(id) % 10 != 0;
+  });
+
+  for (const auto& count : calls) {
+    EXPECT_EQ(count.load(), 1);
+  }
+  EXPECT_EQ(stats.succeeded, 36u);
+  EXPECT_EQ(stats.failed, 4u);
+  EXPECT_EQ(stats.latencies_ms.size(), ids.size());
+  EXPECT_LE(peak.load(), 4);
+  EXPECT_GT(peak.load(), 1);
+  EXPECT_GE(stats.percentile_ms(50), 1.0);
+}
+
+TEST(FetchPoolTest, RateLimiterSpacesRequests) {
+  RateLimiter limiter(100, 1);
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 11; ++i) {
+    limiter.acquire();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  EXPECT_GE(elapsed.count(), 0.095);
+}
+
+TEST(FetchPoolTest, PercentilesUseNearestRank) {
+  FetchStats stats;
+  stats.latencies_ms = {5, 1, 4, 2, 3};
+  EXPECT_DOUBLE_EQ(stats.percentile_ms(50), 3);
+  EXPECT_DOUBLE_EQ(stats.percentile_ms(100), 5);
+  EXPECT_DOUBLE_EQ(stats.percentile_ms(0), 1);
+  EXPECT_DOUBLE_EQ(stats.mean_ms(), 3);
+}
+
+TEST(LatencyHistogramTest, ReportsBucketBoundsAsPercentiles) {
+  tziakcha::fetcher::LatencyHistogram histogram;
+  for (int i = 0; i < 90; ++i) {
+    histogram.add(30);
+  }
+  for (int i = 0; i < 9; ++i) {
+    histogram.add(400);
+  }
+  histogram.add(1234);
+
+  EXPECT_EQ(histogram.count(), 100u);
+  EXPECT_DOUBLE_EQ(histogram.percentile_ms(50), 50);
+  EXPECT_DOUBLE_EQ(histogram.percentile_ms(90), 50);
+  EXPECT_DOUBLE_EQ(histogram.percentile_ms(99), 500);
+  EXPECT_DOUBLE_EQ(histogram.percentile_ms(100), 1234);
+  EXPECT_DOUBLE_EQ(histogram.max_ms(), 1234);
+
+  tziakcha::fetcher::LatencyHistogram other;
+  other.add(60000);
+  histogram.merge(other);
+  EXPECT_EQ(histogram.buckets().back(), 1u);
+  EXPECT_DOUBLE_EQ(histogram.percentile_ms(100), 60000);
+}
+
+TEST(RateLimiterTest, TryAcquireDoesNotWaitForTokens) {
+  RateLimiter limiter(10, 2);
+  EXPECT_TRUE(limiter.try_acquire());
+  EXPECT_TRUE(limiter.try_acquire());
+  EXPECT_FALSE(limiter.try_acquire());
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(150));
+  EXPECT_TRUE(limiter.try_acquire());
+}
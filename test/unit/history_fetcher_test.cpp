@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <httplib.h>
+#include <nlohmann/json.hpp>
+#include "config/fetcher_config.h"
+#include "fetcher/history_fetcher.h"
+#include "fetcher/http_client_pool.h"
+#include "replay_server.h"
+#include "storage/filesystem_storage.h"
+
+using json   = nlohmann::json;
+namespace fs = std::filesystem;
+
+using tziakcha::fetcher::HistoryFetcher;
+using tziakcha::fetcher::HttpClientPool;
+using tziakcha::mock::ReplayOptions;
+using tziakcha::mock::ReplayServer;
+
+namespace {
+
+constexpr int kPages        = 30;
+constexpr int kGamesPerPage = 8;
+constexpr int kMaxPages     = 64;
+
+// Local midnight of 2024-03-<day>, as HistoryFetcher parses dates.
+int64_t MarchDayMs(int day) {
+  std::tm tm = {};
+  tm.tm_year = 2024 - 1900;
+  tm.tm_mon  = 2;
+  tm.tm_mday = day;
+  return static_cast<int64_t>(std::mktime(&tm)) * 1000;
+}
+
+} // namespace
+
+class HistoryFetcherTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    test_dir_ = fs::temp_directory_path() / "history_fetcher_test";
+    fs::remove_all(test_dir_);
+    fs::create_directories(test_dir_ / "mock" / "history");
+
+    // Page p holds the games of March 31 - p, newest first, one page per
+    // day, as the server lists history newest first.
+    for (int page = 0; page < kPages; ++page) {
+      int64_t day_ms = MarchDayMs(31 - page);
+      json games     = json::array();
+      for (int i = kGamesPerPage - 1; i >= 0; --i) {
+        games.push_back({{"id", std::to_string(page) + "-" + std::to_string(i)},
+                         {"start_time", day_ms + (1 + 2 * i) * 3600000}});
+      }
+      std::ofstream(test_dir_ / "mock" / "history" /
+                    (std::to_string(page) + ".json"))
+          << json{{"games", games}}.dump();
+    }
+
+    ReplayOptions options;
+    options.dir = test_dir_ / "mock";
+    replay_     = std::make_unique<ReplayServer>(options);
+
+    int port = server_.bind_to_any_port("127.0.0.1");
+    ASSERT_GT(port, 0);
+
+    json config = {{"http",
+                    {{"base_url", "127.0.0.1"},
+                     {"use_ssl", false},
+                     {"port", port},
+                     {"history_endpoint", "/_qry/history/"},
+                     {"game_endpoint", "/_qry/game"},
+                     {"record_endpoint", "/_qry/record/"},
+                     {"timeout_ms", 5000},
+                     {"retry_attempts", 1}}},
+                   {"fetcher", {{"max_pages", kMaxPages}}}};
+    fs::path config_path = test_dir_ / "fetcher_config.json";
+    std::ofstream(config_path) << config.dump();
+    ASSERT_TRUE(
+        tziakcha::config::FetcherConfig::instance().load(config_path.string()));
+
+    replay_->AddRoutes(server_);
+    listener_ = std::thread([this] { server_.listen_after_bind(); });
+    server_.wait_until_ready();
+  }
+
+  void TearDown() override {
+    server_.stop();
+    if (listener_.joinable()) {
+      listener_.join();
+    }
+    HttpClientPool::instance().clear();
+    fs::remove_all(test_dir_);
+  }
+
+  fs::path test_dir_;
+  std::unique_ptr<ReplayServer> replay_;
+  httplib::Server server_;
+  std::thread listener_;
+};
+
+TEST_F(HistoryFetcherTest, DateRangeBisectsToItsPages) {
+  auto storage = std::make_shared<tziakcha::storage::FileSystemStorage>(
+      (test_dir_ / "data").string());
+  HistoryFetcher fetcher(storage);
+
+  // March 20 to 25 are pages 6 to 11.
+  ASSERT_TRUE(fetcher.fetch("", "history/records", "20240320", "20240325", 2));
+
+  const auto& records = fetcher.get_records();
+  ASSERT_EQ(records.size(), 6u * kGamesPerPage);
+  for (const auto& game : records) {
+    int page = std::stoi(game["id"].get<std::string>());
+    EXPECT_GE(page, 6);
+    EXPECT_LE(page, 11);
+  }
+
+  // Two bisections over max_pages probe about 2 * log2(64) pages, and the
+  // pages of the range not probed already are fetched once.
+  EXPECT_LE(replay_->requests(), 2u * 7 + 6);
+
+  json saved;
+  ASSERT_TRUE(storage->load_json("history/records", saved));
+  EXPECT_EQ(saved.size(), records.size());
+}
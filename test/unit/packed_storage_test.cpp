@@ -0,0 +1,338 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <nlohmann/json.hpp>
+#include "storage/packed_storage.h"
+#include "storage/storage_factory.h"
+
+using json   = nlohmann::json;
+namespace fs = std::filesystem;
+
+class PackedStorageTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    test_dir_ = fs::temp_directory_path() / "tziakcha_packed_test";
+    if (fs::exists(test_dir_)) {
+      fs::remove_all(test_dir_);
+    }
+    fs::create_directories(test_dir_);
+  }
+
+  void TearDown() override {
+    if (fs::exists(test_dir_)) {
+      fs::remove_all(test_dir_);
+    }
+  }
+
+  size_t CountSegments() const {
+    size_t count = 0;
+    for (const auto& entry : fs::directory_iterator(test_dir_)) {
+      if (entry.path().extension() == ".pack") {
+        count++;
+      }
+    }
+    return count;
+  }
+
+  fs::path test_dir_;
+};
+
+TEST_F(PackedStorageTest, SaveAndLoad) {
+  tziakcha::storage::PackedStorage storage(test_dir_.string());
+
+  json data;
+  data["id"]   = "abc";
+  data["tags"] = json::array({1, 2, 3});
+  EXPECT_TRUE(storage.save_json("record/abc", data));
+  EXPECT_TRUE(storage.exists("record/abc"));
+
+  json loaded;
+  EXPECT_TRUE(storage.load_json("record/abc", loaded));
+  EXPECT_EQ(loaded, data);
+
+  std::string raw;
+  EXPECT_TRUE(storage.load_string("record/abc", raw));
+  EXPECT_EQ(json::parse(raw), data);
+}
+
+TEST_F(PackedStorageTest, SaveStringSurvivesReopen) {
+  std::string text = R"({"id": "abc", "script": "eJw="})";
+  {
+    tziakcha::storage::PackedStorage storage(test_dir_.string());
+    EXPECT_TRUE(storage.save_string("record/abc", text));
+  }
+
+  tziakcha::storage::PackedStorage storage(test_dir_.string());
+  std::string raw;
+  EXPECT_TRUE(storage.load_string("record/abc", raw));
+  EXPECT_EQ(raw, text);
+}
+
+TEST_F(PackedStorageTest, MissingKey) {
+  tziakcha::storage::PackedStorage storage(test_dir_.string());
+
+  json loaded;
+  EXPECT_FALSE(storage.exists("missing"));
+  EXPECT_FALSE(storage.load_json("missing", loaded));
+  EXPECT_FALSE(storage.remove("missing"));
+}
+
+TEST_F(PackedStorageTest, OverwriteAndRemoveSurviveReopen) {
+  {
+    tziakcha::storage::PackedStorage storage(test_dir_.string());
+    EXPECT_TRUE(storage.save_json("a", json{{"v", 1}}));
+    EXPECT_TRUE(storage.save_json("a", json{{"v", 2}}));
+    EXPECT_TRUE(storage.save_json("b", json{{"v", 3}}));
+    EXPECT_TRUE(storage.remove("b"));
+    EXPECT_GT(storage.dead_bytes(), 0u);
+  }
+
+  tziakcha::storage::PackedStorage reopened(test_dir_.string());
+  EXPECT_EQ(reopened.record_count(), 1u);
+  EXPECT_FALSE(reopened.exists("b"));
+
+  json loaded;
+  EXPECT_TRUE(reopened.load_json("a", loaded));
+  EXPECT_EQ(loaded["v"], 2);
+}
+
+TEST_F(PackedStorageTest, ListKeysWithPrefixIsSorted) {
+  tziakcha::storage::PackedStorage storage(test_dir_.string());
+  EXPECT_TRUE(storage.save_json("records/game_003", json{{"v", 3}}));
+  EXPECT_TRUE(storage.save_json("records/game_001", json{{"v", 1}}));
+  EXPECT_TRUE(storage.save_json("other/game_001", json{{"v", 4}}));
+  EXPECT_TRUE(storage.save_json("records/game_002", json{{"v", 2}}));
+
+  auto keys = storage.list_keys("records");
+  ASSERT_EQ(keys.size(), 3u);
+  EXPECT_EQ(keys[0], "records/game_001");
+  EXPECT_EQ(keys[2], "records/game_003");
+
+  EXPECT_EQ(storage.list_keys("").size(), 4u);
+}
+
+TEST_F(PackedStorageTest, RollsSegmentsAndCompacts) {
+  tziakcha::storage::PackedStorage storage(test_dir_.string(), 256);
+  for (int i = 0; i < 20; ++i) {
+    json data;
+    data["id"]      = i;
+    data["payload"] = std::string(64, 'x');
+    EXPECT_TRUE(storage.save_json("record/" + std::to_string(i), data));
+  }
+  for (int i = 0; i < 20; i += 2) {
+    EXPECT_TRUE(storage.remove("record/" + std::to_string(i)));
+  }
+  EXPECT_GT(CountSegments(), 1u);
+
+  tziakcha::storage::PackedStorage::CompactionStats stats;
+  ASSERT_TRUE(storage.compact(&stats));
+  EXPECT_EQ(stats.live_records, 10u);
+  EXPECT_LT(stats.bytes_after, stats.bytes_before);
+  EXPECT_EQ(storage.dead_bytes(), 0u);
+  EXPECT_EQ(CountSegments(), stats.segments_after);
+
+  json loaded;
+  EXPECT_TRUE(storage.load_json("record/7", loaded));
+  EXPECT_EQ(loaded["id"], 7);
+  EXPECT_FALSE(storage.exists("record/8"));
+
+  tziakcha::storage::PackedStorage reopened(test_dir_.string(), 256);
+  EXPECT_EQ(reopened.record_count(), 10u);
+}
+
+TEST_F(PackedStorageTest, ReadsRunAlongsideCompaction) {
+  tziakcha::storage::PackedStorage storage(test_dir_.string(), 512);
+  for (int i = 0; i < 200; ++i) {
+    EXPECT_TRUE(storage.save_json("record/" + std::to_string(i % 50),
+                                  json{{"id", i % 50}, {"round", i}}));
+  }
+
+  std::atomic<bool> done{false};
+  std::atomic<int> failures{0};
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 4; ++t) {
+    readers.emplace_back([&, t] {
+      for (int i = t; !done || i < 200; i += 4) {
+        std::string key = "record/" + std::to_string(i % 50);
+        std::string raw;
+        tziakcha::storage::RecordView view;
+        if (!storage.load_string(key, raw) || !storage.load_view(key, view) ||
+            json::parse(raw)["id"] != i % 50 ||
+            json::parse(view.data())["id"] != i % 50) {
+          failures++;
+        }
+      }
+    });
+  }
+
+  ASSERT_TRUE(storage.compact());
+  done = true;
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(failures, 0);
+  EXPECT_EQ(storage.record_count(), 50u);
+}
+
+TEST_F(PackedStorageTest, TornTailIsTruncatedOnOpen) {
+  {
+    tziakcha::storage::PackedStorage storage(test_dir_.string());
+    EXPECT_TRUE(storage.save_json("a", json{{"v", 1}}));
+    EXPECT_TRUE(storage.save_json("b", json{{"v", 2}}));
+  }
+
+  fs::path segment;
+  for (const auto& entry : fs::directory_iterator(test_dir_)) {
+    if (entry.path().extension() == ".pack") {
+      segment = entry.path();
+    }
+  }
+  ASSERT_FALSE(segment.empty());
+  fs::resize_file(segment, fs::file_size(segment) - 3);
+
+  tziakcha::storage::PackedStorage reopened(test_dir_.string());
+  EXPECT_TRUE(reopened.exists("a"));
+  EXPECT_FALSE(reopened.exists("b"));
+  EXPECT_TRUE(reopened.save_json("c", json{{"v", 3}}));
+
+  json loaded;
+  EXPECT_TRUE(reopened.load_json("c", loaded));
+  EXPECT_EQ(loaded["v"], 3);
+}
+
+TEST_F(PackedStorageTest, ReaderLeavesTornTailInPlace) {
+  {
+    tziakcha::storage::PackedStorage storage(test_dir_.string());
+    EXPECT_TRUE(storage.save_json("a", json{{"v", 1}}));
+    EXPECT_TRUE(storage.save_json("b", json{{"v", 2}}));
+  }
+
+  fs::path segment = test_dir_ / "segment-000000.pack";
+  fs::resize_file(segment, fs::file_size(segment) - 3);
+  uint64_t torn_size = fs::file_size(segment);
+
+  tziakcha::storage::PackedStorage reader(
+      test_dir_.string(),
+      tziakcha::storage::PackedStorage::kDefaultSegmentBytes,
+      tziakcha::storage::Encoding::kJson,
+      tziakcha::storage::OpenMode::kReadOnly);
+  EXPECT_TRUE(reader.exists("a"));
+  EXPECT_FALSE(reader.exists("b"));
+  EXPECT_FALSE(reader.save_json("c", json{{"v", 3}}));
+  EXPECT_EQ(fs::file_size(segment), torn_size);
+}
+
+TEST_F(PackedStorageTest, SecondWriterIsRefused) {
+  tziakcha::storage::PackedStorage writer(test_dir_.string());
+  EXPECT_TRUE(writer.save_json("a", json{{"v", 1}}));
+
+  tziakcha::storage::PackedStorage second(test_dir_.string());
+  EXPECT_TRUE(second.exists("a"));
+  EXPECT_FALSE(second.save_json("b", json{{"v", 2}}));
+  EXPECT_FALSE(second.compact());
+
+  EXPECT_TRUE(writer.save_json("b", json{{"v", 2}}));
+}
+
+TEST_F(PackedStorageTest, CorruptEarlierSegmentKeepsLaterSegments) {
+  {
+    tziakcha::storage::PackedStorage storage(test_dir_.string(), 256);
+    for (int i = 0; i < 20; ++i) {
+      EXPECT_TRUE(storage.save_json("record/" + std::to_string(i),
+                                    json{{"payload", std::string(64, 'x')}}));
+    }
+  }
+  ASSERT_GT(CountSegments(), 2u);
+
+  fs::path first = test_dir_ / "segment-000000.pack";
+  uint64_t size  = fs::file_size(first);
+  {
+    std::fstream file(first, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(0);
+    file.put('\0');
+  }
+
+  tziakcha::storage::PackedStorage reopened(test_dir_.string(), 256);
+  EXPECT_EQ(fs::file_size(first), size);
+  EXPECT_FALSE(reopened.exists("record/0"));
+  EXPECT_TRUE(reopened.exists("record/19"));
+  EXPECT_GT(reopened.record_count(), 10u);
+}
+
+TEST_F(PackedStorageTest, OpenStorageDetectsArchive) {
+  auto fs_storage = tziakcha::storage::OpenStorage(test_dir_.string());
+  EXPECT_FALSE(
+      tziakcha::storage::PackedStorage::IsArchive(test_dir_.string()));
+
+  auto packed = tziakcha::storage::OpenStorage(
+      test_dir_.string(), tziakcha::storage::StorageBackend::kPacked);
+  EXPECT_TRUE(packed->save_json("x", json{{"v", 1}}));
+  packed.reset();
+
+  auto detected = tziakcha::storage::OpenStorage(test_dir_.string());
+  EXPECT_NE(dynamic_cast<tziakcha::storage::PackedStorage*>(detected.get()),
+            nullptr);
+  EXPECT_TRUE(detected->exists("x"));
+}
+
+TEST_F(PackedStorageTest, LoadViewStaysValidAcrossAppends) {
+  tziakcha::storage::PackedStorage storage(test_dir_.string());
+  EXPECT_TRUE(storage.save_json("a", json{{"v", 1}}));
+
+  tziakcha::storage::RecordView first;
+  ASSERT_TRUE(storage.load_view("a", first));
+
+  for (int i = 0; i < 50; ++i) {
+    EXPECT_TRUE(storage.save_json("k" + std::to_string(i), json{{"v", i}}));
+  }
+
+  tziakcha::storage::RecordView last;
+  ASSERT_TRUE(storage.load_view("k49", last));
+  EXPECT_EQ(json::parse(last.data())["v"], 49);
+  EXPECT_EQ(json::parse(first.data())["v"], 1);
+}
+
+TEST_F(PackedStorageTest, MsgpackEntriesDecodeAfterReopen) {
+  json data;
+  data["id"]   = "packed";
+  data["tags"] = json::array({"a", "b"});
+  {
+    tziakcha::storage::PackedStorage storage(
+        test_dir_.string(),
+        tziakcha::storage::PackedStorage::kDefaultSegmentBytes,
+        tziakcha::storage::Encoding::kMsgpack);
+    EXPECT_TRUE(storage.save_json("record/packed", data));
+  }
+
+  tziakcha::storage::PackedStorage reopened(test_dir_.string());
+  json loaded;
+  EXPECT_TRUE(reopened.load_json("record/packed", loaded));
+  EXPECT_EQ(loaded, data);
+
+  tziakcha::storage::RecordView view;
+  ASSERT_TRUE(reopened.load_view("record/packed", view));
+  EXPECT_EQ(tziakcha::storage::DetectEncoding(view.data()),
+            tziakcha::storage::Encoding::kMsgpack);
+  json decoded;
+  EXPECT_TRUE(tziakcha::storage::DecodeDocument(view.data(), decoded));
+  EXPECT_EQ(decoded, data);
+}
+
+TEST_F(PackedStorageTest, SaveManySurvivesReopen) {
+  {
+    tziakcha::storage::PackedStorage storage(test_dir_.string());
+    std::vector<std::pair<std::string, json>> items;
+    items.emplace_back("a", json{{"v", 1}});
+    items.emplace_back("b", json{{"v", 2}});
+    items.emplace_back("a", json{{"v", 3}});
+    EXPECT_TRUE(storage.save_many(items));
+  }
+
+  tziakcha::storage::PackedStorage reopened(test_dir_.string());
+  EXPECT_EQ(reopened.record_count(), 2u);
+  json loaded;
+  EXPECT_TRUE(reopened.load_json("a", loaded));
+  EXPECT_EQ(loaded["v"], 3);
+}
@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include "storage/prefetch_reader.h"
+
+namespace fs = std::filesystem;
+
+using tziakcha::storage::PrefetchReader;
+using tziakcha::storage::RecordView;
+
+class PrefetchReaderTest
+    : public ::testing::TestWithParam<PrefetchReader::Backend> {
+protected:
+  void SetUp() override {
+    test_dir_ = fs::temp_directory_path() / "tziakcha_prefetch_test";
+    if (fs::exists(test_dir_)) {
+      fs::remove_all(test_dir_);
+    }
+    fs::create_directories(test_dir_);
+  }
+
+  void TearDown() override {
+    if (fs::exists(test_dir_)) {
+      fs::remove_all(test_dir_);
+    }
+  }
+
+  std::vector<std::string> WriteFiles(int count) {
+    std::vector<std::string> paths;
+    for (int i = 0; i < count; ++i) {
+      paths.push_back((test_dir_ / (std::to_string(i) + ".txt")).string());
+      std::ofstream out(paths.back());
+      out << std::string(static_cast<size_t>(i) * 97, 'x') << i;
+    }
+    return paths;
+  }
+
+  fs::path test_dir_;
+};
+
+TEST_P(PrefetchReaderTest, DeliversFilesInOrder) {
+  auto paths = WriteFiles(50);
+  paths.insert(paths.begin() + 10, (test_dir_ / "missing.txt").string());
+
+  PrefetchReader reader(8, GetParam());
+  std::vector<size_t> order;
+  std::vector<std::string> contents;
+  size_t failed = 0;
+  EXPECT_TRUE(
+      reader.read(paths, [&](size_t index, bool ok, const RecordView& view) {
+        order.push_back(index);
+        if (!ok) {
+          failed++;
+        } else {
+          contents.emplace_back(view.data());
+        }
+        return true;
+      }));
+
+  ASSERT_EQ(order.size(), paths.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    EXPECT_EQ(order[i], i);
+  }
+  EXPECT_EQ(failed, 1u);
+  ASSERT_EQ(contents.size(), 50u);
+  EXPECT_EQ(contents[0], "0");
+  EXPECT_EQ(contents[49], std::string(49 * 97, 'x') + "49");
+}
+
+TEST_P(PrefetchReaderTest, VisitorCanStopEarly) {
+  auto paths = WriteFiles(30);
+
+  PrefetchReader reader(4, GetParam());
+  size_t visited = 0;
+  EXPECT_FALSE(reader.read(paths, [&](size_t, bool, const RecordView&) {
+    return ++visited < 7;
+  }));
+  EXPECT_EQ(visited, 7u);
+
+  visited = 0;
+  EXPECT_TRUE(reader.read(paths, [&](size_t, bool ok, const RecordView&) {
+    visited += ok ? 1 : 0;
+    return true;
+  }));
+  EXPECT_EQ(visited, 30u);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    Backends,
+    PrefetchReaderTest,
+    ::testing::Values(PrefetchReader::Backend::kIoUring,
+                      PrefetchReader::Backend::kThreadPool));
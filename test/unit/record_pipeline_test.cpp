@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include "stats/record_pipeline.h"
+#include "storage/filesystem_storage.h"
+#include "utils/script_decoder.h"
+
+namespace fs = std::filesystem;
+
+using tziakcha::stats::RecordInterceptResult;
+using tziakcha::stats::RecordPipelineOptions;
+using tziakcha::stats::RunRecordPipeline;
+
+class RecordPipelineTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    test_dir_ = fs::temp_directory_path() / "tziakcha_pipeline_test";
+    if (fs::exists(test_dir_)) {
+      fs::remove_all(test_dir_);
+    }
+    fs::create_directories(test_dir_);
+  }
+
+  void TearDown() override {
+    if (fs::exists(test_dir_)) {
+      fs::remove_all(test_dir_);
+    }
+  }
+
+  fs::path test_dir_;
+};
+
+TEST_F(RecordPipelineTest, EveryFetchedRecordReachesTheSinkOnce) {
+  std::string encoded;
+  ASSERT_TRUE(tziakcha::utils::EncodeScriptFromJson(json{{"a", 1}}, encoded));
+
+  // Ids ending in 0 fail to fetch, 1 is not JSON, 2 has no script; the
+  // rest decode to a script without any actions.
+  std::vector<std::string> ids;
+  for (int i = 0; i < 200; ++i) {
+    ids.push_back(std::to_string(i));
+  }
+  auto source = [&](const std::string& id, std::string& body) {
+    switch (id.back()) {
+    case '0':
+      return false;
+    case '1':
+      body = "not json";
+      return true;
+    case '2':
+      body = R"({"id": ")" + id + R"("})";
+      return true;
+    default:
+      body = json{{"id", id}, {"script", encoded}}.dump();
+      return true;
+    }
+  };
+
+  std::mutex mutex;
+  std::multiset<std::string> seen;
+  auto sink = [&](const std::string& id, const RecordInterceptResult&) {
+    std::lock_guard<std::mutex> lock(mutex);
+    seen.insert(id);
+  };
+
+  auto storage =
+      std::make_shared<tziakcha::storage::FileSystemStorage>(test_dir_);
+  RecordPipelineOptions options;
+  options.fetch_workers    = 8;
+  options.decode_workers   = 3;
+  options.simulate_workers = 1;
+  options.queue_capacity   = 4;
+  options.persist          = storage;
+
+  auto stats = RunRecordPipeline(ids, source, sink, options);
+
+  EXPECT_EQ(stats.fetch_failed, 20u);
+  EXPECT_EQ(stats.fetched, 180u);
+  EXPECT_EQ(stats.decode_failed, 40u);
+  EXPECT_EQ(stats.simulated, 140u);
+  EXPECT_EQ(seen.size(), 180u);
+  for (const auto& id : ids) {
+    EXPECT_EQ(seen.count(id), id.back() == '0' ? 0u : 1u) << id;
+  }
+
+  // Decoded records are persisted with their script expanded.
+  json saved;
+  ASSERT_TRUE(storage->load_json("13", saved));
+  EXPECT_EQ(saved["script"], "<Decoded>");
+  EXPECT_EQ(saved["step"], json({{"a", 1}}));
+  EXPECT_FALSE(storage->exists("12"));
+}
@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+#include "fetcher/retry_policy.h"
+
+using tziakcha::fetcher::CircuitBreaker;
+using tziakcha::fetcher::RetryPolicy;
+
+TEST(RetryPolicyTest, RetriesOnlyTransientFailures) {
+  EXPECT_TRUE(RetryPolicy::IsRetryable(0));
+  EXPECT_TRUE(RetryPolicy::IsRetryable(429));
+  EXPECT_TRUE(RetryPolicy::IsRetryable(503));
+  EXPECT_FALSE(RetryPolicy::IsRetryable(200));
+  EXPECT_FALSE(RetryPolicy::IsRetryable(404));
+}
+
+TEST(RetryPolicyTest, BackoffDoublesWithinJitterAndCaps) {
+  RetryPolicy policy;
+  policy.base_delay_ms = 100;
+  policy.max_delay_ms  = 1000;
+
+  EXPECT_DOUBLE_EQ(policy.backoff_ms(1, 0.0), 50);
+  EXPECT_DOUBLE_EQ(policy.backoff_ms(1, 0.5), 75);
+  EXPECT_DOUBLE_EQ(policy.backoff_ms(2, 0.0), 100);
+  EXPECT_DOUBLE_EQ(policy.backoff_ms(3, 0.0), 200);
+  EXPECT_DOUBLE_EQ(policy.backoff_ms(10, 0.0), 500);
+  EXPECT_LT(policy.backoff_ms(10, 0.999), 1000);
+}
+
+TEST(CircuitBreakerTest, TripsOnErrorRateAndBacksOff) {
+  CircuitBreaker::Options options;
+  options.window      = 10;
+  options.min_samples = 4;
+  options.error_rate  = 0.5;
+  options.cooldown_ms = 1000;
+  CircuitBreaker breaker(options);
+
+  auto now = CircuitBreaker::Clock::now();
+  EXPECT_LE(breaker.blocked_until(), now);
+
+  // Isolated failures among successes stay below the threshold.
+  for (int i = 0; i < 20; ++i) {
+    EXPECT_FALSE(breaker.record(i % 4 != 0, now));
+  }
+
+  int recorded = 0;
+  while (!breaker.record(false, now)) {
+    ++recorded;
+    ASSERT_LT(recorded, 10);
+  }
+  EXPECT_EQ(breaker.trips(), 1u);
+  EXPECT_EQ(breaker.blocked_until(), now + std::chrono::seconds(1));
+
+  // Failing straight after the cooldown trips again for twice as long.
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_FALSE(breaker.record(false, now));
+  }
+  EXPECT_TRUE(breaker.record(false, now));
+  EXPECT_EQ(breaker.blocked_until(), now + std::chrono::seconds(2));
+}
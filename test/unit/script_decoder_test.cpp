@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <nlohmann/json.hpp>
+#include "utils/script_decoder.h"
+
+using json = nlohmann::json;
+using tziakcha::utils::ScriptMode;
+
+namespace {
+
+json SampleScript() {
+  json script;
+  script["a"] = json::array({json::array({0, 1, 2}), json::array({3, 4, 5})});
+  script["p"] = json::array({"east", "south"});
+  return script;
+}
+
+std::string SampleRecord() {
+  std::string encoded;
+  EXPECT_TRUE(tziakcha::utils::EncodeScriptFromJson(SampleScript(), encoded));
+  return R"({"id":"r1","script":")" + encoded +
+         R"(","players":[{"n":"a"},{"n":"b","script":"x"}]})";
+}
+
+} // namespace
+
+TEST(ScriptDecoderTest, TextDecodeMatchesDomDecode) {
+  std::string text = SampleRecord();
+  json expected    = json::parse(text);
+  ASSERT_TRUE(tziakcha::utils::ApplyScriptMode(expected, ScriptMode::kDecoded));
+
+  ASSERT_TRUE(
+      tziakcha::utils::ApplyScriptModeToText(text, ScriptMode::kDecoded));
+  EXPECT_EQ(json::parse(text), expected);
+  EXPECT_EQ(json::parse(text)["step"], SampleScript());
+
+  // Already decoded text is left alone.
+  std::string decoded = text;
+  EXPECT_TRUE(
+      tziakcha::utils::ApplyScriptModeToText(decoded, ScriptMode::kDecoded));
+  EXPECT_EQ(decoded, text);
+}
+
+TEST(ScriptDecoderTest, TextCompressedModeKeepsRecordAsServed) {
+  std::string text = SampleRecord();
+  std::string copy = text;
+  EXPECT_TRUE(
+      tziakcha::utils::ApplyScriptModeToText(copy, ScriptMode::kCompressed));
+  EXPECT_EQ(copy, text);
+
+  ASSERT_TRUE(
+      tziakcha::utils::ApplyScriptModeToText(copy, ScriptMode::kDecoded));
+  EXPECT_FALSE(
+      tziakcha::utils::ApplyScriptModeToText(copy, ScriptMode::kCompressed));
+}
+
+TEST(ScriptDecoderTest, TextConversionRejectsUnusualRecords) {
+  for (std::string text : {std::string(R"({"id":"r1"})"),
+                           std::string(R"({"script":null})"),
+                           std::string(R"({"script":"ab\/cd"})"),
+                           std::string(R"({"script":"eJw=","step":{}})"),
+                           std::string(R"({"script":"not base64 zlib"})"),
+                           SampleRecord().substr(0, 40),
+                           std::string(R"([{"script":"eJw="}])")}) {
+    std::string copy = text;
+    EXPECT_FALSE(
+        tziakcha::utils::ApplyScriptModeToText(copy, ScriptMode::kDecoded))
+        << text;
+    EXPECT_EQ(copy, text);
+  }
+}
+
+TEST(ScriptDecoderTest, ReusedDecoderMatchesScripts) {
+  tziakcha::utils::ScriptDecoder decoder;
+  std::string text;
+  for (int n : {0, 1, 50, 5000, 3}) {
+    json script = json::array();
+    for (int i = 0; i < n; ++i) {
+      script.push_back(json::array({i, i * 7 % 13, "d" + std::to_string(i)}));
+    }
+    std::string encoded;
+    ASSERT_TRUE(tziakcha::utils::EncodeScriptFromJson(script, encoded));
+
+    json decoded;
+    ASSERT_TRUE(decoder.Decode(encoded, decoded));
+    EXPECT_EQ(decoded, script);
+    ASSERT_TRUE(decoder.Inflate(encoded, text, 16));
+    EXPECT_EQ(text, script.dump());
+    std::string_view view;
+    ASSERT_TRUE(decoder.Inflate(encoded, view));
+    EXPECT_EQ(view, script.dump());
+
+    // Line breaks are tolerated as cpp-base64 does; other junk is not.
+    std::string wrapped = encoded;
+    wrapped.insert(wrapped.size() / 2, "\n");
+    EXPECT_TRUE(decoder.Decode(wrapped, decoded));
+    EXPECT_EQ(decoded, script);
+    EXPECT_FALSE(decoder.Decode("#" + encoded, decoded));
+  }
+}
+
+TEST(ScriptDecoderTest, DecoderRejectsTruncatedScripts) {
+  std::string encoded;
+  ASSERT_TRUE(tziakcha::utils::EncodeScriptFromJson(SampleScript(), encoded));
+
+  tziakcha::utils::ScriptDecoder decoder;
+  json decoded;
+  EXPECT_FALSE(decoder.Decode(encoded.substr(0, encoded.size() / 2), decoded));
+  EXPECT_FALSE(decoder.Decode("", decoded));
+  EXPECT_TRUE(decoder.Decode(encoded, decoded));
+  EXPECT_EQ(decoded, SampleScript());
+}
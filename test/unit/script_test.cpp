@@ -0,0 +1,234 @@
+#include <gtest/gtest.h>
+#include "analyzer/script.h"
+#include "storage/encoding.h"
+#include "utils/script_decoder.h"
+
+using tziakcha::analyzer::ExtractRecordScript;
+using tziakcha::analyzer::ParseRecordHeader;
+using tziakcha::analyzer::ParseRecordScript;
+using tziakcha::analyzer::ParseScript;
+using tziakcha::analyzer::Script;
+
+namespace {
+
+json SampleScript() {
+  return json{
+      {"w", "0a1F8c"},
+      {"d", 0x3412},
+      {"i", 5},
+      {"b", 0x21},
+      {"t", 1700000000123LL},
+      {"g", {{"t", "Table"}}},
+      {"p",
+       {{{"i", "p0"}, {"n", "East"}, {"e", 1612.5}},
+        {{"i", "p1"}, {"n", "South"}},
+        {{"i", "p2"}, {"n", "West"}, {"e", 1400}},
+        {{"i", "p3"}, {"n", "North"}}}},
+      {"y",
+       {{{"f", 12},
+         {"t", {{"48", 0x108}, {"83", 1}, {"x", 4}}},
+         {"h", {{"a", {1, 2, {{"b", nullptr}}}}, {"s", "a\"b"}, {"r", 0.5}}}},
+        json::object(),
+        json::object(),
+        json::object()}},
+      {"a",
+       {{0x12, 3, 100},
+        {0x27, 4, 250, 9},
+        {0x01, 2},
+        "skip",
+        {0x30, "x", 300},
+        {0x36, 17, 400}}},
+  };
+}
+
+} // namespace
+
+TEST(ScriptTest, ParseFillsTypedFields) {
+  json source = SampleScript();
+  Script script;
+  ASSERT_TRUE(ParseScript(source.dump(), script));
+
+  EXPECT_TRUE(script.has_wall);
+  EXPECT_EQ(script.wall, (std::vector<uint8_t>{0x0a, 0x1f, 0x8c}));
+  EXPECT_TRUE(script.has_dice);
+  EXPECT_EQ(script.dice, 0x3412);
+  EXPECT_EQ(script.round, 5);
+  EXPECT_EQ(script.win_flags, 0x21);
+  EXPECT_EQ(script.timestamp, 1700000000123LL);
+  EXPECT_EQ(script.title, "Table");
+
+  ASSERT_EQ(script.players.size(), 4u);
+  EXPECT_EQ(script.players[0].id, "p0");
+  EXPECT_EQ(script.players[1].name, "South");
+  EXPECT_DOUBLE_EQ(script.players[0].elo, 1612.5);
+  EXPECT_DOUBLE_EQ(script.players[1].elo, 1500.0);
+  EXPECT_DOUBLE_EQ(script.players[2].elo, 1400.0);
+
+  ASSERT_EQ(script.wins.size(), 4u);
+  EXPECT_EQ(script.wins[0].total_fan, 12);
+  std::vector<std::pair<int, int>> fans = {{48, 0x108}, {83, 1}};
+  EXPECT_EQ(script.wins[0].fans, fans);
+  EXPECT_EQ(script.wins[0].hand, source["y"][0]["h"].dump());
+  EXPECT_TRUE(script.wins[1].hand.empty());
+
+  ASSERT_EQ(script.actions.size(), 3u);
+  EXPECT_EQ(script.actions[0].player_idx, 1);
+  EXPECT_EQ(script.actions[0].action_type, 2);
+  EXPECT_EQ(script.actions[1].player_idx, 2);
+  EXPECT_EQ(script.actions[1].action_type, 7);
+  EXPECT_EQ(script.actions[1].data, 4);
+  EXPECT_EQ(script.actions[1].time_ms, 250);
+  EXPECT_EQ(script.actions[2].player_idx, 3);
+  EXPECT_EQ(script.actions[2].action_type, 6);
+}
+
+TEST(ScriptTest, MismatchedTypesAreIgnored) {
+  Script script;
+  ASSERT_TRUE(ParseScript(R"({"a":1,"d":"x","p":{"i":"p0"},"y":[]})", script));
+  EXPECT_FALSE(script.has_dice);
+  EXPECT_TRUE(script.players.empty());
+  EXPECT_TRUE(script.wins.empty());
+  EXPECT_TRUE(script.actions.empty());
+
+  EXPECT_FALSE(ParseScript(R"({"w":"zz"})", script));
+  EXPECT_FALSE(ParseScript(R"({"a":[)", script));
+}
+
+TEST(ScriptTest, FansFollowJsonKeyOrder) {
+  std::string text = R"({"y":[{"t":{"9":6,"10":8,"2":8,"48":264}}]})";
+  Script script;
+  ASSERT_TRUE(ParseScript(text, script));
+
+  json dom = json::parse(text);
+  std::vector<std::pair<int, int>> dom_order;
+  for (const auto& [id, value] : dom["y"][0]["t"].items()) {
+    dom_order.emplace_back(std::stoi(id), value.get<int>());
+  }
+  std::vector<std::pair<int, int>> fans = {{10, 8}, {2, 8}, {48, 264}, {9, 6}};
+  EXPECT_EQ(dom_order, fans);
+  ASSERT_EQ(script.wins.size(), 1u);
+  EXPECT_EQ(script.wins[0].fans, fans);
+}
+
+TEST(ScriptTest, RecordFormsParseAlike) {
+  json source = SampleScript();
+  std::string encoded;
+  ASSERT_TRUE(tziakcha::utils::EncodeScriptFromJson(source, encoded));
+
+  Script from_step;
+  json decoded = {{"id", "r"}, {"script", "<Decoded>"}, {"step", source}};
+  ASSERT_TRUE(ParseRecordScript(decoded.dump(), from_step));
+
+  Script from_script;
+  json compressed = {{"id", "r"}, {"script", encoded}};
+  ASSERT_TRUE(ParseRecordScript(compressed.dump(), from_script));
+
+  EXPECT_EQ(from_step.wall, from_script.wall);
+  EXPECT_EQ(from_step.wins[0].hand, from_script.wins[0].hand);
+
+  for (auto encoding : {tziakcha::storage::Encoding::kCbor,
+                        tziakcha::storage::Encoding::kMsgpack}) {
+    Script from_binary;
+    ASSERT_TRUE(ParseRecordScript(
+        tziakcha::storage::EncodeDocument(decoded, encoding), from_binary));
+    EXPECT_EQ(from_binary.wall, from_step.wall);
+    EXPECT_EQ(from_binary.wins[0].fans, from_step.wins[0].fans);
+    EXPECT_EQ(from_binary.actions.size(), from_step.actions.size());
+  }
+  ASSERT_EQ(from_step.actions.size(), from_script.actions.size());
+  for (size_t i = 0; i < from_step.actions.size(); ++i) {
+    EXPECT_EQ(from_step.actions[i].data, from_script.actions[i].data);
+    EXPECT_EQ(from_step.actions[i].time_ms, from_script.actions[i].time_ms);
+  }
+}
+
+TEST(ScriptTest, ExtractFromParsedRecordMatchesText) {
+  json source = SampleScript();
+  std::string encoded;
+  ASSERT_TRUE(tziakcha::utils::EncodeScriptFromJson(source, encoded));
+
+  for (const json& record :
+       {json{{"script", "<Decoded>"}, {"step", source}},
+        json{{"script", encoded}}}) {
+    Script from_text;
+    ASSERT_TRUE(ParseRecordScript(record.dump(), from_text));
+    Script from_json;
+    ASSERT_TRUE(ExtractRecordScript(record, from_json));
+
+    EXPECT_EQ(from_json.wall, from_text.wall);
+    EXPECT_EQ(from_json.dice, from_text.dice);
+    EXPECT_EQ(from_json.title, from_text.title);
+    EXPECT_EQ(from_json.players.size(), from_text.players.size());
+    EXPECT_EQ(from_json.wins[0].fans, from_text.wins[0].fans);
+    EXPECT_EQ(from_json.wins[0].hand, from_text.wins[0].hand);
+    EXPECT_EQ(from_json.actions.size(), from_text.actions.size());
+  }
+
+  Script script;
+  std::string error;
+  EXPECT_FALSE(
+      ExtractRecordScript(json{{"script", "<Decoded>"}}, script, &error));
+  EXPECT_EQ(error, "Script marked as decoded but step field missing");
+}
+
+TEST(ScriptTest, RecordHeaderPrefersTheStepTimestamp) {
+  json source = SampleScript();
+  std::string encoded;
+  ASSERT_TRUE(tziakcha::utils::EncodeScriptFromJson(source, encoded));
+
+  struct Case {
+    json record;
+    int64_t timestamp;
+  };
+  std::vector<Case> cases = {
+      {{{"id", "r1"},
+        {"belongs", "s1"},
+        {"t", 5},
+        {"script", "<Decoded>"},
+        {"step", source}},
+       1700000000123LL},
+      {{{"id", "r2"}, {"belongs", "s2"}, {"t", 5}, {"script", encoded}}, 5},
+      {{{"id", "r3"}, {"t", 7}, {"step", {{"d", 1}}}}, 7},
+  };
+  for (const auto& c : cases) {
+    tziakcha::analyzer::RecordHeader header;
+    ASSERT_TRUE(ParseRecordHeader(c.record.dump(), header));
+    EXPECT_EQ(header.id, c.record["id"]);
+    EXPECT_EQ(header.session, c.record.value("belongs", ""));
+    EXPECT_EQ(header.timestamp, c.timestamp);
+
+    Script from_text;
+    ASSERT_TRUE(ParseRecordScript(c.record.dump(), from_text));
+    EXPECT_EQ(from_text.header.id, header.id);
+    EXPECT_EQ(from_text.header.timestamp, header.timestamp);
+    Script from_json;
+    ASSERT_TRUE(ExtractRecordScript(c.record, from_json));
+    EXPECT_EQ(from_json.header.session, header.session);
+    EXPECT_EQ(from_json.header.timestamp, header.timestamp);
+  }
+
+  tziakcha::analyzer::RecordHeader header;
+  EXPECT_FALSE(ParseRecordHeader("not json", header));
+}
+
+TEST(ScriptTest, RecordErrorsAreReported) {
+  Script script;
+  std::string error;
+
+  EXPECT_FALSE(ParseRecordScript("not json", script, &error));
+  EXPECT_EQ(error, "Failed to parse JSON");
+
+  EXPECT_FALSE(ParseRecordScript(R"({"id":"r"})", script, &error));
+  EXPECT_EQ(error, "Script field not found in record");
+
+  EXPECT_FALSE(ParseRecordScript(R"({"script":"<Decoded>"})", script, &error));
+  EXPECT_EQ(error, "Script marked as decoded but step field missing");
+
+  EXPECT_FALSE(ParseRecordScript(R"({"script":"@@@@"})", script, &error));
+  EXPECT_EQ(error, "Failed to decode script");
+
+  // A "step" nested deeper than the top level is not the script.
+  EXPECT_FALSE(
+      ParseRecordScript(R"({"x":{"step":{"d":1}}})", script, &error));
+  EXPECT_EQ(error, "Script field not found in record");
+}
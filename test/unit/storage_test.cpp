@@ -1,13 +1,48 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <sstream>
+#include <stdexcept>
+#include <thread>
 #include <nlohmann/json.hpp>
 #include "storage/filesystem_storage.h"
 
 using json   = nlohmann::json;
 namespace fs = std::filesystem;
 
+namespace {
+
+// Records the object keys of a document in the order they stream past.
+struct KeyCollector : nlohmann::json_sax<json> {
+  std::vector<std::string> keys;
+
+  bool null() override { return true; }
+  bool boolean(bool) override { return true; }
+  bool number_integer(number_integer_t) override { return true; }
+  bool number_unsigned(number_unsigned_t) override { return true; }
+  bool number_float(number_float_t, const string_t&) override { return true; }
+  bool string(string_t&) override { return true; }
+  bool binary(binary_t&) override { return true; }
+  bool start_object(std::size_t) override { return true; }
+  bool key(string_t& val) override {
+    keys.push_back(val);
+    return true;
+  }
+  bool end_object() override { return true; }
+  bool start_array(std::size_t) override { return true; }
+  bool end_array() override { return true; }
+  bool parse_error(std::size_t,
+                   const std::string&,
+                   const nlohmann::detail::exception&) override {
+    return false;
+  }
+};
+
+} // namespace
+
 class FileSystemStorageTest : public ::testing::Test {
 protected:
   void SetUp() override {
@@ -250,4 +285,366 @@ TEST_F(FileSystemStorageTest, PrintJsonNonexistentFile) {
 
   std::string output = buffer.str();
   EXPECT_TRUE(output.empty());
-}
\ No newline at end of file
+}
+
+TEST_F(FileSystemStorageTest, ListKeysWithEmptyPrefix) {
+  json test_data;
+  test_data["value"] = 1;
+
+  EXPECT_TRUE(storage_->save_json("a/one", test_data));
+  EXPECT_TRUE(storage_->save_json("b/two", test_data));
+  EXPECT_TRUE(storage_->save_json("three", test_data));
+
+  auto keys = storage_->list_keys("");
+  std::sort(keys.begin(), keys.end());
+  ASSERT_EQ(keys.size(), 3);
+  EXPECT_EQ(keys[0], "a/one");
+  EXPECT_EQ(keys[1], "b/two");
+  EXPECT_EQ(keys[2], "three");
+}
+
+TEST_F(FileSystemStorageTest, LoadStringReturnsRawContent) {
+  json test_data;
+  test_data["key"] = "value";
+  EXPECT_TRUE(storage_->save_json("raw/test", test_data));
+
+  std::string raw;
+  EXPECT_TRUE(storage_->load_string("raw/test", raw));
+  EXPECT_EQ(raw, test_data.dump());
+  EXPECT_FALSE(storage_->load_string("raw/missing", raw));
+}
+
+TEST_F(FileSystemStorageTest, SaveStringWritesTextAsGiven) {
+  std::string text = R"({"b": 1, "a": [true, null]})";
+  EXPECT_TRUE(storage_->save_string("raw/text", text));
+
+  std::string raw;
+  EXPECT_TRUE(storage_->load_string("raw/text", raw));
+  EXPECT_EQ(raw, text);
+
+  tziakcha::storage::FileSystemStorage cbor_storage(
+      (test_dir_ / "cbor").string(), tziakcha::storage::Encoding::kCbor);
+  EXPECT_TRUE(cbor_storage.save_string("raw/text", text));
+  json loaded;
+  EXPECT_TRUE(cbor_storage.load_json("raw/text", loaded));
+  EXPECT_EQ(loaded, json::parse(text));
+  EXPECT_FALSE(cbor_storage.save_string("raw/bad", "{\"truncated\": "));
+  EXPECT_FALSE(cbor_storage.exists("raw/bad"));
+}
+
+TEST_F(FileSystemStorageTest, LoadViewMapsFileContent) {
+  json test_data;
+  test_data["key"] = "mapped";
+  EXPECT_TRUE(storage_->save_json("view/test", test_data));
+
+  tziakcha::storage::RecordView view;
+  EXPECT_TRUE(storage_->load_view("view/test", view));
+  EXPECT_EQ(view.data(), test_data.dump());
+  EXPECT_EQ(json::parse(view.data())["key"], "mapped");
+  EXPECT_FALSE(storage_->load_view("view/missing", view));
+}
+
+TEST_F(FileSystemStorageTest, BinaryEncodingsRoundTrip) {
+  json test_data;
+  test_data["id"]    = "binary";
+  test_data["steps"] = json::array({1, 2, 3});
+
+  for (auto encoding : {tziakcha::storage::Encoding::kCbor,
+                        tziakcha::storage::Encoding::kMsgpack}) {
+    tziakcha::storage::FileSystemStorage storage(test_dir_.string(),
+                                                 encoding);
+    EXPECT_TRUE(storage.save_json("bin/test", test_data));
+
+    std::ifstream file(test_dir_ / "bin/test.json", std::ios::binary);
+    std::string raw((std::istreambuf_iterator<char>(file)),
+                    std::istreambuf_iterator<char>());
+    EXPECT_EQ(tziakcha::storage::DetectEncoding(raw), encoding);
+
+    json loaded;
+    EXPECT_TRUE(storage_->load_json("bin/test", loaded));
+    EXPECT_EQ(loaded, test_data);
+
+    std::string text;
+    EXPECT_TRUE(storage_->load_string("bin/test", text));
+    EXPECT_EQ(json::parse(text), test_data);
+
+    // Views keep the stored bytes; readers decode them without a text
+    // round trip.
+    tziakcha::storage::RecordView view;
+    EXPECT_TRUE(storage_->load_view("bin/test", view));
+    EXPECT_EQ(view.data(), raw);
+    KeyCollector keys;
+    EXPECT_TRUE(tziakcha::storage::SaxParseDocument(view.data(), &keys));
+    EXPECT_EQ(keys.keys, (std::vector<std::string>{"id", "steps"}));
+  }
+}
+
+TEST_F(FileSystemStorageTest, JsonWithByteOrderMarkIsText) {
+  std::string text = "\xEF\xBB\xBF{\"id\": \"bom\"}";
+  EXPECT_EQ(tziakcha::storage::DetectEncoding(text),
+            tziakcha::storage::Encoding::kJson);
+  EXPECT_EQ(tziakcha::storage::DetectEncoding("\x81\xA1v\x01"),
+            tziakcha::storage::Encoding::kMsgpack);
+
+  fs::create_directories(test_dir_ / "bom");
+  std::ofstream(test_dir_ / "bom/test.json", std::ios::binary) << text;
+  json loaded;
+  EXPECT_TRUE(storage_->load_json("bom/test", loaded));
+  EXPECT_EQ(loaded["id"], "bom");
+}
+
+TEST_F(FileSystemStorageTest, MixedEncodingsInOneDirectory) {
+  tziakcha::storage::FileSystemStorage cbor_storage(
+      test_dir_.string(), tziakcha::storage::Encoding::kCbor);
+  EXPECT_TRUE(storage_->save_json("mixed/json", json{{"v", 1}}));
+  EXPECT_TRUE(cbor_storage.save_json("mixed/cbor", json{{"v", 2}}));
+
+  json loaded;
+  EXPECT_TRUE(cbor_storage.load_json("mixed/json", loaded));
+  EXPECT_EQ(loaded["v"], 1);
+  EXPECT_TRUE(storage_->load_json("mixed/cbor", loaded));
+  EXPECT_EQ(loaded["v"], 2);
+}
+
+TEST_F(FileSystemStorageTest, ManifestTracksSaveAndRemove) {
+  EXPECT_TRUE(storage_->save_json("records/b", json{{"v", 1}}));
+  EXPECT_FALSE(storage_->has_manifest());
+
+  size_t key_count = 0;
+  ASSERT_TRUE(storage_->rebuild_manifest(&key_count));
+  EXPECT_EQ(key_count, 1);
+
+  EXPECT_TRUE(storage_->save_json("records/a", json{{"v", 2}}));
+  EXPECT_TRUE(storage_->save_json("other/c", json{{"v", 3}}));
+  EXPECT_TRUE(storage_->remove("records/b"));
+
+  tziakcha::storage::FileSystemStorage reopened(test_dir_.string());
+  ASSERT_TRUE(reopened.has_manifest());
+
+  auto keys = reopened.list_keys("records/");
+  ASSERT_EQ(keys.size(), 1);
+  EXPECT_EQ(keys[0], "records/a");
+  EXPECT_EQ(reopened.list_keys("").size(), 2);
+  EXPECT_TRUE(reopened.verify_manifest());
+}
+
+TEST_F(FileSystemStorageTest, ManifestVerifyDetectsExternalChanges) {
+  EXPECT_TRUE(storage_->save_json("keep", json{{"v", 1}}));
+  EXPECT_TRUE(storage_->save_json("gone", json{{"v", 2}}));
+  ASSERT_TRUE(storage_->rebuild_manifest());
+
+  fs::remove(test_dir_ / "gone.json");
+  std::ofstream(test_dir_ / "added.json") << "{}";
+
+  std::vector<std::string> missing;
+  std::vector<std::string> stale;
+  EXPECT_FALSE(storage_->verify_manifest(&missing, &stale));
+  ASSERT_EQ(missing.size(), 1);
+  EXPECT_EQ(missing[0], "added");
+  ASSERT_EQ(stale.size(), 1);
+  EXPECT_EQ(stale[0], "gone");
+
+  ASSERT_TRUE(storage_->rebuild_manifest());
+  EXPECT_TRUE(storage_->verify_manifest());
+}
+
+TEST_F(FileSystemStorageTest, ManifestNoticesWritesThroughOtherRoots) {
+  fs::path nested_dir = test_dir_ / "record";
+  EXPECT_TRUE(storage_->save_json("record/a", json{{"v", 1}}));
+  ASSERT_TRUE(storage_->rebuild_manifest());
+  {
+    tziakcha::storage::FileSystemStorage nested(nested_dir.string());
+    ASSERT_TRUE(nested.rebuild_manifest());
+  }
+
+  // Backdates the tree so the next write lands in a later clock tick.
+  auto age_tree = [&] {
+    auto past = fs::file_time_type::clock::now() - std::chrono::seconds(10);
+    for (const auto& path : {test_dir_ / "keys.manifest",
+                             nested_dir / "keys.manifest",
+                             test_dir_,
+                             nested_dir}) {
+      fs::last_write_time(path, past);
+    }
+  };
+
+  age_tree();
+  EXPECT_TRUE(storage_->save_json("record/b", json{{"v", 2}}));
+  {
+    tziakcha::storage::FileSystemStorage nested(nested_dir.string());
+    ASSERT_TRUE(nested.has_manifest());
+    EXPECT_EQ(nested.list_keys(""), (std::vector<std::string>{"a", "b"}));
+
+    age_tree();
+    EXPECT_TRUE(nested.save_json("c", json{{"v", 3}}));
+  }
+
+  tziakcha::storage::FileSystemStorage reopened(test_dir_.string());
+  ASSERT_TRUE(reopened.has_manifest());
+  EXPECT_EQ(reopened.list_keys("record/").size(), 3u);
+  EXPECT_TRUE(reopened.verify_manifest());
+}
+
+TEST_F(FileSystemStorageTest, ConcurrentSavesOfOneKeyDoNotCollide) {
+  std::atomic<int> failures{0};
+  std::vector<std::thread> writers;
+  for (int t = 0; t < 4; ++t) {
+    writers.emplace_back([&, t] {
+      for (int i = 0; i < 50; ++i) {
+        if (!storage_->save_json("shared", json{{"writer", t}, {"i", i}})) {
+          failures++;
+        }
+      }
+    });
+  }
+  for (auto& writer : writers) {
+    writer.join();
+  }
+  EXPECT_EQ(failures, 0);
+
+  json loaded;
+  EXPECT_TRUE(storage_->load_json("shared", loaded));
+  EXPECT_EQ(loaded["i"], 49);
+  for (const auto& entry : fs::directory_iterator(test_dir_)) {
+    EXPECT_EQ(entry.path().extension(), ".json") << entry.path();
+  }
+}
+
+TEST_F(FileSystemStorageTest, SaveManyWritesWholeBatch) {
+  std::vector<std::pair<std::string, json>> items;
+  for (int i = 0; i < 5; ++i) {
+    items.emplace_back("batch/" + std::to_string(i), json{{"v", i}});
+  }
+  EXPECT_TRUE(storage_->save_many(items));
+
+  json loaded;
+  EXPECT_TRUE(storage_->load_json("batch/3", loaded));
+  EXPECT_EQ(loaded["v"], 3);
+  EXPECT_EQ(storage_->list_keys("batch/").size(), 5);
+
+  for (const auto& entry : fs::directory_iterator(test_dir_ / "batch")) {
+    EXPECT_EQ(entry.path().extension(), ".json");
+  }
+}
+
+TEST_F(FileSystemStorageTest, ShardedLayoutKeepsLogicalKeys) {
+  EXPECT_TRUE(storage_->save_json("record/1001", json{{"v", 1}}));
+  EXPECT_TRUE(storage_->save_json("record/1002", json{{"v", 2}}));
+  EXPECT_TRUE(storage_->save_json("top", json{{"v", 3}}));
+
+  size_t moved = 0;
+  ASSERT_TRUE(storage_->reshard(2, &moved));
+  EXPECT_EQ(moved, 3);
+  EXPECT_FALSE(fs::exists(test_dir_ / "record" / "1001.json"));
+
+  tziakcha::storage::FileSystemStorage reopened(test_dir_.string());
+  EXPECT_EQ(reopened.get_shard_levels(), 2);
+  EXPECT_TRUE(reopened.save_json("record/1003", json{{"v", 4}}));
+
+  auto keys = reopened.list_keys("record/");
+  std::sort(keys.begin(), keys.end());
+  ASSERT_EQ(keys.size(), 3);
+  EXPECT_EQ(keys[0], "record/1001");
+  EXPECT_EQ(keys[2], "record/1003");
+  EXPECT_EQ(reopened.list_keys("").size(), 4);
+
+  json loaded;
+  EXPECT_TRUE(reopened.load_json("record/1002", loaded));
+  EXPECT_EQ(loaded["v"], 2);
+  EXPECT_TRUE(reopened.exists("top"));
+
+  size_t key_count = 0;
+  ASSERT_TRUE(reopened.rebuild_manifest(&key_count));
+  EXPECT_EQ(key_count, 4);
+
+  ASSERT_TRUE(reopened.reshard(0, &moved));
+  EXPECT_EQ(moved, 4);
+  EXPECT_TRUE(fs::exists(test_dir_ / "record" / "1003.json"));
+  EXPECT_TRUE(reopened.verify_manifest());
+}
+
+TEST_F(FileSystemStorageTest, LoadManyAndStreamingIteration) {
+  std::vector<std::string> keys;
+  for (int i = 0; i < 40; ++i) {
+    keys.push_back("stream/" + std::to_string(i));
+    EXPECT_TRUE(storage_->save_json(keys.back(), json{{"v", i}}));
+  }
+
+  std::vector<json> docs;
+  EXPECT_TRUE(storage_->load_many(keys, docs));
+  ASSERT_EQ(docs.size(), keys.size());
+  EXPECT_EQ(docs[17]["v"], 17);
+
+  keys.push_back("stream/missing");
+  EXPECT_FALSE(storage_->load_many(keys, docs));
+  EXPECT_TRUE(docs.back().is_null());
+
+  int seen = 0;
+  int sum  = 0;
+  storage_->for_each_record(
+      "stream/",
+      [&](const std::string& key, const tziakcha::storage::RecordView& view) {
+        seen++;
+        sum += json::parse(view.data())["v"].get<int>();
+        return true;
+      },
+      4);
+  EXPECT_EQ(seen, 40);
+  EXPECT_EQ(sum, 40 * 39 / 2);
+
+  int visited = 0;
+  storage_->for_each_record(
+      "stream/", [&](const std::string&, const tziakcha::storage::RecordView&) {
+        return ++visited < 5;
+      });
+  EXPECT_EQ(visited, 5);
+}
+
+TEST_F(FileSystemStorageTest, StreamRecordsKeepsKeyOrder) {
+  tziakcha::storage::FileSystemStorage cbor(
+      (test_dir_ / "cbor").string(), tziakcha::storage::Encoding::kCbor);
+  std::vector<std::string> keys;
+  for (int i = 0; i < 25; ++i) {
+    keys.push_back("r/" + std::to_string(24 - i));
+    EXPECT_TRUE(cbor.save_json(keys.back(), json{{"v", 24 - i}}));
+  }
+  keys.insert(keys.begin() + 3, "r/missing");
+
+  std::vector<int> values;
+  EXPECT_TRUE(cbor.stream_records(
+      keys,
+      [&](const std::string& key, const tziakcha::storage::RecordView& view) {
+        json doc;
+        EXPECT_TRUE(tziakcha::storage::DecodeDocument(view.data(), doc));
+        values.push_back(doc["v"].get<int>());
+        return true;
+      },
+      6));
+
+  ASSERT_EQ(values.size(), 25u);
+  for (int i = 0; i < 25; ++i) {
+    EXPECT_EQ(values[i], 24 - i);
+  }
+}
+
+TEST_F(FileSystemStorageTest, StreamRecordsRethrowsFromVisitor) {
+  std::vector<std::string> keys;
+  for (int i = 0; i < 20; ++i) {
+    keys.push_back("r/" + std::to_string(i));
+    EXPECT_TRUE(storage_->save_json(keys.back(), json{{"v", i}}));
+  }
+
+  int visited = 0;
+  EXPECT_THROW(
+      storage_->stream_records(
+          keys,
+          [&](const std::string&, const tziakcha::storage::RecordView&) {
+            if (++visited == 3) {
+              throw std::runtime_error("visitor failed");
+            }
+            return true;
+          },
+          2),
+      std::runtime_error);
+  EXPECT_EQ(visited, 3);
+}
@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <nlohmann/json.hpp>
+#include "storage/filesystem_storage.h"
+#include "storage/write_behind_storage.h"
+
+using json   = nlohmann::json;
+namespace fs = std::filesystem;
+
+class WriteBehindStorageTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    test_dir_ = fs::temp_directory_path() / "tziakcha_write_behind_test";
+    if (fs::exists(test_dir_)) {
+      fs::remove_all(test_dir_);
+    }
+    fs::create_directories(test_dir_);
+
+    inner_ = std::make_shared<tziakcha::storage::FileSystemStorage>(
+        test_dir_.string());
+  }
+
+  void TearDown() override {
+    if (fs::exists(test_dir_)) {
+      fs::remove_all(test_dir_);
+    }
+  }
+
+  size_t CountTempFiles() const {
+    size_t count = 0;
+    for (const auto& entry : fs::recursive_directory_iterator(test_dir_)) {
+      if (entry.path().string().find(".tmp") != std::string::npos) {
+        count++;
+      }
+    }
+    return count;
+  }
+
+  fs::path test_dir_;
+  std::shared_ptr<tziakcha::storage::FileSystemStorage> inner_;
+};
+
+TEST_F(WriteBehindStorageTest, FlushWritesEveryQueuedDocument) {
+  tziakcha::storage::WriteBehindStorage storage(inner_, 8, 16);
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_TRUE(storage.save_json("record/" + std::to_string(i),
+                                  json{{"id", i}}));
+  }
+
+  EXPECT_TRUE(storage.flush());
+  EXPECT_EQ(storage.written_count(), 100u);
+  EXPECT_EQ(storage.failed_count(), 0u);
+  EXPECT_EQ(inner_->list_keys("record/").size(), 100u);
+  EXPECT_EQ(CountTempFiles(), 0u);
+
+  json loaded;
+  EXPECT_TRUE(inner_->load_json("record/42", loaded));
+  EXPECT_EQ(loaded["id"], 42);
+}
+
+TEST_F(WriteBehindStorageTest, QueuedDocumentsAreReadable) {
+  tziakcha::storage::WriteBehindStorage storage(inner_);
+  EXPECT_TRUE(storage.save_json("a", json{{"v", 1}}));
+  EXPECT_TRUE(storage.save_json("a", json{{"v", 2}}));
+
+  EXPECT_TRUE(storage.exists("a"));
+  json loaded;
+  EXPECT_TRUE(storage.load_json("a", loaded));
+  EXPECT_EQ(loaded["v"], 2);
+
+  EXPECT_TRUE(storage.flush());
+  EXPECT_TRUE(inner_->load_json("a", loaded));
+  EXPECT_EQ(loaded["v"], 2);
+}
+
+TEST_F(WriteBehindStorageTest, DestructorDrainsQueue) {
+  {
+    tziakcha::storage::WriteBehindStorage storage(inner_, 4);
+    for (int i = 0; i < 20; ++i) {
+      storage.save_json("k" + std::to_string(i), json{{"v", i}});
+    }
+  }
+  EXPECT_EQ(inner_->list_keys("").size(), 20u);
+}
+
+TEST_F(WriteBehindStorageTest, FailedWritesAreReportedAndRefuseSaves) {
+  // A file where a directory is needed makes the inner write fail.
+  std::ofstream(test_dir_ / "blocked") << "";
+  tziakcha::storage::WriteBehindStorage storage(inner_);
+
+  EXPECT_TRUE(storage.save_json("blocked/a", json{{"v", 1}}));
+  storage.list_keys("");
+  EXPECT_EQ(storage.failed_count(), 1u);
+  EXPECT_FALSE(storage.save_json("b", json{{"v", 2}}));
+  EXPECT_FALSE(storage.flush());
+
+  EXPECT_TRUE(storage.save_json("b", json{{"v", 3}}));
+  EXPECT_TRUE(storage.flush());
+  json loaded;
+  EXPECT_TRUE(inner_->load_json("b", loaded));
+  EXPECT_EQ(loaded["v"], 3);
+}
+
+TEST_F(WriteBehindStorageTest, SavedStringsReachInnerStorageUnchanged) {
+  const std::string text = R"({"z": 1,  "a": [1, 2.50], "s": "é"})";
+  tziakcha::storage::WriteBehindStorage storage(inner_);
+  EXPECT_TRUE(storage.save_string("raw", text));
+  EXPECT_TRUE(storage.save_json("doc", json{{"v", 1}}));
+
+  std::string loaded_text;
+  EXPECT_TRUE(storage.load_string("raw", loaded_text));
+  EXPECT_EQ(loaded_text, text);
+  json loaded;
+  EXPECT_TRUE(storage.load_json("raw", loaded));
+  EXPECT_EQ(loaded["z"], 1);
+
+  EXPECT_TRUE(storage.flush());
+  EXPECT_EQ(storage.written_count(), 2u);
+  std::ifstream file(test_dir_ / "raw.json", std::ios::binary);
+  std::string on_disk((std::istreambuf_iterator<char>(file)),
+                      std::istreambuf_iterator<char>());
+  EXPECT_EQ(on_disk, text);
+}